@@ -0,0 +1,668 @@
+/**
+ * @file bench-csim.c
+ * @brief Measures the throughput of the cache simulator engines
+ *
+ * Synthetic traces are generated in memory in the packed binary format, one
+ * per access pattern, and every engine is run over every pattern for each
+ * requested cache configuration and replacement policy:
+ *
+ *     ./bench-csim -n 4194304 -C 5:1:6,6:8:6 -P lru,plru -o results.json
+ *
+ * Each run happens in a forked child so the reported peak RSS belongs to
+ * that run alone (it includes the in-memory trace, which every engine
+ * reads). A child inherits the high-water mark of its parent, so on Linux
+ * it is reset through /proc/self/clear_refs before the run starts; where
+ * that is unavailable the figure is an upper bound.
+ *
+ * Engines that simulate the same configuration must agree on the
+ * statistics; any disagreement is reported and makes the exit status 1.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* fork, clock_gettime and open_memstream are POSIX, not C99 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "csim-parallel.h"
+#include "csim-policy.h"
+#include "csim-stackdist.h"
+#include "csim-trace.h"
+#include "csim.h"
+
+/* Defines */
+#define BENCH_DEFAULT_RECORDS (1UL << 22)
+#define BENCH_DEFAULT_CONFIGS "5:1:6,6:8:6,4:16:4,10:4:5"
+#define BENCH_DEFAULT_THREADS 2
+#define BENCH_BASE_ADDRESS 0x10000000UL
+#define BENCH_REGION_BYTES (64UL << 20)
+#define BENCH_STRIDE_BYTES 4160UL
+#define BENCH_ZIPF_BLOCKS (1U << 16)
+#define BENCH_TRANSPOSE_N 256UL
+
+/* One cache geometry and replacement policy to benchmark */
+typedef struct {
+    unsigned int s;
+    unsigned int E;
+    unsigned int b;
+    const cachePolicy_t *pPolicy;
+} benchConfig_t;
+
+/* A synthetic trace held in memory */
+typedef struct {
+    char *pData;   /* Binary trace bytes */
+    size_t length; /* Number of bytes in pData */
+} benchTrace_t;
+
+/* Result of one run, sent from the child back to the parent */
+typedef struct {
+    bool bSuccess;
+    double seconds;
+    long peakRssKiB;
+    csim_stats_t stats;
+} benchSample_t;
+
+/* Access pattern generator */
+typedef struct {
+    const char *name;
+    bool (*generate)(traceWriter_t *writer, unsigned long count,
+                     uint64_t *rng);
+} benchPattern_t;
+
+/* Simulation engine */
+typedef struct {
+    const char *name;
+    bool bLruOnly; /* Only simulates the LRU policy */
+    bool (*run)(const benchTrace_t *trace, const benchConfig_t *config,
+                unsigned int threads, csim_stats_t *stats);
+} benchEngine_t;
+
+static bool generateSequential(traceWriter_t *writer, unsigned long count,
+                               uint64_t *rng);
+static bool generateStrided(traceWriter_t *writer, unsigned long count,
+                            uint64_t *rng);
+static bool generateRandom(traceWriter_t *writer, unsigned long count,
+                           uint64_t *rng);
+static bool generateZipf(traceWriter_t *writer, unsigned long count,
+                         uint64_t *rng);
+static bool generateTranspose(traceWriter_t *writer, unsigned long count,
+                              uint64_t *rng);
+static bool runCache(const benchTrace_t *trace, const benchConfig_t *config,
+                     unsigned int threads, csim_stats_t *stats);
+static bool runStackDist(const benchTrace_t *trace,
+                         const benchConfig_t *config, unsigned int threads,
+                         csim_stats_t *stats);
+static bool runParallel(const benchTrace_t *trace,
+                        const benchConfig_t *config, unsigned int threads,
+                        csim_stats_t *stats);
+
+static const benchPattern_t PATTERNS[] = {
+    {"sequential", generateSequential}, {"strided", generateStrided},
+    {"random", generateRandom},         {"zipf", generateZipf},
+    {"transpose", generateTranspose},
+};
+#define PATTERN_COUNT (sizeof(PATTERNS) / sizeof(PATTERNS[0]))
+
+static const benchEngine_t ENGINES[] = {
+    {"cache", false, runCache},
+    {"stackdist", true, runStackDist},
+    {"parallel", false, runParallel},
+};
+#define ENGINE_COUNT (sizeof(ENGINES) / sizeof(ENGINES[0]))
+
+/**
+ * @brief Print usage info
+ */
+static void usage(char *argv[]) {
+    printf("Usage: %s [-h] [-n <records>] [-p <patterns>] [-e <engines>]\n"
+           "       [-C <configs>] [-P <policies>] [-j <threads>] [-o <file>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h             Print this help message.\n");
+    printf("  -n <records>   Accesses per synthetic trace (default %lu)\n",
+           BENCH_DEFAULT_RECORDS);
+    printf("  -p <patterns>  Comma separated subset of sequential,strided,"
+           "random,zipf,transpose\n");
+    printf("  -e <engines>   Comma separated subset of cache,stackdist,"
+           "parallel\n");
+    printf("  -C <configs>   s:E:b[,s:E:b...] (default %s)\n",
+           BENCH_DEFAULT_CONFIGS);
+    printf("  -P <policies>  Comma separated replacement policies "
+           "(default lru)\n");
+    printf("  -j <threads>   Worker threads of the parallel engine "
+           "(default %d)\n",
+           BENCH_DEFAULT_THREADS);
+    printf("  -o <file>      Also write the results as JSON, '-' for "
+           "standard output only\n");
+}
+
+/**
+ * @brief Returns the next value of a xorshift64* generator
+ */
+static uint64_t benchRandom(uint64_t *rng) {
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return *rng * 2685821657736338717ULL;
+}
+
+/**
+ * @brief Appends one access to a synthetic trace
+ */
+static bool benchPut(traceWriter_t *writer, char accessType,
+                     unsigned long address, int byteSize) {
+    traceRecord_t record = {accessType, address, byteSize};
+    return traceWriterPut(writer, &record);
+}
+
+/**
+ * @brief Streams through memory, one store for every three loads
+ */
+static bool generateSequential(traceWriter_t *writer, unsigned long count,
+                               uint64_t *rng) {
+    for (unsigned long i = 0; i < count; i++) {
+        if (!benchPut(writer, ((i % 4) == 3) ? 'S' : 'L',
+                      BENCH_BASE_ADDRESS + (8 * i), 8))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Loads with a stride just over a page, wrapping around a region
+ */
+static bool generateStrided(traceWriter_t *writer, unsigned long count,
+                            uint64_t *rng) {
+    for (unsigned long i = 0; i < count; i++) {
+        unsigned long offset = (i * BENCH_STRIDE_BYTES) % BENCH_REGION_BYTES;
+        if (!benchPut(writer, 'L', BENCH_BASE_ADDRESS + offset, 8))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Uniformly random accesses over a region, a quarter of them stores
+ */
+static bool generateRandom(traceWriter_t *writer, unsigned long count,
+                           uint64_t *rng) {
+    for (unsigned long i = 0; i < count; i++) {
+        uint64_t r = benchRandom(rng);
+        unsigned long offset = (unsigned long)(r >> 8) % BENCH_REGION_BYTES;
+        if (!benchPut(writer, ((r & 3) == 0) ? 'S' : 'L',
+                      BENCH_BASE_ADDRESS + (offset & ~7UL), 8))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Zipf distributed accesses over BENCH_ZIPF_BLOCKS 64-byte blocks
+ *
+ * Block ranks are sampled by binary search over the cumulative distribution
+ * with exponent 1 and scattered over the region, so the hot blocks do not
+ * all fall into the same sets.
+ */
+static bool generateZipf(traceWriter_t *writer, unsigned long count,
+                         uint64_t *rng) {
+    double *cdf = malloc(BENCH_ZIPF_BLOCKS * sizeof(double));
+    double total = 0;
+    bool bSuccess = true;
+
+    if (cdf == NULL)
+        return false;
+    for (unsigned int k = 0; k < BENCH_ZIPF_BLOCKS; k++) {
+        total += 1.0 / (double)(k + 1);
+        cdf[k] = total;
+    }
+    for (unsigned long i = 0; bSuccess && (i < count); i++) {
+        uint64_t r = benchRandom(rng);
+        double u = (double)(r >> 11) / (double)(1ULL << 53) * total;
+        unsigned int lo = 0;
+        unsigned int hi = BENCH_ZIPF_BLOCKS - 1;
+        while (lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+            if (cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        unsigned long block = (lo * 2654435761UL) % BENCH_ZIPF_BLOCKS;
+        bSuccess = benchPut(writer, ((r & 3) == 0) ? 'S' : 'L',
+                            BENCH_BASE_ADDRESS + (block * 64), 8);
+    }
+    free(cdf);
+    return bSuccess;
+}
+
+/**
+ * @brief Naive transpose of an int matrix, row-wise loads and column stores
+ */
+static bool generateTranspose(traceWriter_t *writer, unsigned long count,
+                              uint64_t *rng) {
+    const unsigned long n = BENCH_TRANSPOSE_N;
+    const unsigned long a = BENCH_BASE_ADDRESS;
+    const unsigned long b = BENCH_BASE_ADDRESS + (4 * n * n) + 4096;
+    unsigned long i = 0;
+
+    while (i < count) {
+        for (unsigned long row = 0; (row < n) && (i < count); row++) {
+            for (unsigned long col = 0; (col < n) && (i < count); col++) {
+                if (!benchPut(writer, 'L', a + (4 * ((row * n) + col)), 4))
+                    return false;
+                i++;
+                if ((i < count) &&
+                    !benchPut(writer, 'S', b + (4 * ((col * n) + row)), 4))
+                    return false;
+                i++;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Converts a trace record type into the simulator's access flag
+ */
+static unsigned int benchAccessType(const traceRecord_t *record,
+                                    unsigned int previous) {
+    if (record->accessType == 'L')
+        return 0;
+    if (record->accessType == 'S')
+        return 1;
+    return previous;
+}
+
+/**
+ * @brief Runs checkSimulatorCache over the trace
+ */
+static bool runCache(const benchTrace_t *trace, const benchConfig_t *config,
+                     unsigned int threads, csim_stats_t *stats) {
+    traceReader_t reader;
+    traceRecord_t record;
+    cache_t cache;
+    unsigned int type = 0;
+
+    if (!cacheInit(&cache, config->s, config->E, config->b,
+                   config->pPolicy))
+        return false;
+    traceReaderOpenMemory(&reader, trace->pData, trace->length);
+    while (traceReaderNext(&reader, &record)) {
+        type = benchAccessType(&record, type);
+        checkSimulatorCache(&cache, type, record.address);
+    }
+    traceReaderClose(&reader);
+    cacheSummary(&cache, stats);
+    cacheFree(&cache);
+    return true;
+}
+
+/**
+ * @brief Runs the stack-distance engine over the trace, tracking up to E
+ */
+static bool runStackDist(const benchTrace_t *trace,
+                         const benchConfig_t *config, unsigned int threads,
+                         csim_stats_t *stats) {
+    traceReader_t reader;
+    traceRecord_t record;
+    stackDist_t stackDist;
+    unsigned int type = 0;
+    bool bSuccess = true;
+
+    if (!stackDistInit(&stackDist, config->s, config->E, config->b))
+        return false;
+    traceReaderOpenMemory(&reader, trace->pData, trace->length);
+    while (bSuccess && traceReaderNext(&reader, &record)) {
+        type = benchAccessType(&record, type);
+        bSuccess = stackDistAccess(&stackDist, type, record.address);
+    }
+    traceReaderClose(&reader);
+    if (bSuccess)
+        stackDistSummary(&stackDist, config->E, stats);
+    stackDistFree(&stackDist);
+    return bSuccess;
+}
+
+/**
+ * @brief Runs the set-partitioned multithreaded engine over the trace
+ */
+static bool runParallel(const benchTrace_t *trace,
+                        const benchConfig_t *config, unsigned int threads,
+                        csim_stats_t *stats) {
+    traceReader_t reader;
+    cache_t cache;
+    bool bSuccess;
+
+    if (!cacheInit(&cache, config->s, config->E, config->b,
+                   config->pPolicy))
+        return false;
+    traceReaderOpenMemory(&reader, trace->pData, trace->length);
+    bSuccess = parallelSimulate(&reader, &cache, threads, false);
+    traceReaderClose(&reader);
+    cacheSummary(&cache, stats);
+    cacheFree(&cache);
+    return bSuccess;
+}
+
+/**
+ * @brief Resets the peak RSS of this process to its current RSS, if possible
+ */
+static void benchResetPeakRss(void) {
+    FILE *clearRefs = fopen("/proc/self/clear_refs", "w");
+    if (clearRefs != NULL) {
+        fputs("5", clearRefs);
+        fclose(clearRefs);
+    }
+}
+
+/**
+ * @brief Runs one engine in a child process and collects its sample
+ */
+static bool benchMeasure(const benchEngine_t *engine,
+                         const benchTrace_t *trace,
+                         const benchConfig_t *config, unsigned int threads,
+                         benchSample_t *sample) {
+    int fds[2];
+    pid_t pid;
+    int status;
+    bool bReceived;
+
+    if (pipe(fds) != 0)
+        return false;
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        struct timespec start;
+        struct timespec end;
+        struct rusage usage;
+        benchSample_t result;
+        memset((void *)&result, 0, sizeof(result));
+
+        close(fds[0]);
+        benchResetPeakRss();
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result.bSuccess = engine->run(trace, config, threads, &result.stats);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        result.seconds = (double)(end.tv_sec - start.tv_sec) +
+                         ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+            result.peakRssKiB = usage.ru_maxrss;
+        _exit(write(fds[1], &result, sizeof(result)) == sizeof(result) ? 0
+                                                                        : 1);
+    }
+    close(fds[1]);
+    bReceived = (read(fds[0], sample, sizeof(*sample)) == sizeof(*sample));
+    close(fds[0]);
+    if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) ||
+        (WEXITSTATUS(status) != 0))
+        return false;
+    return bReceived && sample->bSuccess;
+}
+
+/**
+ * @brief Checks whether name appears in a comma separated list
+ */
+static bool benchListed(const char *list, const char *name) {
+    size_t length = strlen(name);
+    const char *p = list;
+
+    while (p != NULL) {
+        if ((strncmp(p, name, length) == 0) &&
+            ((p[length] == ',') || (p[length] == '\0')))
+            return true;
+        p = strchr(p, ',');
+        if (p != NULL)
+            p++;
+    }
+    return false;
+}
+
+/**
+ * @brief Parses a "s:E:b[,s:E:b...]" list of cache configurations
+ *
+ * Every geometry is paired with each policy named in policyList that
+ * supports its associativity.
+ */
+static bool parseConfigs(const char *list, const char *policyList,
+                         benchConfig_t **configs, unsigned int *count) {
+    const char *p = list;
+    char *end;
+
+    while (*p != '\0') {
+        long geometry[3];
+        benchConfig_t *grown;
+        for (unsigned int i = 0; i < 3; i++) {
+            geometry[i] = strtol(p, &end, 10);
+            if ((end == p) || ((i < 2) && (*end != ':')))
+                return false;
+            p = (i < 2) ? end + 1 : end;
+        }
+        if ((geometry[0] < 0) || (geometry[1] < 1) || (geometry[2] < 0) ||
+            (geometry[1] > (long)UINT_MAX) ||
+            ((geometry[0] + geometry[2]) >= ADDRESS_BITS_LEN))
+            return false;
+        for (const char *name = policyList; name != NULL;) {
+            char policyName[16];
+            size_t length = strcspn(name, ",");
+            const cachePolicy_t *policy = NULL;
+            if (length < sizeof(policyName)) {
+                memcpy(policyName, name, length);
+                policyName[length] = '\0';
+                policy = cachePolicyFind(policyName);
+            }
+            if (policy == NULL)
+                return false;
+            name = (name[length] == ',') ? &name[length + 1] : NULL;
+            if (!policy->isSupported((unsigned int)geometry[1]))
+                continue;
+            grown = realloc(*configs, (*count + 1) * sizeof(benchConfig_t));
+            if (grown == NULL)
+                return false;
+            grown[*count].s = (unsigned int)geometry[0];
+            grown[*count].E = (unsigned int)geometry[1];
+            grown[*count].b = (unsigned int)geometry[2];
+            grown[*count].pPolicy = policy;
+            *configs = grown;
+            (*count)++;
+        }
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Generates one synthetic trace into memory
+ */
+static bool benchGenerate(const benchPattern_t *pattern, unsigned long count,
+                          benchTrace_t *trace) {
+    traceWriter_t writer;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    FILE *stream;
+    bool bSuccess;
+
+    trace->pData = NULL;
+    trace->length = 0;
+    stream = open_memstream(&trace->pData, &trace->length);
+    if (stream == NULL)
+        return false;
+    bSuccess = traceWriterOpenStream(&writer, stream, true) &&
+               pattern->generate(&writer, count, &rng);
+    bSuccess = traceWriterClose(&writer) && bSuccess;
+    bSuccess = (fclose(stream) == 0) && bSuccess;
+    return bSuccess;
+}
+
+/**
+ * @brief Main routine
+ */
+int main(int argc, char *argv[]) {
+    unsigned long recordCount = BENCH_DEFAULT_RECORDS;
+    const char *patternList = NULL;
+    const char *engineList = NULL;
+    const char *configList = BENCH_DEFAULT_CONFIGS;
+    const char *policyList = "lru";
+    const char *jsonName = NULL;
+    long threadCount = BENCH_DEFAULT_THREADS;
+    benchConfig_t *configs = NULL;
+    unsigned int configCount = 0;
+    FILE *json = NULL;
+    bool bTable;
+    bool bFirstResult = true;
+    int status = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "hn:p:e:C:P:j:o:")) != -1) {
+        switch (c) {
+        case 'n':
+            recordCount = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            patternList = optarg;
+            break;
+        case 'e':
+            engineList = optarg;
+            break;
+        case 'C':
+            configList = optarg;
+            break;
+        case 'P':
+            policyList = optarg;
+            break;
+        case 'j':
+            threadCount = atol(optarg);
+            break;
+        case 'o':
+            jsonName = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            return 0;
+        default:
+            usage(argv);
+            return 1;
+        }
+    }
+    if ((recordCount == 0) || (threadCount < 1) ||
+        (threadCount > PARALLEL_MAX_THREADS) ||
+        !parseConfigs(configList, policyList, &configs, &configCount)) {
+        fprintf(stderr, "Invalid benchmark parameters\n");
+        free(configs);
+        return 1;
+    }
+
+    /* JSON on standard output replaces the table */
+    bTable = (jsonName == NULL) || (strcmp(jsonName, "-") != 0);
+    if (jsonName != NULL) {
+        json = bTable ? fopen(jsonName, "w") : stdout;
+        if (json == NULL) {
+            perror(jsonName);
+            free(configs);
+            return 1;
+        }
+        fprintf(json, "{\n  \"records\": %lu,\n  \"threads\": %ld,\n"
+                      "  \"results\": [",
+                recordCount, threadCount);
+    }
+    if (bTable)
+        printf("%-10s %-9s %-12s %-6s %10s %8s %8s %10s\n", "pattern",
+               "engine", "s:E:b", "policy", "accesses", "Macc/s", "ns/acc",
+               "peakKiB");
+
+    for (unsigned int p = 0; p < PATTERN_COUNT; p++) {
+        benchTrace_t trace;
+        if ((patternList != NULL) &&
+            !benchListed(patternList, PATTERNS[p].name))
+            continue;
+        if (!benchGenerate(&PATTERNS[p], recordCount, &trace)) {
+            fprintf(stderr, "Unable to generate the %s trace\n",
+                    PATTERNS[p].name);
+            free(trace.pData);
+            status = 1;
+            continue;
+        }
+        for (unsigned int k = 0; k < configCount; k++) {
+            csim_stats_t reference;
+            bool bHaveReference = false;
+            char geometry[40];
+            snprintf(geometry, sizeof(geometry), "%u:%u:%u", configs[k].s,
+                     configs[k].E, configs[k].b);
+
+            for (unsigned int e = 0; e < ENGINE_COUNT; e++) {
+                benchSample_t sample;
+                double rate;
+                if (((engineList != NULL) &&
+                     !benchListed(engineList, ENGINES[e].name)) ||
+                    (ENGINES[e].bLruOnly &&
+                     (configs[k].pPolicy != &cacheLruPolicy)))
+                    continue;
+                if (!benchMeasure(&ENGINES[e], &trace, &configs[k],
+                                  (unsigned int)threadCount, &sample)) {
+                    fprintf(stderr, "%s %s %s: run failed\n",
+                            PATTERNS[p].name, ENGINES[e].name, geometry);
+                    status = 1;
+                    continue;
+                }
+                if (!bHaveReference) {
+                    reference = sample.stats;
+                    bHaveReference = true;
+                } else if (memcmp(&reference, &sample.stats,
+                                  sizeof(reference)) != 0) {
+                    fprintf(stderr, "%s %s %s: statistics differ from %s\n",
+                            PATTERNS[p].name, ENGINES[e].name, geometry,
+                            ENGINES[0].name);
+                    status = 1;
+                }
+                rate = (double)recordCount / sample.seconds;
+                if (bTable)
+                    printf("%-10s %-9s %-12s %-6s %10lu %8.1f %8.2f %10ld\n",
+                           PATTERNS[p].name, ENGINES[e].name, geometry,
+                           configs[k].pPolicy->pName, recordCount, rate / 1e6,
+                           1e9 / rate, sample.peakRssKiB);
+                if (json != NULL) {
+                    fprintf(json,
+                            "%s\n    {\"pattern\": \"%s\", \"engine\": "
+                            "\"%s\", \"s\": %u, \"E\": %u, \"b\": %u, "
+                            "\"policy\": \"%s\", "
+                            "\"seconds\": %.6f, \"accesses_per_sec\": %.0f, "
+                            "\"ns_per_access\": %.3f, \"peak_rss_kib\": %ld, "
+                            "\"hits\": %ld, \"misses\": %ld, "
+                            "\"evictions\": %ld}",
+                            bFirstResult ? "" : ",", PATTERNS[p].name,
+                            ENGINES[e].name, configs[k].s, configs[k].E,
+                            configs[k].b, configs[k].pPolicy->pName,
+                            sample.seconds, rate, 1e9 / rate,
+                            sample.peakRssKiB, sample.stats.hits,
+                            sample.stats.misses, sample.stats.evictions);
+                    bFirstResult = false;
+                }
+            }
+        }
+        free(trace.pData);
+    }
+
+    if (json != NULL) {
+        fprintf(json, "\n  ]\n}\n");
+        if (json != stdout)
+            fclose(json);
+    }
+    free(configs);
+    return status;
+}
@@ -23,12 +23,23 @@ int func_counter = 0;
  * @param[in] stats The simulation statistics to be stored
  */
 void printSummary(const csim_stats_t *stats) {
+    printSummaryTo(stats, CSIM_RESULTS_FILE);
+}
+
+/**
+ * @brief Print a summary of the cache simulation statistics and store it
+ *        in the given file.
+ *
+ * @param[in] stats The simulation statistics to be stored
+ * @param[in] path  The file to store them in
+ */
+void printSummaryTo(const csim_stats_t *stats, const char *path) {
     printf("hits:%ld misses:%ld evictions:%ld dirty_bytes_in_cache:%ld "
            "dirty_bytes_evicted:%ld\n",
            stats->hits, stats->misses, stats->evictions, stats->dirty_bytes,
            stats->dirty_evictions);
 
-    FILE *output_fp = fopen(".csim_results", "w");
+    FILE *output_fp = fopen(path, "w");
     if (output_fp == NULL) {
         fprintf(stderr, "Error: failed to open results file: %s\n",
                 strerror(errno));
@@ -48,10 +59,23 @@ void printSummary(const csim_stats_t *stats) {
  * @return True if the operation was successful, false otherwise
  */
 bool loadSummary(csim_stats_t *stats) {
+    return loadSummaryFrom(stats, CSIM_RESULTS_FILE);
+}
+
+/**
+ * @brief Load a summary of the cache simulation statistics stored in the
+ *        given file.
+ *
+ * @param[out] stats The simulation statistics that were read
+ * @param[in]  path  The file they were stored in
+ *
+ * @return True if the operation was successful, false otherwise
+ */
+bool loadSummaryFrom(csim_stats_t *stats, const char *path) {
     /* Get the results from the simulator */
-    FILE *fp = fopen(".csim_results", "r");
+    FILE *fp = fopen(path, "r");
     if (fp == NULL) {
-        fprintf(stderr, "Failed to open .csim_results: %s\n", strerror(errno));
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
         return false;
     }
 
@@ -67,6 +91,18 @@ bool loadSummary(csim_stats_t *stats) {
     return true;
 }
 
+/**
+ * @brief Calculates the number of clock cycles test-trans charges for a trace
+ *
+ * @param[in] hits   Hits of the trace
+ * @param[in] misses Misses of the trace
+ *
+ * @return The clock cycles of the hits and misses
+ */
+unsigned long get_clock_cycles(unsigned long hits, unsigned long misses) {
+    return HIT_CYCLES * hits + MISS_CYCLES * misses;
+}
+
 /**
  * @brief Initialize the given matrices
  */
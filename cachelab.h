@@ -20,12 +20,21 @@ typedef struct {
     unsigned long dirty_evictions; /* number of evictions of dirty lines */
 } csim_stats_t;
 
+/** @brief Default file for the stored summary */
+#define CSIM_RESULTS_FILE ".csim_results"
+
 /** @brief Store a summary of the cache simulation statistics. */
 void printSummary(const csim_stats_t *stats);
 
+/** @brief Print a summary, storing it in the given file. */
+void printSummaryTo(const csim_stats_t *stats, const char *path);
+
 /* @brief Load the stored summary of the cache simulation statistics. */
 bool loadSummary(csim_stats_t *stats);
 
+/** @brief Load a summary stored in the given file. */
+bool loadSummaryFrom(csim_stats_t *stats, const char *path);
+
 /* Grading parameters for transpose */
 
 /** @brief Number of clock cycles for hit */
@@ -34,6 +43,9 @@ bool loadSummary(csim_stats_t *stats);
 /** @brief Number of clock cycles for miss */
 #define MISS_CYCLES 100
 
+/** @brief Clock cycles of a trace's hits and misses, as scored by test-trans */
+unsigned long get_clock_cycles(unsigned long hits, unsigned long misses);
+
 /** @brief Log number of sets */
 #define TEST_LOG_SET 5
 
@@ -0,0 +1,1187 @@
+/**
+ * @file csim-cache.c
+ * @brief Cache simulator engine
+ *
+ * This implementation is only simulating a cache behaviour by addressing
+ * hits, misses and evictions. Although memory is allocated for cache metadata
+ * no memory is allocated for corresponding data in the cache blocks. Simulator
+ * is merely checking for presence of address requested for and takes action
+ * accordingly
+ *
+ * Every function works on a cache_t, so several cache geometries can be
+ * simulated over the same trace at once.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-policy.h"
+#include "csim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+/* Odd multiplier of the set sampling hash, 2^64 divided by the golden ratio */
+#define CACHE_SAMPLE_MULTIPLIER 0x9E3779B97F4A7C15UL
+
+/* Global variables */
+bool bVerbose = false;
+
+/* Function prototyping */
+static inline uint64_t *cacheMaskWord(const cache_t *cache, uint64_t *pBits,
+                                      unsigned long addrSVal,
+                                      unsigned int way);
+static inline uint64_t cacheMaskBit(unsigned int way);
+static inline void cacheAccessDirectMapped(cache_t *cache,
+                                           unsigned int memAccessType,
+                                           unsigned long addrSVal,
+                                           unsigned long addrTagVal);
+static cacheAccessFn_t cacheAccessSelect(unsigned int setBits,
+                                         unsigned int linesPerSet,
+                                         unsigned int blockBits);
+static unsigned int cacheLineFill(cache_t *cache, unsigned long addrSVal,
+                                  unsigned long addrTagVal,
+                                  unsigned int memAccessType);
+static void cacheAccessPrefetching(cache_t *cache, unsigned int memAccessType,
+                                   unsigned long memAddr);
+static unsigned int cacheInvalidWay(const cache_t *cache,
+                                    unsigned long addrSVal);
+static inline void cacheRecordVictim(cache_t *cache, unsigned long addrSVal,
+                                     unsigned long victimTag, bool bDirty);
+static inline unsigned int cacheFindLine(const cache_t *cache,
+                                         unsigned long memAddr,
+                                         unsigned long *pAddrSVal,
+                                         unsigned long *pAddrTagVal);
+static inline bool cacheSampleAddress(const cache_t *cache,
+                                      unsigned long *pMemAddr);
+static void cacheAccessSampled(cache_t *cache, unsigned int memAccessType,
+                               unsigned long memAddr);
+static void cacheAccessWritePolicy(cache_t *cache, unsigned int memAccessType,
+                                   unsigned long memAddr);
+static void cacheWriteBelow(cache_t *cache, unsigned long block);
+
+/**
+ * @brief Allocates the metadata of a simulated cache.
+ *
+ *
+ * @param[out]      cache_t *cache                  Cache to initialise
+ * @param[in]       unsigned int setBits            Number of set index bits
+ * @param[in]       unsigned int linesPerSet        Number of lines per set
+ * @param[in]       unsigned int blockBits          Number of block bits
+ * @param[in]       const cachePolicy_t *policy     Replacement policy, which
+ * must support linesPerSet
+ *
+ * @return True on success, false if the heap allocation failed.
+ */
+bool cacheInit(cache_t *cache, unsigned int setBits, unsigned int linesPerSet,
+               unsigned int blockBits, const cachePolicy_t *policy) {
+    memset((void *)cache, 0, sizeof(*cache));
+    cache->iSetBitCount = setBits;
+    cache->iSetCount = 1U << setBits;
+    cache->iCacheLinesPerSet = linesPerSet;
+    cache->iBlockBitCount = blockBits;
+    cache->iBlocksPerLine = 1U << blockBits;
+    cache->iMaskWordsPerSet =
+        (linesPerSet + CACHE_MASK_WORD_BITS - 1) / CACHE_MASK_WORD_BITS;
+    cache->pPolicy = policy;
+    cache->iPolicyWordsPerSet = policy->stateWordsPerSet(linesPerSet);
+    cache->pProbe = cacheProbeSelect(linesPerSet);
+    cache->pAccess = cacheAccessSelect(setBits, linesPerSet, blockBits);
+
+    /* Initialise simulator cache by allocating memory in heap */
+    size_t lineCount = (size_t)cache->iSetCount * linesPerSet;
+    size_t maskWordCount = (size_t)cache->iSetCount * cache->iMaskWordsPerSet;
+    cache->pTags = calloc(lineCount, sizeof(unsigned long));
+    cache->pValidBits = calloc(maskWordCount, sizeof(uint64_t));
+    cache->pDirtyBits = calloc(maskWordCount, sizeof(uint64_t));
+    cache->pSets = calloc(cache->iSetCount, sizeof(cacheSet_t));
+    if (policy->bRecencyList)
+        cache->pLinks = calloc(lineCount, sizeof(cacheWayLink_t));
+    if (cache->iPolicyWordsPerSet != 0)
+        cache->pPolicyState =
+            calloc((size_t)cache->iSetCount * cache->iPolicyWordsPerSet,
+                   sizeof(uint64_t));
+    if ((cache->pTags == NULL) || (cache->pValidBits == NULL) ||
+        (cache->pDirtyBits == NULL) || (cache->pSets == NULL) ||
+        (policy->bRecencyList && (cache->pLinks == NULL)) ||
+        ((cache->iPolicyWordsPerSet != 0) && (cache->pPolicyState == NULL))) {
+        cacheFree(cache);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Releases the metadata of a simulated cache.
+ *
+ * @param[in,out]   cache_t *cache                  Cache to release
+ *
+ * @return void.
+ */
+void cacheFree(cache_t *cache) {
+    free(cache->pTags);
+    free(cache->pValidBits);
+    free(cache->pDirtyBits);
+    free(cache->pLinks);
+    free(cache->pSets);
+    free(cache->pPolicyState);
+    free(cache->pPrefetchBits);
+    free(cache->pPrefetchState);
+    free(cache->pSampleSets);
+    free(cache->pWriteBuffer);
+    cache->pTags = NULL;
+    cache->pValidBits = NULL;
+    cache->pDirtyBits = NULL;
+    cache->pLinks = NULL;
+    cache->pSets = NULL;
+    cache->pPolicyState = NULL;
+    cache->pPrefetchBits = NULL;
+    cache->pPrefetchState = NULL;
+    cache->pSampleSets = NULL;
+    cache->pWriteBuffer = NULL;
+}
+
+/**
+ * @brief Returns the bitmask word holding a line's valid or dirty bit.
+ */
+static inline uint64_t *cacheMaskWord(const cache_t *cache, uint64_t *pBits,
+                                      unsigned long addrSVal,
+                                      unsigned int way) {
+    return &pBits[(addrSVal * cache->iMaskWordsPerSet) +
+                  (way / CACHE_MASK_WORD_BITS)];
+}
+
+/**
+ * @brief Returns a line's bit within its bitmask word.
+ */
+static inline uint64_t cacheMaskBit(unsigned int way) {
+    return (uint64_t)1 << (way % CACHE_MASK_WORD_BITS);
+}
+
+/**
+ * @brief Computes the statistics of the sets a cache simulated.
+ *
+ * Hits, misses, evictions and dirty evictions are taken as accumulated, dirty
+ * bytes in the cache are counted from the dirty bitmasks. Those of a sampled
+ * cache are of its sampled sets alone, see cacheSampleEstimate.
+ *
+ * @param[in]       const cache_t *cache            Simulated cache
+ * @param[out]      csim_stats_t *stats             Cache statistics
+ *
+ * @return void.
+ */
+void cacheSampledSummary(const cache_t *cache, csim_stats_t *stats) {
+    unsigned long dirtyCacheLineCount = 0;
+    size_t maskWordCount = (size_t)cache->iSetCount * cache->iMaskWordsPerSet;
+
+    /* compute number of dirty cache lines */
+    for (size_t i = 0; i < maskWordCount; i++)
+        dirtyCacheLineCount +=
+            (unsigned long)__builtin_popcountll(cache->pDirtyBits[i]);
+
+    /* Update dirty bytes in the cache and dirty cache evictions */
+    *stats = cache->stats;
+    stats->dirty_bytes = dirtyCacheLineCount * cache->iBlocksPerLine;
+    stats->dirty_evictions = cache->iDirtyEvictions * cache->iBlocksPerLine;
+}
+
+/**
+ * @brief Scales the statistics of the sampled sets to estimates for the
+ * whole cache.
+ *
+ * Each counter is a ratio estimate, its count per access of the sampled
+ * sets times the accesses to every set, which the sampling filter counts
+ * exactly. Hits and misses so add up to those accesses, however unevenly
+ * the trace spreads them over the sets. With no access to a sampled set
+ * there is nothing to scale, and every counter stays 0.
+ *
+ * @param[in,out]   csim_stats_t *stats             Counters of the sampled
+ * sets, over the same span of the trace as accesses
+ * @param[in]       unsigned long accesses          Accesses to every set
+ *
+ * @return void.
+ */
+void cacheSampleEstimate(csim_stats_t *stats, unsigned long accesses) {
+    unsigned long sampled = stats->hits + stats->misses;
+    double ratio;
+
+    if (sampled == 0)
+        return;
+    ratio = (double)accesses / (double)sampled;
+    stats->hits = (unsigned long)((double)stats->hits * ratio + 0.5);
+    stats->misses = accesses - stats->hits;
+    stats->evictions = (unsigned long)((double)stats->evictions * ratio + 0.5);
+    stats->dirty_bytes =
+        (unsigned long)((double)stats->dirty_bytes * ratio + 0.5);
+    stats->dirty_evictions =
+        (unsigned long)((double)stats->dirty_evictions * ratio + 0.5);
+}
+
+/**
+ * @brief Computes the final statistics of a simulated cache.
+ *
+ * Those of a sampled cache are scaled into estimates for the whole cache by
+ * cacheSampleEstimate.
+ *
+ * @param[in]       const cache_t *cache            Simulated cache
+ * @param[out]      csim_stats_t *stats             Cache statistics
+ *
+ * @return void.
+ */
+void cacheSummary(const cache_t *cache, csim_stats_t *stats) {
+    cacheSampledSummary(cache, stats);
+    if (cache->iSampleBits != 0)
+        cacheSampleEstimate(stats, cache->iSampleAccesses);
+}
+
+/**
+ * @brief Checks simulator cache of hits, misses and evictions.
+ *
+ * Calls the access kernel chosen for the cache's geometry in cacheInit.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * requested
+ * @param[in]       unsigned long memAddr           Memory address to be
+ * accessed
+ *
+ * @return void.
+ */
+void checkSimulatorCache(cache_t *cache, unsigned int memAccessType,
+                         unsigned long memAddr) {
+    cache->pAccess(cache, memAccessType, memAddr);
+}
+
+/**
+ * @brief Checks simulator cache for every block an access touches.
+ *
+ * An access that straddles block boundaries is simulated as one access per
+ * block, in address order. Most accesses fit in one block and cost a single
+ * compare more than checkSimulatorCache.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * requested
+ * @param[in]       unsigned long memAddr           First byte accessed
+ * @param[in]       int byteSize                    Number of bytes accessed
+ *
+ * @return void.
+ */
+void checkSimulatorCacheSpan(cache_t *cache, unsigned int memAccessType,
+                             unsigned long memAddr, int byteSize) {
+    unsigned long block = memAddr >> cache->iBlockBitCount;
+    unsigned long lastBlock =
+        cacheSpanLastBlock(memAddr, byteSize, cache->iBlockBitCount);
+
+    cache->pAccess(cache, memAccessType, memAddr);
+    while (block != lastBlock) {
+        block++;
+        cache->pAccess(cache, memAccessType, block << cache->iBlockBitCount);
+    }
+}
+
+/**
+ * @brief Counts accesses repeating the previous one's block as hits.
+ *
+ * A run of accesses to the block the cache has just been accessed at all
+ * hit, in the way the access kernel left in iLastWay, so rather than
+ * probing for each of them the run is applied as a burst: its hits are
+ * counted, the replacement policy sees them through onHitRun and a store
+ * anywhere in it leaves the line dirty. A sampled cache drops the runs the
+ * sampling filter dropped the first access of. Not valid with a prefetcher
+ * attached, whose fills after the previous access may have evicted the
+ * block, or with a write policy other than write-back write-allocate,
+ * which may write repeated stores on or not cache the block at all.
+ * Direct-mapped kernels leave iLastWay at 0, their only way.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long memAddr           Address within the block
+ * the previous access touched
+ * @param[in]       unsigned long repeats           Number of accesses
+ * @param[in]       bool bDirty                     One of them is a store
+ *
+ * @return void.
+ */
+void cacheRepeatHits(cache_t *cache, unsigned long memAddr,
+                     unsigned long repeats, bool bDirty) {
+    unsigned long addrSVal;
+    unsigned int j = cache->iLastWay;
+
+    if (repeats == 0)
+        return;
+    /* Runs in sets left out of the sample were never simulated */
+    if (cache->iSampleBits != 0) {
+        cache->iSampleAccesses += repeats;
+        if (!cacheSampleAddress(cache, &memAddr))
+            return;
+    }
+    addrSVal = (memAddr >> cache->iBlockBitCount) &
+               ((1UL << cache->iSetBitCount) - 1);
+    if (cache->iSampleBits != 0)
+        cache->pSampleSets[addrSVal].iHits += repeats;
+    cache->stats.hits += repeats;
+    /* Direct-mapped sets have no replacement state, see the kernel */
+    if (cache->iCacheLinesPerSet > 1)
+        cache->pPolicy->onHitRun(cache, addrSVal, j, repeats);
+    if (bDirty)
+        *cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j) |=
+            cacheMaskBit(j);
+}
+
+/**
+ * @brief Returns the index of the last block an access touches.
+ *
+ * Sizes below one byte count as one byte, and an access running past the
+ * top of the address space stops at the last block.
+ *
+ * @param[in]       unsigned long memAddr           First byte accessed
+ * @param[in]       int byteSize                    Number of bytes accessed
+ * @param[in]       unsigned int blockBits          Number of block bits
+ *
+ * @return memAddr's block index plus the number of boundaries crossed.
+ */
+unsigned long cacheSpanLastBlock(unsigned long memAddr, int byteSize,
+                                 unsigned int blockBits) {
+    unsigned long lastByte = memAddr;
+
+    if (byteSize > 1) {
+        unsigned long extraBytes = (unsigned long)byteSize - 1;
+        lastByte = (memAddr > ULONG_MAX - extraBytes) ? ULONG_MAX
+                                                      : memAddr + extraBytes;
+    }
+    return lastByte >> blockBits;
+}
+
+/**
+ * @brief Simulates one access, geometry passed in so it can be constant.
+ *
+ * Every kernel is this function inlined with some of setBits, linesPerSet
+ * and blockBits replaced by constants, so the set index and tag reduce to
+ * a shift and a mask and the per-set offsets to shifts. A direct-mapped
+ * cache has a single line per set and no recency list to maintain, so it
+ * only compares one tag.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * @param[in]       unsigned long memAddr           Memory address accessed
+ * @param[in]       unsigned int setBits            Number of set index bits
+ * @param[in]       unsigned int linesPerSet        Number of lines per set
+ * @param[in]       unsigned int blockBits          Number of block bits
+ *
+ * @return void.
+ */
+__attribute__((always_inline)) static inline void
+cacheAccessKernel(cache_t *cache, unsigned int memAccessType,
+                  unsigned long memAddr, unsigned int setBits,
+                  unsigned int linesPerSet, unsigned int blockBits) {
+    /* Tag is every address bit above the set index, s + b < 64 */
+    unsigned long addrSVal = (memAddr >> blockBits) & ((1UL << setBits) - 1);
+    unsigned long addrTagVal = memAddr >> (setBits + blockBits);
+    unsigned int j;
+
+    if (linesPerSet == 1) {
+        cacheAccessDirectMapped(cache, memAccessType, addrSVal, addrTagVal);
+        return;
+    }
+
+    /* Cache handler section, only lines filled so far can hit */
+    j = cache->pProbe(&cache->pTags[addrSVal * linesPerSet],
+                      &cache->pValidBits[addrSVal * cache->iMaskWordsPerSet],
+                      cache->pSets[addrSVal].iValidLineCount, addrTagVal);
+    /* On a hit let the replacement policy see the access, if not call the
+     miss routine */
+    if (j != CACHE_WAY_NONE) {
+        cache->stats.hits++;
+        cache->iLastWay = j;
+        /* Updating cache line rank upon access*/
+        cache->pPolicy->onHit(cache, addrSVal, j);
+        /* Updating dirty memory access */
+        if (memAccessType == 1) {
+            *cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j) |=
+                cacheMaskBit(j);
+        }
+        if (bVerbose) {
+            printf("\thit");
+        }
+    } else
+        cacheMissHandler(cache, addrSVal, addrTagVal, memAccessType);
+}
+
+/**
+ * @brief Simulates one access to a direct-mapped set.
+ *
+ * The set's valid and dirty bits are bit 0 of its only mask word, and with
+ * one line the recency list is always that line, so it is never touched.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * @param[in]       unsigned long addrSVal          Cache set to be accessed
+ * @param[in]       unsigned long addrTagVal        Tag value of the memory
+ * address to be accessed
+ *
+ * @return void.
+ */
+static inline void cacheAccessDirectMapped(cache_t *cache,
+                                           unsigned int memAccessType,
+                                           unsigned long addrSVal,
+                                           unsigned long addrTagVal) {
+    uint64_t *validWord = &cache->pValidBits[addrSVal];
+    uint64_t *dirtyWord = &cache->pDirtyBits[addrSVal];
+
+    if ((*validWord != 0) && (cache->pTags[addrSVal] == addrTagVal)) {
+        cache->stats.hits++;
+        if (memAccessType == 1)
+            *dirtyWord = 1;
+        if (bVerbose)
+            printf("\thit");
+        return;
+    }
+
+    cache->stats.misses++;
+    if (bVerbose)
+        printf("\tmiss");
+    if (*validWord != 0) {
+        cache->stats.evictions++;
+        if (bVerbose)
+            printf("\teviction");
+        /* If eviction was dirty then update dirty eviction count */
+        if (*dirtyWord != 0)
+            cache->iDirtyEvictions++;
+        cacheRecordVictim(cache, addrSVal, cache->pTags[addrSVal],
+                          *dirtyWord != 0);
+    } else {
+        *validWord = 1;
+        cache->pSets[addrSVal].iValidLineCount = 1;
+    }
+    cache->pTags[addrSVal] = addrTagVal;
+    *dirtyWord = (memAccessType == 1) ? 1 : 0;
+}
+
+/* Kernel with the associativity baked in, s and b read from the cache */
+#define CACHE_ACCESS_ASSOC(E)                                                  \
+    static void cacheAccessAssoc##E(cache_t *cache,                            \
+                                    unsigned int memAccessType,                \
+                                    unsigned long memAddr) {                   \
+        cacheAccessKernel(cache, memAccessType, memAddr,                       \
+                          cache->iSetBitCount, E, cache->iBlockBitCount);      \
+    }
+
+/* Kernel with the whole geometry baked in */
+#define CACHE_ACCESS_GEOMETRY(NAME, S, E, B)                                   \
+    static void cacheAccess##NAME(cache_t *cache, unsigned int memAccessType,  \
+                                  unsigned long memAddr) {                     \
+        cacheAccessKernel(cache, memAccessType, memAddr, S, E, B);             \
+    }
+
+CACHE_ACCESS_ASSOC(1)
+CACHE_ACCESS_ASSOC(2)
+CACHE_ACCESS_ASSOC(4)
+CACHE_ACCESS_ASSOC(8)
+CACHE_ACCESS_ASSOC(16)
+CACHE_ACCESS_GEOMETRY(Test, TEST_LOG_SET, TEST_ASSOC, TEST_LOG_BLOCK)
+CACHE_ACCESS_GEOMETRY(HaswellL1, HASWELL_L1_SET, HASWELL_L1_ASSOC,
+                      HASWELL_L1_BLOCK)
+
+/**
+ * @brief Kernel for any geometry, reads s, E and b from the cache.
+ */
+static void cacheAccessGeneric(cache_t *cache, unsigned int memAccessType,
+                               unsigned long memAddr) {
+    cacheAccessKernel(cache, memAccessType, memAddr, cache->iSetBitCount,
+                      cache->iCacheLinesPerSet, cache->iBlockBitCount);
+}
+
+/**
+ * @brief Chooses the access kernel for a cache geometry.
+ *
+ * @param[in]       unsigned int setBits            Number of set index bits
+ * @param[in]       unsigned int linesPerSet        Number of lines per set
+ * @param[in]       unsigned int blockBits          Number of block bits
+ *
+ * @return The most specialised kernel matching the geometry.
+ */
+static cacheAccessFn_t cacheAccessSelect(unsigned int setBits,
+                                         unsigned int linesPerSet,
+                                         unsigned int blockBits) {
+    if ((setBits == TEST_LOG_SET) && (linesPerSet == TEST_ASSOC) &&
+        (blockBits == TEST_LOG_BLOCK))
+        return cacheAccessTest;
+    if ((setBits == HASWELL_L1_SET) && (linesPerSet == HASWELL_L1_ASSOC) &&
+        (blockBits == HASWELL_L1_BLOCK))
+        return cacheAccessHaswellL1;
+
+    switch (linesPerSet) {
+    case 1:
+        return cacheAccessAssoc1;
+    case 2:
+        return cacheAccessAssoc2;
+    case 4:
+        return cacheAccessAssoc4;
+    case 8:
+        return cacheAccessAssoc8;
+    case 16:
+        return cacheAccessAssoc16;
+    default:
+        return cacheAccessGeneric;
+    }
+}
+
+/**
+ * @brief Cache misses are handled in this function.
+ *
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long addrSVal          Cache set to be accessed
+ * @param[in]       unsigned long addrTagVal        Tag value of the memory
+ * address to be accessed
+ * @param[in]       unsigned int memAccessType      Memory access type
+ *
+ * @return void.
+ */
+void cacheMissHandler(cache_t *cache, unsigned long addrSVal,
+                      unsigned long addrTagVal, unsigned int memAccessType) {
+    /* Cache miss handler */
+    cache->stats.misses++;
+    if (bVerbose)
+        printf("\tmiss");
+    cache->iLastWay = cacheLineFill(cache, addrSVal, addrTagVal, memAccessType);
+}
+
+/**
+ * @brief Brings a block into its set, evicting a line if the set is full.
+ *
+ * Lines are only invalidated by cacheInvalidate, so a set fills its ways in
+ * order and the next empty line is the one at index iValidLineCount unless
+ * an invalidated line is waiting to be reused. The replacement policy only
+ * picks a victim once the set is full.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long addrSVal          Cache set to be accessed
+ * @param[in]       unsigned long addrTagVal        Tag value of the memory
+ * address to be filled
+ * @param[in]       unsigned int memAccessType      Memory access type
+ *
+ * @return Way that now holds the block.
+ */
+static unsigned int cacheLineFill(cache_t *cache, unsigned long addrSVal,
+                                  unsigned long addrTagVal,
+                                  unsigned int memAccessType) {
+    /* local variable */
+    cacheSet_t *set = &cache->pSets[addrSVal];
+    unsigned int j = set->iValidLineCount;
+    uint64_t *dirtyWord;
+
+    if (set->iInvalidLineCount != 0) {
+        /* Reuse an invalidated line, it is already counted */
+        j = cacheInvalidWay(cache, addrSVal);
+        set->iInvalidLineCount--;
+        cache->pPolicy->onFill(cache, addrSVal, j);
+    } else if (j == cache->iCacheLinesPerSet) {
+        /* If the set is full call the eviction routine */
+        return cacheEvictionHandler(cache, addrSVal, addrTagVal,
+                                    memAccessType);
+    } else {
+        /* Fill the next empty cache line and update the rank */
+        cache->pPolicy->onFill(cache, addrSVal, j);
+        set->iValidLineCount++;
+    }
+    *cacheMaskWord(cache, cache->pValidBits, addrSVal, j) |= cacheMaskBit(j);
+    cache->pTags[(addrSVal * cache->iCacheLinesPerSet) + j] = addrTagVal;
+    /* Updating dirty memory access */
+    dirtyWord = cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j);
+    if (memAccessType == 1) {
+        *dirtyWord |= cacheMaskBit(j);
+    } else {
+        *dirtyWord &= ~cacheMaskBit(j);
+    }
+    return j;
+}
+
+/**
+ * @brief Returns the lowest invalidated line of a set.
+ *
+ * Ways at or above iValidLineCount have clear valid bits too, but the caller
+ * knows an invalidated line exists below the count, and it comes first.
+ */
+static unsigned int cacheInvalidWay(const cache_t *cache,
+                                    unsigned long addrSVal) {
+    const uint64_t *validWords =
+        &cache->pValidBits[addrSVal * cache->iMaskWordsPerSet];
+    unsigned int w = 0;
+
+    while (validWords[w] == ~(uint64_t)0)
+        w++;
+    return (w * CACHE_MASK_WORD_BITS) +
+           (unsigned int)__builtin_ctzll(~validWords[w]);
+}
+
+/**
+ * @brief Records the line an eviction displaced in cache->victim.
+ */
+static inline void cacheRecordVictim(cache_t *cache, unsigned long addrSVal,
+                                     unsigned long victimTag, bool bDirty) {
+    cache->victim.bValid = true;
+    cache->victim.bDirty = bDirty;
+    cache->victim.iAddress = ((victimTag << cache->iSetBitCount) | addrSVal)
+                             << cache->iBlockBitCount;
+}
+
+/**
+ * @brief Cache evictions are handled in this function.
+ *
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long addrSVal          Cache set to be accessed
+ * @param[in]       unsigned long addrTagVal        Tag value of the memory
+ * address to be accessed
+ * @param[in]       unsigned int memAccessType      Memory access type
+ *
+ * @return Way that now holds the block.
+ */
+unsigned int cacheEvictionHandler(cache_t *cache, unsigned long addrSVal,
+                                  unsigned long addrTagVal,
+                                  unsigned int memAccessType) {
+    /* Replacement policy picks the line to evict */
+    unsigned int j = cache->pPolicy->chooseVictim(cache, addrSVal);
+    uint64_t *dirtyWord = cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j);
+    unsigned long *tag =
+        &cache->pTags[(addrSVal * cache->iCacheLinesPerSet) + j];
+    bool bDirty = (*dirtyWord & cacheMaskBit(j)) != 0;
+
+    /* Cache eviction handler */
+    cache->stats.evictions++;
+    if (bVerbose)
+        printf("\teviction");
+
+    /* Evict line and update tag for cache line */
+    cacheRecordVictim(cache, addrSVal, *tag, bDirty);
+    *tag = addrTagVal;
+    /* If eviction was dirty then update dirty eviction count */
+    if (bDirty) {
+        cache->iDirtyEvictions++;
+    }
+    /* Updating dirty memory access flag */
+    if (memAccessType == 0) {
+        *dirtyWord &= ~cacheMaskBit(j);
+    } else {
+        *dirtyWord |= cacheMaskBit(j);
+    }
+    /* An unused prefetch leaves with its line */
+    if (cache->pPrefetchBits != NULL)
+        *cacheMaskWord(cache, cache->pPrefetchBits, addrSVal, j) &=
+            ~cacheMaskBit(j);
+    /* Updating cache line rank upon access */
+    cache->pPolicy->onFill(cache, addrSVal, j);
+    return j;
+}
+
+/**
+ * @brief Finds the line holding an address, returning its way.
+ *
+ * Also returns the set index and tag of the address, and CACHE_WAY_NONE
+ * when the block is not cached.
+ */
+static inline unsigned int cacheFindLine(const cache_t *cache,
+                                         unsigned long memAddr,
+                                         unsigned long *pAddrSVal,
+                                         unsigned long *pAddrTagVal) {
+    unsigned long addrSVal = (memAddr >> cache->iBlockBitCount) &
+                             ((1UL << cache->iSetBitCount) - 1);
+    unsigned long addrTagVal =
+        memAddr >> (cache->iSetBitCount + cache->iBlockBitCount);
+
+    *pAddrSVal = addrSVal;
+    *pAddrTagVal = addrTagVal;
+    return cache->pProbe(
+        &cache->pTags[addrSVal * cache->iCacheLinesPerSet],
+        &cache->pValidBits[addrSVal * cache->iMaskWordsPerSet],
+        cache->pSets[addrSVal].iValidLineCount, addrTagVal);
+}
+
+/**
+ * @brief Simulates an access only if it hits.
+ *
+ * A hit is counted and updates the line as checkSimulatorCache would. On a
+ * miss the cache is left untouched, so a hierarchy can look a block up in
+ * every level before filling the levels that missed.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * @param[in]       unsigned long memAddr           Memory address accessed
+ *
+ * @return True on a hit.
+ */
+bool cacheAccessIfPresent(cache_t *cache, unsigned int memAccessType,
+                          unsigned long memAddr) {
+    unsigned long addrSVal;
+    unsigned long addrTagVal;
+    unsigned int j = cacheFindLine(cache, memAddr, &addrSVal, &addrTagVal);
+
+    if (j == CACHE_WAY_NONE)
+        return false;
+    cache->stats.hits++;
+    cache->iLastWay = j;
+    /* Direct-mapped sets have no replacement state, see the kernel */
+    if (cache->iCacheLinesPerSet > 1)
+        cache->pPolicy->onHit(cache, addrSVal, j);
+    if (memAccessType == 1)
+        *cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j) |=
+            cacheMaskBit(j);
+    if (bVerbose)
+        printf("\thit");
+    return true;
+}
+
+/**
+ * @brief Drops a block from the cache without counting an eviction.
+ *
+ * The line becomes free for the next fill of its set. A direct-mapped set
+ * simply goes back to empty.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long memAddr           Address within the block
+ * @param[out]      bool *pDirty                    Whether the dropped line
+ * was dirty, untouched if the block was not cached
+ *
+ * @return True if the block was cached.
+ */
+bool cacheInvalidate(cache_t *cache, unsigned long memAddr, bool *pDirty) {
+    unsigned long addrSVal;
+    unsigned long addrTagVal;
+    unsigned int j = cacheFindLine(cache, memAddr, &addrSVal, &addrTagVal);
+    uint64_t *dirtyWord;
+
+    if (j == CACHE_WAY_NONE)
+        return false;
+    dirtyWord = cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j);
+    *pDirty = (*dirtyWord & cacheMaskBit(j)) != 0;
+    *dirtyWord &= ~cacheMaskBit(j);
+    *cacheMaskWord(cache, cache->pValidBits, addrSVal, j) &= ~cacheMaskBit(j);
+    if (cache->pPrefetchBits != NULL)
+        *cacheMaskWord(cache, cache->pPrefetchBits, addrSVal, j) &=
+            ~cacheMaskBit(j);
+    if (cache->iCacheLinesPerSet == 1)
+        cache->pSets[addrSVal].iValidLineCount = 0;
+    else
+        cache->pSets[addrSVal].iInvalidLineCount++;
+    return true;
+}
+
+/**
+ * @brief Places a block in the cache without counting an access.
+ *
+ * Used for lines arriving from another level, such as write-backs and the
+ * victims an exclusive hierarchy moves down. A block already cached only
+ * picks up the dirty flag, otherwise it is filled like a miss, including any
+ * eviction.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long memAddr           Address within the block
+ * @param[in]       bool bDirty                     The block is dirty
+ *
+ * @return void.
+ */
+void cacheInsert(cache_t *cache, unsigned long memAddr, bool bDirty) {
+    unsigned long addrSVal;
+    unsigned long addrTagVal;
+    unsigned int j = cacheFindLine(cache, memAddr, &addrSVal, &addrTagVal);
+
+    if (j == CACHE_WAY_NONE)
+        cacheLineFill(cache, addrSVal, addrTagVal, bDirty ? 1 : 0);
+    else if (bDirty)
+        *cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j) |=
+            cacheMaskBit(j);
+}
+
+/**
+ * @brief Attaches a hardware prefetcher to a freshly initialised cache.
+ *
+ * The cache switches to an access kernel that tracks prefetched lines and
+ * triggers the prefetcher, the specialised kernels stay prefetch free.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       const cachePrefetcher_t *prefetcher     Prefetcher
+ * @param[in]       unsigned int degree             Blocks fetched per trigger
+ *
+ * @return True on success, false if the heap allocation failed.
+ */
+bool cacheSetPrefetcher(cache_t *cache, const cachePrefetcher_t *prefetcher,
+                        unsigned int degree) {
+    size_t maskWordCount = (size_t)cache->iSetCount * cache->iMaskWordsPerSet;
+
+    cache->pPrefetcher = prefetcher;
+    cache->iPrefetchDegree = degree;
+    cache->pPrefetchBits = calloc(maskWordCount, sizeof(uint64_t));
+    if (prefetcher->iStateWords != 0)
+        cache->pPrefetchState =
+            calloc(prefetcher->iStateWords, sizeof(uint64_t));
+    if ((cache->pPrefetchBits == NULL) ||
+        ((prefetcher->iStateWords != 0) && (cache->pPrefetchState == NULL)))
+        return false;
+    cache->pAccess = cacheAccessPrefetching;
+    return true;
+}
+
+/**
+ * @brief Access kernel of a cache with a prefetcher attached.
+ *
+ * The first demand hit to a prefetched line makes the prefetch useful and,
+ * like a demand miss, lets the prefetcher run ahead.
+ */
+static void cacheAccessPrefetching(cache_t *cache, unsigned int memAccessType,
+                                   unsigned long memAddr) {
+    unsigned long addrSVal;
+    unsigned long addrTagVal;
+    unsigned int j = cacheFindLine(cache, memAddr, &addrSVal, &addrTagVal);
+    uint64_t *prefetchWord;
+
+    if (j == CACHE_WAY_NONE) {
+        cacheMissHandler(cache, addrSVal, addrTagVal, memAccessType);
+        cache->pPrefetcher->onTrigger(cache, memAddr >> cache->iBlockBitCount);
+        return;
+    }
+    cache->stats.hits++;
+    cache->iLastWay = j;
+    if (cache->iCacheLinesPerSet > 1)
+        cache->pPolicy->onHit(cache, addrSVal, j);
+    if (memAccessType == 1)
+        *cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j) |=
+            cacheMaskBit(j);
+    if (bVerbose)
+        printf("\thit");
+    prefetchWord = cacheMaskWord(cache, cache->pPrefetchBits, addrSVal, j);
+    if ((*prefetchWord & cacheMaskBit(j)) != 0) {
+        *prefetchWord &= ~cacheMaskBit(j);
+        cache->prefetch.iUseful++;
+        cache->pPrefetcher->onTrigger(cache, memAddr >> cache->iBlockBitCount);
+    }
+}
+
+/**
+ * @brief Brings a block into the cache ahead of demand.
+ *
+ * Called by prefetchers. A block already cached is left alone, otherwise it
+ * is filled clean like a miss, evicting a line if needed, without counting a
+ * miss. Blocks past the top of the address space are ignored.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long block             Block index, address >> b
+ *
+ * @return void.
+ */
+void cachePrefetch(cache_t *cache, unsigned long block) {
+    unsigned long addrSVal;
+    unsigned long addrTagVal;
+    unsigned int j;
+
+    if (block > (ULONG_MAX >> cache->iBlockBitCount))
+        return;
+    j = cacheFindLine(cache, block << cache->iBlockBitCount, &addrSVal,
+                      &addrTagVal);
+    if (j != CACHE_WAY_NONE)
+        return;
+    j = cacheLineFill(cache, addrSVal, addrTagVal, 0);
+    *cacheMaskWord(cache, cache->pPrefetchBits, addrSVal, j) |=
+        cacheMaskBit(j);
+    cache->prefetch.iIssued++;
+}
+
+/**
+ * @brief Cache line rank updates are handled in this function.
+ *
+ * Moves the accessed line to the most recently used end of its set's
+ * recency list in constant time. Only used by the LRU policy. A line not yet
+ * linked into the list (a fresh fill) has both neighbours set to
+ * CACHE_WAY_NONE.
+ *
+ * @param[in,out]   cache_t *cache                      Simulated cache
+ * @param[in]       unsigned long addrSVal              Cache set to be accessed
+ * @param[in]       unsigned int recentAccessIndex      Most recently accessed
+ * cache line index
+ *
+ * @return void.
+ */
+void cacheLineRankUpdate(cache_t *cache, unsigned long addrSVal,
+                         unsigned int recentAccessIndex) {
+    cacheWayLink_t *setLinks =
+        &cache->pLinks[addrSVal * cache->iCacheLinesPerSet];
+    cacheSet_t *set = &cache->pSets[addrSVal];
+    cacheWayLink_t *line = &setLinks[recentAccessIndex];
+
+    if (set->iMruWay == recentAccessIndex)
+        return;
+
+    /* Unlink the line from its current position */
+    if (line->iPrevWay != CACHE_WAY_NONE)
+        setLinks[line->iPrevWay].iNextWay = line->iNextWay;
+    if (line->iNextWay != CACHE_WAY_NONE)
+        setLinks[line->iNextWay].iPrevWay = line->iPrevWay;
+    else if (line->iPrevWay != CACHE_WAY_NONE)
+        set->iLruWay = line->iPrevWay;
+
+    /* Link the line in at the most recently used end */
+    line->iPrevWay = CACHE_WAY_NONE;
+    line->iNextWay = set->iMruWay;
+    setLinks[set->iMruWay].iPrevWay = recentAccessIndex;
+    set->iMruWay = recentAccessIndex;
+}
+
+/**
+ * @brief Keeps 1 in 2^sampleBits of the sets of a freshly initialised cache.
+ *
+ * The sampled sets are those whose index hashes to a multiple of
+ * 2^sampleBits. The hash is a bijection of the s-bit set indices, so
+ * exactly one set in 2^sampleBits is sampled, spread over the index range
+ * so that strided traces do not all land in or out of the sample. Only the
+ * sampled sets are allocated, accesses to the others are dropped as soon as
+ * their set index is known, and cacheSummary scales what is left back up.
+ *
+ * Not valid with a prefetcher, whose fills would land in any set, or with
+ * the hierarchy entry points, which take addresses of every set.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int sampleBits         Sampling rate in bits, 0
+ * for none, below the cache's set bits
+ *
+ * @return True on success, false if the heap allocation failed.
+ */
+bool cacheSetSampling(cache_t *cache, unsigned int sampleBits) {
+    unsigned int setBits = cache->iSetBitCount;
+    unsigned int linesPerSet = cache->iCacheLinesPerSet;
+    unsigned int blockBits = cache->iBlockBitCount;
+    const cachePolicy_t *policy = cache->pPolicy;
+
+    if (sampleBits == 0)
+        return true;
+    cacheFree(cache);
+    if (!cacheInit(cache, setBits - sampleBits, linesPerSet, blockBits,
+                   policy))
+        return false;
+    cache->iSampleBits = sampleBits;
+    cache->pSampleSets = calloc(cache->iSetCount, sizeof(cacheSampleSet_t));
+    if (cache->pSampleSets == NULL)
+        return false;
+    cache->pSampledAccess = cache->pAccess;
+    cache->pAccess = cacheAccessSampled;
+    return true;
+}
+
+/**
+ * @brief Maps an address to the sampled cache, if its set is sampled.
+ *
+ * The address keeps its tag and block offset, and its set index is replaced
+ * by the position of the set among the sampled ones, the hash without its
+ * low iSampleBits zero bits.
+ *
+ * @param[in]       const cache_t *cache            Sampled cache
+ * @param[in,out]   unsigned long *pMemAddr         Address, rewritten for
+ * the sampled cache's geometry if its set is sampled
+ *
+ * @return True if the address's set is sampled.
+ */
+static inline bool cacheSampleAddress(const cache_t *cache,
+                                      unsigned long *pMemAddr) {
+    unsigned int blockBits = cache->iBlockBitCount;
+    unsigned int setBits = cache->iSetBitCount + cache->iSampleBits;
+    unsigned int shift = (setBits + 1) / 2;
+    unsigned long setMask = (1UL << setBits) - 1;
+    unsigned long hash = (*pMemAddr >> blockBits) & setMask;
+
+    /* Odd multiplies and right xorshifts are invertible modulo 2^s, the
+       xorshifts fold the high index bits into the low ones tested */
+    hash = (hash * CACHE_SAMPLE_MULTIPLIER) & setMask;
+    hash ^= hash >> shift;
+    hash = (hash * CACHE_SAMPLE_MULTIPLIER) & setMask;
+    hash ^= hash >> shift;
+    if ((hash & ((1UL << cache->iSampleBits) - 1)) != 0)
+        return false;
+    *pMemAddr = ((*pMemAddr >> (setBits + blockBits))
+                 << (cache->iSetBitCount + blockBits)) |
+                ((hash >> cache->iSampleBits) << blockBits) |
+                (*pMemAddr & ((1UL << blockBits) - 1));
+    return true;
+}
+
+/**
+ * @brief Access kernel of a sampled cache.
+ *
+ * Counts every access, then drops those to sets outside the sample and
+ * hands the others to the geometry's kernel, crediting what they did to
+ * their set's counters.
+ */
+static void cacheAccessSampled(cache_t *cache, unsigned int memAccessType,
+                               unsigned long memAddr) {
+    csim_stats_t before = cache->stats;
+    cacheSampleSet_t *set;
+
+    cache->iSampleAccesses++;
+    if (!cacheSampleAddress(cache, &memAddr))
+        return;
+    cache->pSampledAccess(cache, memAccessType, memAddr);
+    set = &cache->pSampleSets[(memAddr >> cache->iBlockBitCount) &
+                              (cache->iSetCount - 1)];
+    set->iHits += cache->stats.hits - before.hits;
+    set->iMisses += cache->stats.misses - before.misses;
+    set->iEvictions += cache->stats.evictions - before.evictions;
+}
+
+/**
+ * @brief Parses the "policy[:entries]" write policy given to csim -w.
+ *
+ * The policy is wb or wt, write-back or write-through, optionally followed
+ * by -nwa for no-write-allocate. The entries are those of a write-combining
+ * buffer between the cache and memory, none if not given. Only stores the
+ * policy writes on go through the buffer, so plain wb cannot have one.
+ *
+ * @param[in]       const char *spec                Write policy
+ * @param[out]      unsigned int *pWritePolicy      CACHE_WRITE_* flags
+ * @param[out]      unsigned int *pBufferSize       Write buffer entries
+ *
+ * @return False if the policy or the number of entries is invalid.
+ */
+bool cacheWritePolicyFind(const char *spec, unsigned int *pWritePolicy,
+                          unsigned int *pBufferSize) {
+    static const struct {
+        const char *pName;
+        unsigned int iWritePolicy;
+    } policies[] = {
+        {"wb", 0},
+        {"wt", CACHE_WRITE_THROUGH},
+        {"wb-nwa", CACHE_WRITE_NO_ALLOCATE},
+        {"wt-nwa", CACHE_WRITE_THROUGH | CACHE_WRITE_NO_ALLOCATE},
+    };
+    const char *entries = strchr(spec, ':');
+    size_t nameLength = (entries != NULL) ? (size_t)(entries - spec)
+                                          : strlen(spec);
+
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        char *end;
+        long value;
+        if ((strlen(policies[i].pName) != nameLength) ||
+            (strncmp(policies[i].pName, spec, nameLength) != 0))
+            continue;
+        *pWritePolicy = policies[i].iWritePolicy;
+        *pBufferSize = 0;
+        if (entries == NULL)
+            return true;
+        value = strtol(entries + 1, &end, 10);
+        if ((end == entries + 1) || (*end != '\0') || (value < 1) ||
+            (value > CACHE_WRITE_BUFFER_MAX) || (*pWritePolicy == 0))
+            return false;
+        *pBufferSize = (unsigned int)value;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Gives a freshly initialised, unsampled cache another write policy.
+ *
+ * Stores the policy sends on past the cache, every store under
+ * write-through and store misses under no-write-allocate, are counted in
+ * the cache's write counters and, with a buffer, combined per block in it.
+ * The cache then switches to an access kernel implementing the policy.
+ * Write-back write-allocate without a buffer keeps the specialised kernels.
+ * Sampling drops stores, so csim rejects -w with -k.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned int writePolicy        CACHE_WRITE_* flags
+ * @param[in]       unsigned int bufferSize         Write-combining buffer
+ * entries, 0 for none
+ *
+ * @return True on success, false if the heap allocation failed, leaving the
+ * cache as it was.
+ */
+bool cacheSetWritePolicy(cache_t *cache, unsigned int writePolicy,
+                         unsigned int bufferSize) {
+    if ((writePolicy == 0) && (bufferSize == 0))
+        return true;
+    if (bufferSize != 0) {
+        cache->pWriteBuffer = calloc(bufferSize, sizeof(unsigned long));
+        if (cache->pWriteBuffer == NULL)
+            return false;
+    }
+    cache->iWritePolicy = writePolicy;
+    cache->iWriteBufferSize = bufferSize;
+    cache->pAccess = cacheAccessWritePolicy;
+    return true;
+}
+
+/**
+ * @brief Access kernel of a cache with a non-default write policy.
+ *
+ * A write-through store updates the line, which stays clean, and is written
+ * on whether it hit or not. A no-write-allocate store miss leaves the cache
+ * untouched and is only written on.
+ */
+static void cacheAccessWritePolicy(cache_t *cache, unsigned int memAccessType,
+                                   unsigned long memAddr) {
+    unsigned long addrSVal;
+    unsigned long addrTagVal;
+    unsigned int j = cacheFindLine(cache, memAddr, &addrSVal, &addrTagVal);
+    bool bThrough = (cache->iWritePolicy & CACHE_WRITE_THROUGH) != 0;
+
+    if (j != CACHE_WAY_NONE) {
+        cache->stats.hits++;
+        cache->iLastWay = j;
+        if (cache->iCacheLinesPerSet > 1)
+            cache->pPolicy->onHit(cache, addrSVal, j);
+        if ((memAccessType == 1) && !bThrough)
+            *cacheMaskWord(cache, cache->pDirtyBits, addrSVal, j) |=
+                cacheMaskBit(j);
+        if (bVerbose)
+            printf("\thit");
+    } else if ((memAccessType == 1) &&
+               ((cache->iWritePolicy & CACHE_WRITE_NO_ALLOCATE) != 0)) {
+        cache->stats.misses++;
+        if (bVerbose)
+            printf("\tmiss");
+        cacheWriteBelow(cache, memAddr >> cache->iBlockBitCount);
+        return;
+    } else {
+        cacheMissHandler(cache, addrSVal, addrTagVal,
+                         bThrough ? 0 : memAccessType);
+    }
+    if ((memAccessType == 1) && bThrough)
+        cacheWriteBelow(cache, memAddr >> cache->iBlockBitCount);
+}
+
+/**
+ * @brief Sends a store on past the cache.
+ *
+ * Without a write-combining buffer every store is a write of its own. With
+ * one, a store to a buffered block merges into it, and any other takes a
+ * free entry, or the oldest one once its block has been written.
+ *
+ * @param[in,out]   cache_t *cache                  Simulated cache
+ * @param[in]       unsigned long block             Block stored to
+ *
+ * @return void.
+ */
+static void cacheWriteBelow(cache_t *cache, unsigned long block) {
+    unsigned int size = cache->iWriteBufferSize;
+
+    cache->write.iWrites++;
+    if (size == 0) {
+        cache->write.iTransactions++;
+        return;
+    }
+    for (unsigned int k = 0; k < cache->iWriteBufferCount; k++) {
+        if (cache->pWriteBuffer[(cache->iWriteBufferHead + k) % size] ==
+            block) {
+            cache->write.iCombined++;
+            return;
+        }
+    }
+    if (cache->iWriteBufferCount == size) {
+        cache->write.iTransactions++;
+        cache->pWriteBuffer[cache->iWriteBufferHead] = block;
+        cache->iWriteBufferHead = (cache->iWriteBufferHead + 1) % size;
+    } else {
+        cache->pWriteBuffer[(cache->iWriteBufferHead +
+                             cache->iWriteBufferCount) %
+                            size] = block;
+        cache->iWriteBufferCount++;
+    }
+}
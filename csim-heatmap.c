@@ -0,0 +1,597 @@
+/**
+ * @file csim-heatmap.c
+ * @brief Per-set and per-region miss instrumentation of the cache simulator
+ *
+ * The watched cache runs its usual access kernel; whether the access hit or
+ * evicted is read back from the change in its statistics, and the evicted
+ * block from its victim record, so the kernels carry no instrumentation of
+ * their own.
+ *
+ * The shadow cache and the page counters are indexed through open addressed
+ * tables of block and page numbers. A block keeps its shadow entry after
+ * leaving the shadow cache, which is how a compulsory miss is told apart
+ * from a capacity one. Each table hands out indices in insertion order and
+ * its owner's array grows alongside it, so an access costs one probe of the
+ * block table, one of the page table and a few list link updates.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-heatmap.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+#define HEATMAP_INITIAL_SLOTS 1024
+#define HEATMAP_HASH_MULTIPLIER 0x9E3779B97F4A7C15UL
+
+/* Page and its counters, as sorted for output */
+typedef struct {
+    unsigned long iPage; /* Page number */
+    unsigned int iIndex; /* Index into pPages */
+} heatmapPageRef_t;
+
+/* Function prototyping */
+static bool heatmapTableInit(heatmapTable_t *table);
+static void heatmapTableFree(heatmapTable_t *table);
+static bool heatmapTableGrow(heatmapTable_t *table);
+static bool heatmapTableIndex(heatmapTable_t *table, unsigned long key,
+                              unsigned int *pIndex, bool *pAdded);
+static bool heatmapShadowAccess(heatmap_t *heatmap, unsigned long block,
+                                unsigned int *pMissClass);
+static heatmapCounters_t *heatmapRegionOf(heatmap_t *heatmap,
+                                          unsigned long memAddr);
+static void heatmapWriteCounters(FILE *out, const heatmapCounters_t *counters,
+                                 unsigned int format);
+static void heatmapWriteRegion(FILE *out, const char *scope, const char *name,
+                               unsigned long start, unsigned long end,
+                               const heatmapCounters_t *counters,
+                               unsigned int format, bool bFirst);
+static int heatmapPageCompare(const void *a, const void *b);
+
+/**
+ * @brief Home slot of a key in a table.
+ */
+static inline size_t heatmapHome(const heatmapTable_t *table,
+                                 unsigned long key) {
+    unsigned long hash = key * HEATMAP_HASH_MULTIPLIER;
+    hash ^= hash >> 32;
+    return (size_t)hash & (table->iCapacity - 1);
+}
+
+/**
+ * @brief Allocates an empty table of HEATMAP_INITIAL_SLOTS slots.
+ */
+static bool heatmapTableInit(heatmapTable_t *table) {
+    table->iCapacity = HEATMAP_INITIAL_SLOTS;
+    table->iCount = 0;
+    table->pSlots = malloc(table->iCapacity * sizeof(heatmapSlot_t));
+    if (table->pSlots == NULL)
+        return false;
+    for (size_t i = 0; i < table->iCapacity; i++)
+        table->pSlots[i].iIndex = HEATMAP_NONE;
+    return true;
+}
+
+/**
+ * @brief Releases a table.
+ */
+static void heatmapTableFree(heatmapTable_t *table) {
+    free(table->pSlots);
+    table->pSlots = NULL;
+}
+
+/**
+ * @brief Doubles a table, rehashing every slot.
+ *
+ * @return False if the larger table could not be allocated.
+ */
+static bool heatmapTableGrow(heatmapTable_t *table) {
+    heatmapTable_t grown;
+
+    if (table->iCapacity > UINT_MAX)
+        return false;
+    grown.iCapacity = table->iCapacity * 2;
+    grown.iCount = table->iCount;
+    grown.pSlots = malloc(grown.iCapacity * sizeof(heatmapSlot_t));
+    if (grown.pSlots == NULL)
+        return false;
+    for (size_t i = 0; i < grown.iCapacity; i++)
+        grown.pSlots[i].iIndex = HEATMAP_NONE;
+    for (size_t i = 0; i < table->iCapacity; i++) {
+        size_t j;
+        if (table->pSlots[i].iIndex == HEATMAP_NONE)
+            continue;
+        for (j = heatmapHome(&grown, table->pSlots[i].iKey);
+             grown.pSlots[j].iIndex != HEATMAP_NONE;
+             j = (j + 1) & (grown.iCapacity - 1)) {
+        }
+        grown.pSlots[j] = table->pSlots[i];
+    }
+    heatmapTableFree(table);
+    *table = grown;
+    return true;
+}
+
+/**
+ * @brief Finds the index of a key, adding it with the next index if absent.
+ *
+ * The load is kept below one half, so the owner's array needs iCapacity / 2
+ * entries whenever the table has iCapacity slots.
+ *
+ * @return False if the table could not grow.
+ */
+static bool heatmapTableIndex(heatmapTable_t *table, unsigned long key,
+                              unsigned int *pIndex, bool *pAdded) {
+    size_t i;
+
+    for (i = heatmapHome(table, key); table->pSlots[i].iIndex != HEATMAP_NONE;
+         i = (i + 1) & (table->iCapacity - 1)) {
+        if (table->pSlots[i].iKey == key) {
+            *pIndex = table->pSlots[i].iIndex;
+            *pAdded = false;
+            return true;
+        }
+    }
+    if ((table->iCount + 1) * 2 > table->iCapacity) {
+        if (!heatmapTableGrow(table))
+            return false;
+        for (i = heatmapHome(table, key);
+             table->pSlots[i].iIndex != HEATMAP_NONE;
+             i = (i + 1) & (table->iCapacity - 1)) {
+        }
+    }
+    table->pSlots[i].iKey = key;
+    table->pSlots[i].iIndex = (unsigned int)table->iCount;
+    *pIndex = table->pSlots[i].iIndex;
+    *pAdded = true;
+    table->iCount++;
+    return true;
+}
+
+/**
+ * @brief Allocates the instrumentation of a cache.
+ *
+ * Regions default to pages until heatmapAddRegion names one.
+ *
+ * @param[out]      heatmap_t *heatmap              Heatmap to initialise
+ * @param[in]       cache_t *cache                  Cache to watch, which
+ * must not have a prefetcher
+ *
+ * @return True on success, false if the heap allocation failed.
+ */
+bool heatmapInit(heatmap_t *heatmap, cache_t *cache) {
+    memset((void *)heatmap, 0, sizeof(*heatmap));
+    heatmap->pCache = cache;
+    heatmap->iShadowLines =
+        (unsigned long)cache->iSetCount * cache->iCacheLinesPerSet;
+    heatmap->iShadowMru = HEATMAP_NONE;
+    heatmap->iShadowLru = HEATMAP_NONE;
+    heatmap->iLastPageIndex = HEATMAP_NONE;
+    heatmap->pSets = calloc(cache->iSetCount, sizeof(heatmapCounters_t));
+    if ((heatmap->pSets == NULL) || !heatmapTableInit(&heatmap->pages) ||
+        !heatmapTableInit(&heatmap->blocks)) {
+        heatmapFree(heatmap);
+        return false;
+    }
+    heatmap->pPages =
+        malloc((HEATMAP_INITIAL_SLOTS / 2) * sizeof(heatmapCounters_t));
+    heatmap->pShadow =
+        malloc((HEATMAP_INITIAL_SLOTS / 2) * sizeof(heatmapShadowLine_t));
+    if ((heatmap->pPages == NULL) || (heatmap->pShadow == NULL)) {
+        heatmapFree(heatmap);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Releases the instrumentation of a cache, but not the cache.
+ *
+ * @param[in,out]   heatmap_t *heatmap              Heatmap to release
+ *
+ * @return void.
+ */
+void heatmapFree(heatmap_t *heatmap) {
+    heatmapTableFree(&heatmap->pages);
+    heatmapTableFree(&heatmap->blocks);
+    free(heatmap->pSets);
+    free(heatmap->pPages);
+    free(heatmap->pShadow);
+    heatmap->pSets = NULL;
+    heatmap->pPages = NULL;
+    heatmap->pShadow = NULL;
+}
+
+/**
+ * @brief Parses a "name:start:size" region given to -R.
+ *
+ * Names are letters, digits, '_', '-' and '.', so they never need quoting
+ * in CSV or JSON. start and size are in C notation, 0x for hexadecimal.
+ *
+ * @param[in]       const char *spec                Region description
+ * @param[out]      heatmapRegion_t *region         Parsed region
+ *
+ * @return False if the description is malformed or the region empty.
+ */
+bool heatmapRegionParse(const char *spec, heatmapRegion_t *region) {
+    const char *colon = strchr(spec, ':');
+    size_t nameLength = (colon != NULL) ? (size_t)(colon - spec) : 0;
+    unsigned long size;
+    char *end;
+
+    if ((nameLength == 0) || (nameLength >= HEATMAP_NAME_LEN))
+        return false;
+    for (size_t i = 0; i < nameLength; i++) {
+        if (!isalnum((unsigned char)spec[i]) &&
+            (strchr("_-.", spec[i]) == NULL))
+            return false;
+    }
+    memcpy(region->aName, spec, nameLength);
+    region->aName[nameLength] = '\0';
+    if (!isdigit((unsigned char)colon[1]))
+        return false;
+    region->iStart = strtoul(colon + 1, &end, 0);
+    if ((*end != ':') || !isdigit((unsigned char)end[1]))
+        return false;
+    size = strtoul(end + 1, &end, 0);
+    if ((*end != '\0') || (size == 0) || (region->iStart > ULONG_MAX - size))
+        return false;
+    region->iEnd = region->iStart + size;
+    return true;
+}
+
+/**
+ * @brief Names a region, replacing the per-page breakdown.
+ *
+ * An access in several overlapping regions counts in the first one added.
+ *
+ * @param[in,out]   heatmap_t *heatmap              Heatmap
+ * @param[in]       const heatmapRegion_t *region   Region to add
+ *
+ * @return False if HEATMAP_MAX_REGIONS regions are already named.
+ */
+bool heatmapAddRegion(heatmap_t *heatmap, const heatmapRegion_t *region) {
+    if (heatmap->iRegionCount == HEATMAP_MAX_REGIONS)
+        return false;
+    heatmap->aRegions[heatmap->iRegionCount++] = *region;
+    return true;
+}
+
+/**
+ * @brief Unlinks a resident block from the shadow recency list.
+ */
+static inline void heatmapShadowUnlink(heatmap_t *heatmap,
+                                       unsigned int index) {
+    heatmapShadowLine_t *line = &heatmap->pShadow[index];
+
+    if (line->iPrev != HEATMAP_NONE)
+        heatmap->pShadow[line->iPrev].iNext = line->iNext;
+    else
+        heatmap->iShadowMru = line->iNext;
+    if (line->iNext != HEATMAP_NONE)
+        heatmap->pShadow[line->iNext].iPrev = line->iPrev;
+    else
+        heatmap->iShadowLru = line->iPrev;
+}
+
+/**
+ * @brief Accesses a block in the shadow fully associative LRU cache.
+ *
+ * @param[in,out]   heatmap_t *heatmap              Heatmap
+ * @param[in]       unsigned long block             Block accessed
+ * @param[out]      unsigned int *pMissClass        Class of a miss of the
+ * watched cache on this access
+ *
+ * @return False if the block table could not grow.
+ */
+static bool heatmapShadowAccess(heatmap_t *heatmap, unsigned long block,
+                                unsigned int *pMissClass) {
+    size_t capacity = heatmap->blocks.iCapacity;
+    heatmapShadowLine_t *line;
+    unsigned int index;
+    bool bAdded;
+
+    if (!heatmapTableIndex(&heatmap->blocks, block, &index, &bAdded))
+        return false;
+    if (heatmap->blocks.iCapacity != capacity) {
+        heatmapShadowLine_t *grown =
+            realloc(heatmap->pShadow,
+                    (heatmap->blocks.iCapacity / 2) * sizeof(*grown));
+        if (grown == NULL)
+            return false;
+        heatmap->pShadow = grown;
+    }
+    line = &heatmap->pShadow[index];
+    if (bAdded) {
+        line->bResident = false;
+        *pMissClass = HEATMAP_COMPULSORY;
+    } else if (line->bResident) {
+        *pMissClass = HEATMAP_CONFLICT;
+        if (index == heatmap->iShadowMru)
+            return true;
+        heatmapShadowUnlink(heatmap, index);
+    } else {
+        *pMissClass = HEATMAP_CAPACITY;
+    }
+    if (!line->bResident) {
+        line->bResident = true;
+        heatmap->iShadowResident++;
+    }
+    /* Insert as most recently used, then evict the LRU block if over */
+    line->iPrev = HEATMAP_NONE;
+    line->iNext = heatmap->iShadowMru;
+    if (heatmap->iShadowMru != HEATMAP_NONE)
+        heatmap->pShadow[heatmap->iShadowMru].iPrev = index;
+    else
+        heatmap->iShadowLru = index;
+    heatmap->iShadowMru = index;
+    if (heatmap->iShadowResident > heatmap->iShadowLines) {
+        unsigned int lru = heatmap->iShadowLru;
+        heatmapShadowUnlink(heatmap, lru);
+        heatmap->pShadow[lru].bResident = false;
+        heatmap->iShadowResident--;
+    }
+    return true;
+}
+
+/**
+ * @brief Counters of the region, named or page, holding an address.
+ *
+ * @return The counters, or NULL if the page table could not grow.
+ */
+static heatmapCounters_t *heatmapRegionOf(heatmap_t *heatmap,
+                                          unsigned long memAddr) {
+    unsigned long page = memAddr >> HEATMAP_PAGE_BITS;
+    size_t capacity = heatmap->pages.iCapacity;
+    unsigned int index;
+    bool bAdded;
+
+    if (heatmap->iRegionCount != 0) {
+        for (unsigned int i = 0; i < heatmap->iRegionCount; i++) {
+            if ((memAddr >= heatmap->aRegions[i].iStart) &&
+                (memAddr < heatmap->aRegions[i].iEnd))
+                return &heatmap->aRegionCounters[i];
+        }
+        return &heatmap->aRegionCounters[heatmap->iRegionCount];
+    }
+    /* Runs of accesses to one page skip the table */
+    if ((heatmap->iLastPageIndex != HEATMAP_NONE) &&
+        (heatmap->iLastPage == page))
+        return &heatmap->pPages[heatmap->iLastPageIndex];
+    if (!heatmapTableIndex(&heatmap->pages, page, &index, &bAdded))
+        return NULL;
+    if (heatmap->pages.iCapacity != capacity) {
+        heatmapCounters_t *grown =
+            realloc(heatmap->pPages,
+                    (heatmap->pages.iCapacity / 2) * sizeof(*grown));
+        if (grown == NULL)
+            return NULL;
+        heatmap->pPages = grown;
+    }
+    if (bAdded)
+        memset(&heatmap->pPages[index], 0, sizeof(heatmapCounters_t));
+    heatmap->iLastPage = page;
+    heatmap->iLastPageIndex = index;
+    return &heatmap->pPages[index];
+}
+
+/**
+ * @brief Simulates one access on the watched cache and records it.
+ *
+ * @param[in,out]   heatmap_t *heatmap              Heatmap
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * @param[in]       unsigned long memAddr           Memory address accessed
+ *
+ * @return False if the heap allocation for a new block or page failed.
+ */
+bool heatmapAccess(heatmap_t *heatmap, unsigned int memAccessType,
+                   unsigned long memAddr) {
+    cache_t *cache = heatmap->pCache;
+    unsigned long block = memAddr >> cache->iBlockBitCount;
+    unsigned long hits = cache->stats.hits;
+    unsigned long evictions = cache->stats.evictions;
+    heatmapCounters_t *set = &heatmap->pSets[block & (cache->iSetCount - 1)];
+    heatmapCounters_t *region;
+    unsigned int missClass;
+
+    checkSimulatorCache(cache, memAccessType, memAddr);
+    if (!heatmapShadowAccess(heatmap, block, &missClass))
+        return false;
+    region = heatmapRegionOf(heatmap, memAddr);
+    if (region == NULL)
+        return false;
+    if (cache->stats.hits != hits) {
+        heatmap->total.iHits++;
+        set->iHits++;
+        region->iHits++;
+    } else {
+        heatmap->total.iMisses[missClass]++;
+        set->iMisses[missClass]++;
+        region->iMisses[missClass]++;
+    }
+    if (cache->stats.evictions == evictions)
+        return true;
+    /* The victim shares the set, but may belong to another region */
+    heatmap->total.iEvictions++;
+    heatmap->total.iEvicted++;
+    set->iEvictions++;
+    set->iEvicted++;
+    region->iEvictions++;
+    region = heatmapRegionOf(heatmap, cache->victim.iAddress);
+    if (region == NULL)
+        return false;
+    region->iEvicted++;
+    return true;
+}
+
+/**
+ * @brief Records an access once for every block it touches.
+ *
+ * @param[in,out]   heatmap_t *heatmap              Heatmap
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * @param[in]       unsigned long memAddr           First byte accessed
+ * @param[in]       int byteSize                    Number of bytes accessed
+ *
+ * @return False if the heap allocation for a new block or page failed.
+ */
+bool heatmapAccessSpan(heatmap_t *heatmap, unsigned int memAccessType,
+                       unsigned long memAddr, int byteSize) {
+    unsigned int blockBits = heatmap->pCache->iBlockBitCount;
+    unsigned long block = memAddr >> blockBits;
+    unsigned long lastBlock = cacheSpanLastBlock(memAddr, byteSize, blockBits);
+    bool bRecorded = heatmapAccess(heatmap, memAccessType, memAddr);
+
+    while (bRecorded && (block != lastBlock)) {
+        block++;
+        bRecorded = heatmapAccess(heatmap, memAccessType, block << blockBits);
+    }
+    return bRecorded;
+}
+
+/**
+ * @brief Picks the output format from a file name, JSON for ".json".
+ *
+ * @param[in]       const char *path                Output file name
+ *
+ * @return HEATMAP_FORMAT_JSON or HEATMAP_FORMAT_CSV.
+ */
+unsigned int heatmapFormatFind(const char *path) {
+    size_t length = strlen(path);
+
+    if ((length >= 5) && (strcmp(path + length - 5, ".json") == 0))
+        return HEATMAP_FORMAT_JSON;
+    return HEATMAP_FORMAT_CSV;
+}
+
+/**
+ * @brief Writes the counter columns, or members, of one row.
+ */
+static void heatmapWriteCounters(FILE *out, const heatmapCounters_t *counters,
+                                 unsigned int format) {
+    unsigned long misses = counters->iMisses[HEATMAP_COMPULSORY] +
+                           counters->iMisses[HEATMAP_CAPACITY] +
+                           counters->iMisses[HEATMAP_CONFLICT];
+    const char *layout = (format == HEATMAP_FORMAT_JSON)
+                             ? "\"hits\": %lu, \"misses\": %lu, "
+                               "\"compulsory\": %lu, \"capacity\": %lu, "
+                               "\"conflict\": %lu, \"evictions\": %lu, "
+                               "\"evicted\": %lu"
+                             : "%lu,%lu,%lu,%lu,%lu,%lu,%lu";
+
+    fprintf(out, layout, counters->iHits, misses,
+            counters->iMisses[HEATMAP_COMPULSORY],
+            counters->iMisses[HEATMAP_CAPACITY],
+            counters->iMisses[HEATMAP_CONFLICT], counters->iEvictions,
+            counters->iEvicted);
+}
+
+/**
+ * @brief Orders sorted pages by page number.
+ */
+static int heatmapPageCompare(const void *a, const void *b) {
+    unsigned long pageA = ((const heatmapPageRef_t *)a)->iPage;
+    unsigned long pageB = ((const heatmapPageRef_t *)b)->iPage;
+
+    return (pageA > pageB) - (pageA < pageB);
+}
+
+/**
+ * @brief Writes one region row, named or page.
+ */
+static void heatmapWriteRegion(FILE *out, const char *scope, const char *name,
+                               unsigned long start, unsigned long end,
+                               const heatmapCounters_t *counters,
+                               unsigned int format, bool bFirst) {
+    if (format == HEATMAP_FORMAT_JSON)
+        fprintf(out,
+                "%s\n    {\"scope\": \"%s\", \"name\": \"%s\", "
+                "\"start\": \"0x%lx\", \"end\": \"0x%lx\", ",
+                bFirst ? "" : ",", scope, name, start, end);
+    else
+        fprintf(out, "%s,%s,0x%lx,0x%lx,", scope, name, start, end);
+    heatmapWriteCounters(out, counters, format);
+    fputs((format == HEATMAP_FORMAT_JSON) ? "}" : "\n", out);
+}
+
+/**
+ * @brief Writes every counter of a heatmap as CSV or JSON.
+ *
+ * CSV has one row per set, then per region, under a header line; the
+ * start and end columns of sets are empty. JSON holds the geometry, the
+ * whole-cache counters and "sets" and "regions" arrays. Region bounds are
+ * hexadecimal strings in both, 0x0 for "other", and pages are named after
+ * their first byte.
+ *
+ * @param[in]       const heatmap_t *heatmap        Heatmap
+ * @param[in,out]   FILE *out                       Output stream
+ * @param[in]       unsigned int format             One of HEATMAP_FORMAT_*
+ *
+ * @return False if the output could not be written or sorted.
+ */
+bool heatmapWrite(const heatmap_t *heatmap, FILE *out, unsigned int format) {
+    const cache_t *cache = heatmap->pCache;
+    bool bJson = (format == HEATMAP_FORMAT_JSON);
+    heatmapPageRef_t *pages = NULL;
+    size_t pageCount = 0;
+
+    if (heatmap->iRegionCount == 0) {
+        pages = malloc((heatmap->pages.iCount + 1) * sizeof(*pages));
+        if (pages == NULL)
+            return false;
+        for (size_t i = 0; i < heatmap->pages.iCapacity; i++) {
+            if (heatmap->pages.pSlots[i].iIndex == HEATMAP_NONE)
+                continue;
+            pages[pageCount].iPage = heatmap->pages.pSlots[i].iKey;
+            pages[pageCount].iIndex = heatmap->pages.pSlots[i].iIndex;
+            pageCount++;
+        }
+        qsort(pages, pageCount, sizeof(*pages), heatmapPageCompare);
+    }
+    if (bJson) {
+        fprintf(out, "{\n  \"s\": %u, \"E\": %u, \"b\": %u,\n  \"total\": {",
+                cache->iSetBitCount, cache->iCacheLinesPerSet,
+                cache->iBlockBitCount);
+        heatmapWriteCounters(out, &heatmap->total, format);
+        fputs("},\n  \"sets\": [", out);
+    } else {
+        fputs("scope,name,start,end,hits,misses,compulsory,capacity,"
+              "conflict,evictions,evicted\ncache,total,,,",
+              out);
+        heatmapWriteCounters(out, &heatmap->total, format);
+        fputs("\n", out);
+    }
+    for (unsigned int i = 0; i < cache->iSetCount; i++) {
+        if (bJson)
+            fprintf(out, "%s\n    {\"set\": %u, ", (i == 0) ? "" : ",", i);
+        else
+            fprintf(out, "set,%u,,,", i);
+        heatmapWriteCounters(out, &heatmap->pSets[i], format);
+        fputs(bJson ? "}" : "\n", out);
+    }
+    if (bJson)
+        fputs("\n  ],\n  \"regions\": [", out);
+    for (unsigned int i = 0; i < heatmap->iRegionCount; i++)
+        heatmapWriteRegion(out, "region", heatmap->aRegions[i].aName,
+                           heatmap->aRegions[i].iStart,
+                           heatmap->aRegions[i].iEnd,
+                           &heatmap->aRegionCounters[i], format, i == 0);
+    if (heatmap->iRegionCount != 0)
+        heatmapWriteRegion(out, "region", "other", 0, 0,
+                           &heatmap->aRegionCounters[heatmap->iRegionCount],
+                           format, false);
+    for (size_t i = 0; i < pageCount; i++) {
+        char name[2 * sizeof(unsigned long) + 3];
+        unsigned long start = pages[i].iPage << HEATMAP_PAGE_BITS;
+        snprintf(name, sizeof(name), "0x%lx", start);
+        heatmapWriteRegion(out, "page", name, start,
+                           start + (1UL << HEATMAP_PAGE_BITS),
+                           &heatmap->pPages[pages[i].iIndex], format, i == 0);
+    }
+    if (bJson)
+        fputs("\n  ]\n}\n", out);
+    free(pages);
+    return !ferror(out);
+}
@@ -0,0 +1,115 @@
+/**
+ * @file csim-heatmap.h
+ * @brief Per-set and per-region miss instrumentation of the cache simulator
+ *
+ * A heatmap_t watches one cache_t and attributes every access to the set
+ * and the address region it falls in. Misses are classified with the three
+ * Cs against a shadow fully associative LRU cache of the same capacity:
+ *  - compulsory  first access to the block
+ *  - capacity    the shadow cache misses too
+ *  - conflict    the shadow cache hits, the set was too small
+ *
+ * Regions are either the named address ranges given to heatmapAddRegion,
+ * with everything outside them counted as "other", or 4 KiB pages.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_HEATMAP_H
+#define CSIM_HEATMAP_H
+
+#include "csim.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** @brief Miss classes, indices of heatmapCounters_t iMisses */
+#define HEATMAP_COMPULSORY 0
+#define HEATMAP_CAPACITY 1
+#define HEATMAP_CONFLICT 2
+#define HEATMAP_MISS_CLASSES 3
+
+/** @brief Region size when no region is named */
+#define HEATMAP_PAGE_BITS 12
+
+/** @brief Limits on named regions */
+#define HEATMAP_MAX_REGIONS 16
+#define HEATMAP_NAME_LEN 16
+
+/** @brief Empty heatmapTable_t slot */
+#define HEATMAP_NONE UINT_MAX
+
+/** @brief Output formats of heatmapWrite */
+#define HEATMAP_FORMAT_CSV 0
+#define HEATMAP_FORMAT_JSON 1
+
+/* Counters of one set or region */
+typedef struct {
+    unsigned long iHits;                         /* Hits */
+    unsigned long iMisses[HEATMAP_MISS_CLASSES]; /* Misses of each class */
+    unsigned long iEvictions;                    /* Evictions it caused */
+    unsigned long iEvicted;                      /* Its lines evicted */
+} heatmapCounters_t;
+
+/* Named address range, [iStart, iEnd) */
+typedef struct {
+    char aName[HEATMAP_NAME_LEN]; /* Name given to -R */
+    unsigned long iStart;         /* First byte */
+    unsigned long iEnd;           /* One past the last byte */
+} heatmapRegion_t;
+
+/* Slot of a heatmapTable_t, key and index share a cache line */
+typedef struct {
+    unsigned long iKey;  /* Block or page number */
+    unsigned int iIndex; /* Index into the owner's array, or HEATMAP_NONE */
+} heatmapSlot_t;
+
+/* Open addressed map from block or page number to an array index */
+typedef struct {
+    heatmapSlot_t *pSlots; /* Slots, empty ones have index HEATMAP_NONE */
+    size_t iCapacity;      /* Slots, a power of two */
+    size_t iCount;         /* Occupied slots, also the next index */
+} heatmapTable_t;
+
+/* Block seen by the shadow cache, kept once evicted to spot reuse */
+typedef struct {
+    unsigned int iPrev; /* More recently used resident block */
+    unsigned int iNext; /* Less recently used resident block */
+    bool bResident;     /* Held by the shadow cache */
+} heatmapShadowLine_t;
+
+/* Instrumentation of one simulated cache */
+typedef struct {
+    cache_t *pCache;               /* Watched cache */
+    heatmapCounters_t *pSets;      /* Counters of every set */
+    /* Named regions */
+    heatmapRegion_t aRegions[HEATMAP_MAX_REGIONS];
+    unsigned int iRegionCount;     /* Named regions, 0 for pages */
+    /* Counters of every named region, then of "other" */
+    heatmapCounters_t aRegionCounters[HEATMAP_MAX_REGIONS + 1];
+    heatmapTable_t pages;          /* Pages seen so far */
+    heatmapCounters_t *pPages;     /* Counters of every page */
+    unsigned long iLastPage;       /* Page of the latest lookup */
+    unsigned int iLastPageIndex;   /* Its index, HEATMAP_NONE before any */
+    heatmapTable_t blocks;         /* Blocks seen so far */
+    heatmapShadowLine_t *pShadow;  /* Shadow state of every block */
+    unsigned long iShadowLines;    /* Shadow capacity, S * E */
+    unsigned long iShadowResident; /* Blocks in the shadow cache */
+    unsigned int iShadowMru;       /* Most recently used block */
+    unsigned int iShadowLru;       /* Least recently used block */
+    heatmapCounters_t total;       /* Counters of the whole cache */
+} heatmap_t;
+
+/* Function prototyping */
+bool heatmapInit(heatmap_t *heatmap, cache_t *cache);
+void heatmapFree(heatmap_t *heatmap);
+bool heatmapRegionParse(const char *spec, heatmapRegion_t *region);
+bool heatmapAddRegion(heatmap_t *heatmap, const heatmapRegion_t *region);
+bool heatmapAccess(heatmap_t *heatmap, unsigned int memAccessType,
+                   unsigned long memAddr);
+bool heatmapAccessSpan(heatmap_t *heatmap, unsigned int memAccessType,
+                       unsigned long memAddr, int byteSize);
+unsigned int heatmapFormatFind(const char *path);
+bool heatmapWrite(const heatmap_t *heatmap, FILE *out, unsigned int format);
+
+#endif /* CSIM_HEATMAP_H */
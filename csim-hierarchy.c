@@ -0,0 +1,244 @@
+/**
+ * @file csim-hierarchy.c
+ * @brief Multi-level cache hierarchy built from the single-level engine
+ *
+ * Each level is an ordinary cache_t, driven through the same probe, fill and
+ * eviction code as a single cache. An access is looked up level by level with
+ * cacheAccessIfPresent until one hits, then the levels that missed are filled
+ * from the bottom up, the way the block travels back towards the processor.
+ * Filling the lower levels first matters for an inclusive hierarchy: the
+ * lines they evict are invalidated above before the upper levels choose
+ * their own victims, so they can reuse the freed lines.
+ *
+ * Every fill leaves the line it displaced in the level's cache_t victim
+ * record. A dirty victim is written back to the next level, which allocates
+ * it if absent, and a victim of the last level goes to memory, which only
+ * shows up as that level's dirty_bytes_evicted. A dirty line invalidated
+ * from an upper level counts as a dirty eviction of that level and makes the
+ * lower victim dirty too.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-hierarchy.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Function prototyping */
+static void hierarchyAccessExclusive(cacheHierarchy_t *hierarchy,
+                                     unsigned int memAccessType,
+                                     unsigned long memAddr);
+static void hierarchyFill(cacheHierarchy_t *hierarchy, unsigned int level,
+                          unsigned int memAccessType, unsigned long memAddr);
+static void hierarchyInsert(cacheHierarchy_t *hierarchy, unsigned int level,
+                            unsigned long memAddr, bool bDirty);
+static void hierarchyEvicted(cacheHierarchy_t *hierarchy, unsigned int level);
+
+/**
+ * @brief Looks up an inclusion policy by the name given to -I.
+ *
+ * @param[in]       const char *name                nine, inclusive or
+ * exclusive
+ * @param[out]      unsigned int *pInclusion        Matching HIERARCHY_* value
+ *
+ * @return False if the name is unknown.
+ */
+bool hierarchyInclusionFind(const char *name, unsigned int *pInclusion) {
+    if (strcmp(name, "nine") == 0)
+        *pInclusion = HIERARCHY_NINE;
+    else if (strcmp(name, "inclusive") == 0)
+        *pInclusion = HIERARCHY_INCLUSIVE;
+    else if (strcmp(name, "exclusive") == 0)
+        *pInclusion = HIERARCHY_EXCLUSIVE;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Allocates every level of a cache hierarchy.
+ *
+ * Victims are passed between levels as whole blocks, so every level must use
+ * the same block size.
+ *
+ * @param[out]      cacheHierarchy_t *hierarchy     Hierarchy to initialise
+ * @param[in]       const cacheConfig_t *levels     Geometry of each level,
+ * level 0 first
+ * @param[in]       unsigned int levelCount         Number of levels, at most
+ * HIERARCHY_MAX_LEVELS
+ * @param[in]       unsigned int inclusion          One of HIERARCHY_*
+ * @param[in]       const cachePolicy_t *policy     Replacement policy of every
+ * level, which must support each level's associativity
+ *
+ * @return True on success, false if the heap allocation failed.
+ */
+bool hierarchyInit(cacheHierarchy_t *hierarchy, const cacheConfig_t *levels,
+                   unsigned int levelCount, unsigned int inclusion,
+                   const cachePolicy_t *policy) {
+    memset((void *)hierarchy, 0, sizeof(*hierarchy));
+    hierarchy->iInclusion = inclusion;
+    hierarchy->pLevels = calloc(levelCount, sizeof(cache_t));
+    hierarchy->pBackInvalidations = calloc(levelCount, sizeof(unsigned long));
+    if ((hierarchy->pLevels == NULL) ||
+        (hierarchy->pBackInvalidations == NULL)) {
+        hierarchyFree(hierarchy);
+        return false;
+    }
+    while (hierarchy->iLevelCount < levelCount) {
+        const cacheConfig_t *config = &levels[hierarchy->iLevelCount];
+        if (!cacheInit(&hierarchy->pLevels[hierarchy->iLevelCount],
+                       config->iSetBitCount, config->iCacheLinesPerSet,
+                       config->iBlockBitCount, policy)) {
+            hierarchyFree(hierarchy);
+            return false;
+        }
+        hierarchy->iLevelCount++;
+    }
+    return true;
+}
+
+/**
+ * @brief Releases every level of a cache hierarchy.
+ *
+ * @param[in,out]   cacheHierarchy_t *hierarchy     Hierarchy to release
+ *
+ * @return void.
+ */
+void hierarchyFree(cacheHierarchy_t *hierarchy) {
+    for (unsigned int i = 0; i < hierarchy->iLevelCount; i++)
+        cacheFree(&hierarchy->pLevels[i]);
+    free(hierarchy->pLevels);
+    free(hierarchy->pBackInvalidations);
+    hierarchy->pLevels = NULL;
+    hierarchy->pBackInvalidations = NULL;
+    hierarchy->iLevelCount = 0;
+}
+
+/**
+ * @brief Simulates one access through the hierarchy.
+ *
+ * Only level 0 sees the access type, lower levels are read on a miss and
+ * only become dirty through write-backs.
+ *
+ * @param[in,out]   cacheHierarchy_t *hierarchy     Simulated hierarchy
+ * @param[in]       unsigned int memAccessType      Type of memory access
+ * @param[in]       unsigned long memAddr           Memory address accessed
+ *
+ * @return void.
+ */
+void hierarchyAccess(cacheHierarchy_t *hierarchy, unsigned int memAccessType,
+                     unsigned long memAddr) {
+    unsigned int hitLevel = 1;
+
+    if (cacheAccessIfPresent(&hierarchy->pLevels[0], memAccessType, memAddr))
+        return;
+    if (hierarchy->iInclusion == HIERARCHY_EXCLUSIVE) {
+        hierarchyAccessExclusive(hierarchy, memAccessType, memAddr);
+        return;
+    }
+    while ((hitLevel < hierarchy->iLevelCount) &&
+           !cacheAccessIfPresent(&hierarchy->pLevels[hitLevel], 0, memAddr))
+        hitLevel++;
+    /* Fill the levels that missed, closest to memory first */
+    for (unsigned int i = hitLevel; i-- > 1;)
+        hierarchyFill(hierarchy, i, 0, memAddr);
+    hierarchyFill(hierarchy, 0, memAccessType, memAddr);
+}
+
+/**
+ * @brief Simulates a level 0 miss of an exclusive hierarchy.
+ *
+ * The level holding the block gives it up to level 0, dirty or not, and
+ * levels without it count a miss. Nothing but level 0 is filled; its victim
+ * cascades down through hierarchyEvicted.
+ */
+static void hierarchyAccessExclusive(cacheHierarchy_t *hierarchy,
+                                     unsigned int memAccessType,
+                                     unsigned long memAddr) {
+    bool bDirty = false;
+
+    for (unsigned int i = 1; i < hierarchy->iLevelCount; i++) {
+        cache_t *level = &hierarchy->pLevels[i];
+        if (cacheInvalidate(level, memAddr, &bDirty)) {
+            level->stats.hits++;
+            break;
+        }
+        level->stats.misses++;
+    }
+    hierarchyFill(hierarchy, 0, (bDirty ? 1 : memAccessType), memAddr);
+}
+
+/**
+ * @brief Fills a block into a level that missed it.
+ */
+static void hierarchyFill(cacheHierarchy_t *hierarchy, unsigned int level,
+                          unsigned int memAccessType, unsigned long memAddr) {
+    cache_t *cache = &hierarchy->pLevels[level];
+
+    cache->victim.bValid = false;
+    checkSimulatorCache(cache, memAccessType, memAddr);
+    if (cache->victim.bValid)
+        hierarchyEvicted(hierarchy, level);
+}
+
+/**
+ * @brief Places a block coming from the level above without an access.
+ */
+static void hierarchyInsert(cacheHierarchy_t *hierarchy, unsigned int level,
+                            unsigned long memAddr, bool bDirty) {
+    cache_t *cache = &hierarchy->pLevels[level];
+
+    cache->victim.bValid = false;
+    cacheInsert(cache, memAddr, bDirty);
+    if (cache->victim.bValid)
+        hierarchyEvicted(hierarchy, level);
+}
+
+/**
+ * @brief Passes the victim of a level's latest fill on.
+ *
+ * An inclusive hierarchy first invalidates the block in every level above,
+ * merging their dirty state into the victim. The victim is then written back
+ * to the next level if dirty, or moved there in any case when the hierarchy
+ * is exclusive. Each step only recurses downwards, so the cascade stops at
+ * the last level.
+ */
+static void hierarchyEvicted(cacheHierarchy_t *hierarchy, unsigned int level) {
+    cacheVictim_t victim = hierarchy->pLevels[level].victim;
+    bool bDirty = victim.bDirty;
+
+    if (hierarchy->iInclusion == HIERARCHY_INCLUSIVE) {
+        for (unsigned int i = 0; i < level; i++) {
+            bool bUpperDirty = false;
+            if (!cacheInvalidate(&hierarchy->pLevels[i], victim.iAddress,
+                                 &bUpperDirty))
+                continue;
+            hierarchy->pBackInvalidations[i]++;
+            if (bUpperDirty) {
+                hierarchy->pLevels[i].iDirtyEvictions++;
+                bDirty = true;
+            }
+        }
+        /* The eviction already counted if the level's own copy was dirty */
+        if (bDirty && !victim.bDirty)
+            hierarchy->pLevels[level].iDirtyEvictions++;
+    }
+    if ((level + 1 < hierarchy->iLevelCount) &&
+        (bDirty || (hierarchy->iInclusion == HIERARCHY_EXCLUSIVE)))
+        hierarchyInsert(hierarchy, level + 1, victim.iAddress, bDirty);
+}
+
+/**
+ * @brief Computes the final statistics of one level.
+ *
+ * @param[in]       const cacheHierarchy_t *hierarchy   Simulated hierarchy
+ * @param[in]       unsigned int level                  Level, 0 first
+ * @param[out]      csim_stats_t *stats                 Level statistics
+ *
+ * @return void.
+ */
+void hierarchySummary(const cacheHierarchy_t *hierarchy, unsigned int level,
+                      csim_stats_t *stats) {
+    cacheSummary(&hierarchy->pLevels[level], stats);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file csim-hierarchy.h
+ * @brief Multi-level cache hierarchy built from the single-level engine
+ *
+ * Level 0 is the cache closest to the processor. An access that misses in a
+ * level goes on to the next one, and lines evicted from a level are written
+ * back to, or with an exclusive hierarchy moved down to, the level below.
+ * Every level keeps its own csim_stats_t.
+ *
+ * Inclusion policies:
+ *  - nine       non-inclusive non-exclusive, fills every level that missed
+ *               and never invalidates
+ *  - inclusive  as nine, and a line evicted from a level is invalidated in
+ *               every level above it
+ *  - exclusive  a block lives in one level at a time, fills only level 0
+ *               and moves every victim one level down
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_HIERARCHY_H
+#define CSIM_HIERARCHY_H
+
+#include "csim.h"
+#include <stdbool.h>
+
+/** @brief Inclusion policies */
+#define HIERARCHY_NINE 0
+#define HIERARCHY_INCLUSIVE 1
+#define HIERARCHY_EXCLUSIVE 2
+
+/** @brief Upper limit on the number of cache levels */
+#define HIERARCHY_MAX_LEVELS 8
+
+/* Cache levels and the inclusion policy that ties them together */
+typedef struct {
+    cache_t *pLevels;                  /* Level 0 first */
+    unsigned int iLevelCount;          /* Number of levels */
+    unsigned int iInclusion;           /* One of HIERARCHY_* */
+    unsigned long *pBackInvalidations; /* Lines invalidated in each level */
+} cacheHierarchy_t;
+
+/* Function prototyping */
+bool hierarchyInclusionFind(const char *name, unsigned int *pInclusion);
+bool hierarchyInit(cacheHierarchy_t *hierarchy, const cacheConfig_t *levels,
+                   unsigned int levelCount, unsigned int inclusion,
+                   const cachePolicy_t *policy);
+void hierarchyFree(cacheHierarchy_t *hierarchy);
+void hierarchyAccess(cacheHierarchy_t *hierarchy, unsigned int memAccessType,
+                     unsigned long memAddr);
+void hierarchySummary(const cacheHierarchy_t *hierarchy, unsigned int level,
+                      csim_stats_t *stats);
+
+#endif /* CSIM_HIERARCHY_H */
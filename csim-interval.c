@@ -0,0 +1,145 @@
+/**
+ * @file csim-interval.c
+ * @brief Windowed statistics of the cache simulator
+ *
+ * CSV output starts with a header line and has a row per cache and
+ * window. JSON output is JSON Lines, one object per cache and window, so
+ * a reader can parse the stream before it ends. Counters are the change
+ * over the window, computed from cacheSummary at either end of it, except
+ * for the dirty bytes still in the cache, which are a level. A sampled
+ * cache reports the estimates of cacheSummary and the s it estimates, the
+ * counters of each window scaled by its own accesses, as cumulative ratio
+ * estimates need not grow with every window.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-interval.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Opens the first window of a run.
+ *
+ * The caches' counters so far, such as those of a warm-start snapshot,
+ * are the baseline of the first window.
+ *
+ * @param[out]      interval_t *interval            Windows to initialise
+ * @param[in,out]   FILE *file                      Stream rows go to
+ * @param[in]       unsigned int format             One of INTERVAL_FORMAT_*
+ * @param[in]       const cache_t *caches           Simulated caches
+ * @param[in]       unsigned int cacheCount         Number of caches
+ * @param[in]       unsigned long length            Records per window, not 0
+ *
+ * @return False if the heap allocation failed.
+ */
+bool intervalInit(interval_t *interval, FILE *file, unsigned int format,
+                  const cache_t *caches, unsigned int cacheCount,
+                  unsigned long length) {
+    interval->pLast = calloc(cacheCount, sizeof(csim_stats_t));
+    interval->pLastAccesses = calloc(cacheCount, sizeof(unsigned long));
+    if (interval->pLast == NULL || interval->pLastAccesses == NULL) {
+        intervalFree(interval);
+        return false;
+    }
+    interval->pFile = file;
+    interval->iFormat = format;
+    interval->pCaches = caches;
+    interval->iCacheCount = cacheCount;
+    interval->iLength = length;
+    interval->iWindow = 0;
+    interval->iWindowStart = 0;
+    interval->iWindowEnd = length;
+    interval->iRecords = 0;
+    for (unsigned int i = 0; i < cacheCount; i++) {
+        cacheSampledSummary(&caches[i], &interval->pLast[i]);
+        interval->pLastAccesses[i] = caches[i].iSampleAccesses;
+    }
+    if (format == INTERVAL_FORMAT_CSV)
+        fputs("window,first_record,records,cache,s,E,b,hits,misses,"
+              "evictions,dirty_bytes_in_cache,dirty_bytes_evicted\n",
+              file);
+    return true;
+}
+
+/**
+ * @brief Releases the baseline counters of a run's windows.
+ *
+ * @param[in,out]   interval_t *interval            Windows
+ *
+ * @return void.
+ */
+void intervalFree(interval_t *interval) {
+    free(interval->pLast);
+    free(interval->pLastAccesses);
+    interval->pLast = NULL;
+    interval->pLastAccesses = NULL;
+}
+
+/**
+ * @brief Closes the open window at the current record and opens the next.
+ *
+ * @param[in,out]   interval_t *interval            Windows
+ *
+ * @return void.
+ */
+void intervalWrite(interval_t *interval) {
+    const char *layout =
+        (interval->iFormat == INTERVAL_FORMAT_JSON)
+            ? "{\"window\": %lu, \"first_record\": %lu, \"records\": %lu, "
+              "\"cache\": %u, \"s\": %u, \"E\": %u, \"b\": %u, "
+              "\"hits\": %lu, \"misses\": %lu, \"evictions\": %lu, "
+              "\"dirty_bytes_in_cache\": %lu, "
+              "\"dirty_bytes_evicted\": %lu}\n"
+            : "%lu,%lu,%lu,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%lu\n";
+
+    for (unsigned int i = 0; i < interval->iCacheCount; i++) {
+        const cache_t *cache = &interval->pCaches[i];
+        csim_stats_t *last = &interval->pLast[i];
+        csim_stats_t stats;
+
+        csim_stats_t window;
+        csim_stats_t level;
+
+        cacheSampledSummary(cache, &stats);
+        window.hits = stats.hits - last->hits;
+        window.misses = stats.misses - last->misses;
+        window.evictions = stats.evictions - last->evictions;
+        window.dirty_bytes = stats.dirty_bytes;
+        window.dirty_evictions = stats.dirty_evictions - last->dirty_evictions;
+        if (cache->iSampleBits != 0) {
+            cacheSampleEstimate(&window, cache->iSampleAccesses -
+                                             interval->pLastAccesses[i]);
+            cacheSummary(cache, &level);
+            window.dirty_bytes = level.dirty_bytes;
+        }
+        fprintf(interval->pFile, layout, interval->iWindow,
+                interval->iWindowStart,
+                interval->iRecords - interval->iWindowStart, i,
+                cache->iSetBitCount + cache->iSampleBits,
+                cache->iCacheLinesPerSet, cache->iBlockBitCount, window.hits,
+                window.misses, window.evictions, window.dirty_bytes,
+                window.dirty_evictions);
+        *last = stats;
+        interval->pLastAccesses[i] = cache->iSampleAccesses;
+    }
+    fflush(interval->pFile);
+    interval->iWindow++;
+    interval->iWindowStart = interval->iRecords;
+    interval->iWindowEnd = interval->iRecords + interval->iLength;
+}
+
+/**
+ * @brief Closes the last window, if it holds any record, at the end of a
+ * run.
+ *
+ * @param[in,out]   interval_t *interval            Windows
+ *
+ * @return False if a row could not be written.
+ */
+bool intervalFinish(interval_t *interval) {
+    if (interval->iRecords != interval->iWindowStart)
+        intervalWrite(interval);
+    return !ferror(interval->pFile);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file csim-interval.h
+ * @brief Windowed statistics of the cache simulator
+ *
+ * An interval_t splits a run into windows of a fixed number of trace
+ * records and writes one row per simulated cache as each window closes:
+ * the hits, misses, evictions and dirty bytes evicted during the window,
+ * and the dirty bytes held at its end. Rows are flushed as they are
+ * written, so a long simulation can be followed while it runs, and a
+ * change of working set shows up as a step in the miss counts.
+ *
+ * The simulation loops count records themselves and call intervalWrite at
+ * iWindowEnd, so between windows the cost is one increment and compare per
+ * record or run.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_INTERVAL_H
+#define CSIM_INTERVAL_H
+
+#include "csim.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/** @brief Output formats of intervalInit */
+#define INTERVAL_FORMAT_CSV 0
+#define INTERVAL_FORMAT_JSON 1
+
+/* Windows of one run */
+typedef struct {
+    FILE *pFile;                  /* Output stream */
+    unsigned int iFormat;         /* One of INTERVAL_FORMAT_* */
+    const cache_t *pCaches;       /* Simulated caches */
+    unsigned int iCacheCount;     /* Number of caches */
+    csim_stats_t *pLast;          /* Unscaled counters of each at its start */
+    unsigned long *pLastAccesses; /* iSampleAccesses of each then */
+    unsigned long iLength;        /* Records per window */
+    unsigned long iWindow;        /* Index of the open window */
+    unsigned long iWindowStart;   /* Its first record */
+    unsigned long iWindowEnd;     /* Record count that closes it */
+    unsigned long iRecords;       /* Records simulated so far */
+} interval_t;
+
+/* Function prototyping */
+bool intervalInit(interval_t *interval, FILE *file, unsigned int format,
+                  const cache_t *caches, unsigned int cacheCount,
+                  unsigned long length);
+void intervalFree(interval_t *interval);
+void intervalWrite(interval_t *interval);
+bool intervalFinish(interval_t *interval);
+
+#endif /* CSIM_INTERVAL_H */
@@ -0,0 +1,280 @@
+/**
+ * @file csim-lib.c
+ * @brief In-process interface to the cache simulator
+ *
+ * A csim_t wraps one cache_t of csim-cache.c together with the access type
+ * bookkeeping of csim's main loop: a record whose type is neither 'L' nor
+ * 'S' repeats the type of the previous load or store, exactly as csim
+ * treats it.
+ *
+ * Runs of consecutive accesses to one block are simulated as a probe for
+ * the first access and a burst of hits for the rest, see cacheRepeatHits,
+ * unless a write policy other than write-back write-allocate is set.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-lib.h"
+#include "csim-policy.h"
+#include "csim.h"
+#include <stdlib.h>
+
+/* Simulator handle */
+struct csim {
+    cache_t cache;               /* Simulated cache */
+    unsigned int iMemAccessType; /* 0 after a load, 1 after a store */
+};
+
+/**
+ * @brief Creates a simulator for one cache geometry.
+ *
+ * @param[in]       unsigned int s                  Number of set index bits
+ * @param[in]       unsigned int E                  Number of lines per set
+ * @param[in]       unsigned int b                  Number of block bits
+ * @param[in]       const char *policy              Replacement policy name
+ * as given to csim -p, NULL for LRU
+ *
+ * @return The simulator, or NULL if the geometry or policy is invalid or
+ * the heap allocation failed.
+ */
+csim_t *csim_create(unsigned int s, unsigned int E, unsigned int b,
+                    const char *policy) {
+    const cachePolicy_t *pPolicy =
+        (policy != NULL) ? cachePolicyFind(policy) : &cacheLruPolicy;
+    csim_t *sim;
+
+    if ((pPolicy == NULL) || (E == 0) || (s >= ADDRESS_BITS_LEN) ||
+        (b >= ADDRESS_BITS_LEN - s) || !pPolicy->isSupported(E))
+        return NULL;
+    sim = calloc(1, sizeof(*sim));
+    if (sim == NULL)
+        return NULL;
+    if (!cacheInit(&sim->cache, s, E, b, pPolicy)) {
+        free(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+/**
+ * @brief Whether runs of accesses to one block may be simulated as bursts.
+ */
+static inline bool csim_runs_exact(const csim_t *sim) {
+    return (sim->cache.iWritePolicy == 0) && (sim->cache.iWriteBufferSize == 0);
+}
+
+/**
+ * @brief Releases a simulator.
+ *
+ * @param[in]       csim_t *sim                     Simulator, may be NULL
+ *
+ * @return void.
+ */
+void csim_destroy(csim_t *sim) {
+    if (sim == NULL)
+        return;
+    cacheFree(&sim->cache);
+    free(sim);
+}
+
+/**
+ * @brief Sets the write policy of a simulator that has simulated nothing.
+ *
+ * @param[in,out]   csim_t *sim                     Simulator
+ * @param[in]       const char *policy              Write policy as given to
+ * csim -w, such as "wt-nwa:8"
+ *
+ * @return False if the policy is invalid or the heap allocation failed, in
+ * which case the simulator keeps write-back write-allocate.
+ */
+bool csim_set_write_policy(csim_t *sim, const char *policy) {
+    unsigned int writePolicy;
+    unsigned int bufferSize;
+
+    return cacheWritePolicyFind(policy, &writePolicy, &bufferSize) &&
+           cacheSetWritePolicy(&sim->cache, writePolicy, bufferSize);
+}
+
+/**
+ * @brief Simulates one access.
+ *
+ * @param[in,out]   csim_t *sim                     Simulator
+ * @param[in]       char accessType                 'L' for load, 'S' for
+ * store
+ * @param[in]       unsigned long address           Memory address accessed
+ *
+ * @return void.
+ */
+void csim_access(csim_t *sim, char accessType, unsigned long address) {
+    if (accessType == 'L')
+        sim->iMemAccessType = 0;
+    else if (accessType == 'S')
+        sim->iMemAccessType = 1;
+    checkSimulatorCache(&sim->cache, sim->iMemAccessType, address);
+}
+
+/**
+ * @brief Simulates an array of trace records in order.
+ *
+ * Record sizes are ignored, as by csim without -S.
+ *
+ * @param[in,out]   csim_t *sim                     Simulator
+ * @param[in]       const traceRecord_t *records    Records to simulate
+ * @param[in]       size_t count                    Number of records
+ *
+ * @return void.
+ */
+void csim_access_batch(csim_t *sim, const traceRecord_t *records,
+                       size_t count) {
+    unsigned int blockBits = sim->cache.iBlockBitCount;
+    size_t i = 0;
+
+    if (!csim_runs_exact(sim)) {
+        for (i = 0; i < count; i++)
+            csim_access(sim, records[i].accessType, records[i].address);
+        return;
+    }
+    while (i < count) {
+        unsigned long address = records[i].address;
+        unsigned long repeats = 0;
+        bool bDirty = false;
+
+        csim_access(sim, records[i].accessType, address);
+        for (i++; (i < count) && ((records[i].address >> blockBits) ==
+                                  (address >> blockBits));
+             i++) {
+            if (records[i].accessType == 'L')
+                sim->iMemAccessType = 0;
+            else if (records[i].accessType == 'S')
+                sim->iMemAccessType = 1;
+            repeats++;
+            bDirty = bDirty || (sim->iMemAccessType == 1);
+        }
+        cacheRepeatHits(&sim->cache, address, repeats, bDirty);
+    }
+}
+
+/**
+ * @brief Simulates every record of a text or binary trace file.
+ *
+ * @param[in,out]   csim_t *sim                     Simulator
+ * @param[in]       const char *fileName            Trace file, "-" for
+ * standard input
+ *
+ * @return False if the trace could not be opened.
+ */
+bool csim_run_trace(csim_t *sim, const char *fileName) {
+    traceReader_t reader;
+
+    if (!traceReaderOpen(&reader, fileName))
+        return false;
+    (void)csim_run_reader(sim, &reader, NULL);
+    traceReaderClose(&reader);
+    return true;
+}
+
+/**
+ * @brief Simulates every remaining record of an open trace.
+ *
+ * Records are simulated as they are parsed, so a trace streamed through a
+ * pipe is simulated while its writer is still producing it. The reader is
+ * drained even if copying fails, so the writer never blocks on a full pipe.
+ *
+ * @param[in,out]   csim_t *sim                     Simulator
+ * @param[in,out]   traceReader_t *reader           Open trace
+ * @param[in,out]   traceWriter_t *copy             Writer every record is
+ * also appended to, NULL for none
+ *
+ * @return False if a record could not be copied.
+ */
+bool csim_run_reader(csim_t *sim, traceReader_t *reader, traceWriter_t *copy) {
+    return csim_run_readers(&sim, 1, reader, copy);
+}
+
+/**
+ * @brief Simulates every remaining record of an open trace on several
+ * simulators.
+ *
+ * As csim_run_reader, with the trace parsed once for all of them. The
+ * simulators must have simulated the same accesses so far. Runs are formed
+ * at the smallest block size, and only if every simulator allows them.
+ *
+ * @param[in,out]   csim_t *const *sims             Simulators
+ * @param[in]       size_t count                    Number of simulators
+ * @param[in,out]   traceReader_t *reader           Open trace
+ * @param[in,out]   traceWriter_t *copy             Writer every record is
+ * also appended to, NULL for none
+ *
+ * @return False if a record could not be copied.
+ */
+bool csim_run_readers(csim_t *const *sims, size_t count, traceReader_t *reader,
+                      traceWriter_t *copy) {
+    traceCoalescer_t coalescer;
+    traceRecord_t record;
+    traceRun_t run;
+    unsigned int blockBits = sims[0]->cache.iBlockBitCount;
+    bool bRuns = (copy == NULL);
+    bool bCopied = true;
+
+    for (size_t k = 0; k < count; k++) {
+        if (!csim_runs_exact(sims[k]))
+            bRuns = false;
+        if (sims[k]->cache.iBlockBitCount < blockBits)
+            blockBits = sims[k]->cache.iBlockBitCount;
+    }
+    /* The copy needs every record as it was read */
+    if (!bRuns) {
+        while (traceReaderNext(reader, &record)) {
+            for (size_t k = 0; k < count; k++)
+                csim_access(sims[k], record.accessType, record.address);
+            if ((copy != NULL) && bCopied)
+                bCopied = traceWriterPut(copy, &record);
+        }
+        return bCopied;
+    }
+
+    traceCoalescerInit(&coalescer, reader, blockBits, false);
+    coalescer.accessType = (sims[0]->iMemAccessType == 1) ? 'S' : 'L';
+    while (traceCoalescerNext(&coalescer, &run)) {
+        for (size_t k = 0; k < count; k++) {
+            csim_access(sims[k], run.first.accessType, run.first.address);
+            cacheRepeatHits(&sims[k]->cache, run.first.address, run.iRepeats,
+                            run.bDirty);
+        }
+    }
+    for (size_t k = 0; k < count; k++)
+        sims[k]->iMemAccessType = (coalescer.accessType == 'S') ? 1 : 0;
+    return true;
+}
+
+/**
+ * @brief Computes the statistics of the accesses simulated so far.
+ *
+ * @param[in]       const csim_t *sim               Simulator
+ * @param[out]      csim_stats_t *stats             Statistics, as csim would
+ * pass them to printSummary
+ *
+ * @return void.
+ */
+void csim_stats(const csim_t *sim, csim_stats_t *stats) {
+    cacheSummary(&sim->cache, stats);
+}
+
+/**
+ * @brief Reports the stores the write policy sent on past the cache.
+ *
+ * All zero under write-back write-allocate, whose only writes to memory
+ * are the dirty evictions of csim_stats.
+ *
+ * @param[in]       const csim_t *sim               Simulator
+ * @param[out]      csim_write_stats_t *stats       Write counters
+ *
+ * @return void.
+ */
+void csim_write_stats(const csim_t *sim, csim_write_stats_t *stats) {
+    stats->writes = sim->cache.write.iWrites;
+    stats->combined = sim->cache.write.iCombined;
+    stats->memory_writes = sim->cache.write.iTransactions;
+    stats->buffered = sim->cache.iWriteBufferCount;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file csim-lib.h
+ * @brief In-process interface to the cache simulator
+ *
+ * Drivers such as test-trans link libcsim.a and simulate traces through a
+ * csim_t instead of running a simulator binary and reading its results
+ * back from .csim_results. Accesses count as touching the block of their
+ * first byte, as in csim-ref, so the statistics match csim-ref's for the
+ * default LRU policy. Each csim_t is independent, so separate threads may
+ * each drive their own.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_LIB_H
+#define CSIM_LIB_H
+
+#include "cachelab.h"
+#include "csim-trace.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct csim csim_t;
+
+/* Stores a write policy sends on past the cache, see csim_set_write_policy */
+typedef struct {
+    unsigned long writes;        /* Stores written through or around */
+    unsigned long combined;      /* Of these, merged into a buffered block */
+    unsigned long memory_writes; /* Block writes that reached memory */
+    unsigned long buffered;      /* Blocks still in the write buffer */
+} csim_write_stats_t;
+
+/* Function prototyping */
+csim_t *csim_create(unsigned int s, unsigned int E, unsigned int b,
+                    const char *policy);
+void csim_destroy(csim_t *sim);
+bool csim_set_write_policy(csim_t *sim, const char *policy);
+void csim_access(csim_t *sim, char accessType, unsigned long address);
+void csim_access_batch(csim_t *sim, const traceRecord_t *records,
+                       size_t count);
+bool csim_run_trace(csim_t *sim, const char *fileName);
+bool csim_run_reader(csim_t *sim, traceReader_t *reader, traceWriter_t *copy);
+bool csim_run_readers(csim_t *const *sims, size_t count, traceReader_t *reader,
+                      traceWriter_t *copy);
+void csim_stats(const csim_t *sim, csim_stats_t *stats);
+void csim_write_stats(const csim_t *sim, csim_write_stats_t *stats);
+
+#endif /* CSIM_LIB_H */
@@ -0,0 +1,205 @@
+/**
+ * @file csim-parallel.c
+ * @brief Set-partitioned multithreaded driver for the cache simulator
+ *
+ * Worker k owns every set whose index is congruent to k modulo the number of
+ * workers. Each worker runs checkSimulatorCache on a private copy of the
+ * cache_t, which shares the line and set arrays with the caller's cache but
+ * has its own statistics, so no two threads ever write the same memory. The
+ * valid and dirty bitmasks are at least one word per set, so their words are
+ * never shared between workers either.
+ *
+ * The rings are indexed by free-running counters: the producer publishes
+ * iTail and the consumer publishes iHead, each with release stores read by
+ * the other side with acquire loads. Both sides only publish every
+ * PARALLEL_PUBLISH_BATCH records to keep the shared cache lines quiet.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* pthreads and sched_yield are POSIX, not C99 */
+#define _POSIX_C_SOURCE 200809L
+
+/* Importing header files */
+#include "csim-parallel.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+#define PARALLEL_RING_MASK (PARALLEL_RING_SIZE - 1)
+#define PARALLEL_CACHE_LINE 64
+
+/* One access routed to a worker */
+typedef struct {
+    unsigned long address;      /* Memory address accessed */
+    unsigned int memAccessType; /* 0 for load, 1 for store */
+} shardAccess_t;
+
+/* Worker state, padded so each side's index sits on its own cache line */
+typedef struct {
+    unsigned long iHead; /* Consumer position */
+    char padHead[PARALLEL_CACHE_LINE];
+    unsigned long iTail; /* Producer position */
+    bool bDone;          /* No more records coming */
+    char padTail[PARALLEL_CACHE_LINE];
+    unsigned long iPending; /* Producer position not yet published */
+    shardAccess_t *pRing;   /* PARALLEL_RING_SIZE records */
+    cache_t cache;          /* View of the shared cache, private stats */
+    pthread_t thread;       /* Worker thread */
+} simShard_t;
+
+/* Function prototyping */
+static void *shardWorker(void *arg);
+static void shardPush(simShard_t *shard, unsigned long address,
+                      unsigned int memAccessType);
+static void shardPublish(simShard_t *shard);
+
+/**
+ * @brief Simulate a whole trace on a cache using several worker threads.
+ *
+ * On return the cache holds the same lines and statistics as a sequential
+ * run of checkSimulatorCache over the trace, so cacheSummary applies as
+ * usual. Fewer workers than requested are used if the cache has fewer sets.
+ * With bSplitAccesses every block an access touches is routed on its own, as
+ * checkSimulatorCacheSpan would simulate it.
+ *
+ * @param[in,out]   traceReader_t *inputTrace       Open trace
+ * @param[in,out]   cache_t *cache                  Freshly initialised cache
+ * @param[in]       unsigned int threadCount        Number of worker threads
+ * @param[in]       bool bSplitAccesses             Split accesses that
+ * straddle blocks
+ *
+ * @return False if the workers could not be started.
+ */
+bool parallelSimulate(traceReader_t *inputTrace, cache_t *cache,
+                      unsigned int threadCount, bool bSplitAccesses) {
+    traceRecord_t traceRecord;
+    simShard_t *shards;
+    unsigned int iStarted = 0;
+    unsigned int iMemAccessTypeFlag = 0;
+    unsigned long setMask = (unsigned long)cache->iSetCount - 1;
+    bool bSuccess;
+
+    if (threadCount > cache->iSetCount)
+        threadCount = cache->iSetCount;
+    if (threadCount > PARALLEL_MAX_THREADS)
+        threadCount = PARALLEL_MAX_THREADS;
+
+    shards = calloc(threadCount, sizeof(simShard_t));
+    if (shards == NULL)
+        return false;
+
+    for (; iStarted < threadCount; iStarted++) {
+        simShard_t *shard = &shards[iStarted];
+        shard->pRing = malloc(PARALLEL_RING_SIZE * sizeof(shardAccess_t));
+        shard->cache = *cache;
+        memset((void *)&shard->cache.stats, 0, sizeof(shard->cache.stats));
+        shard->cache.iDirtyEvictions = 0;
+        if ((shard->pRing == NULL) ||
+            (pthread_create(&shard->thread, NULL, shardWorker, shard) != 0)) {
+            free(shard->pRing);
+            break;
+        }
+    }
+    bSuccess = (iStarted == threadCount);
+
+    /* Parse the trace and route each access to the owner of its set */
+    while (bSuccess && traceReaderNext(inputTrace, &traceRecord)) {
+        unsigned long block = traceRecord.address >> cache->iBlockBitCount;
+        unsigned long lastBlock = block;
+        if (traceRecord.accessType == 'L')
+            iMemAccessTypeFlag = 0;
+        else if (traceRecord.accessType == 'S')
+            iMemAccessTypeFlag = 1;
+        if (bSplitAccesses)
+            lastBlock = cacheSpanLastBlock(traceRecord.address,
+                                           traceRecord.byteSize,
+                                           cache->iBlockBitCount);
+        shardPush(&shards[(block & setMask) % threadCount],
+                  traceRecord.address, iMemAccessTypeFlag);
+        while (block != lastBlock) {
+            block++;
+            shardPush(&shards[(block & setMask) % threadCount],
+                      block << cache->iBlockBitCount, iMemAccessTypeFlag);
+        }
+    }
+
+    /* Drain the rings, then merge the per-worker statistics */
+    for (unsigned int i = 0; i < iStarted; i++) {
+        shardPublish(&shards[i]);
+        __atomic_store_n(&shards[i].bDone, true, __ATOMIC_RELEASE);
+    }
+    for (unsigned int i = 0; i < iStarted; i++) {
+        pthread_join(shards[i].thread, NULL);
+        cache->stats.hits += shards[i].cache.stats.hits;
+        cache->stats.misses += shards[i].cache.stats.misses;
+        cache->stats.evictions += shards[i].cache.stats.evictions;
+        cache->iDirtyEvictions += shards[i].cache.iDirtyEvictions;
+        free(shards[i].pRing);
+    }
+    free(shards);
+    return bSuccess;
+}
+
+/**
+ * @brief Makes the records pushed so far visible to the worker.
+ */
+static void shardPublish(simShard_t *shard) {
+    __atomic_store_n(&shard->iTail, shard->iPending, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Queues one access for a worker, waiting while its ring is full.
+ */
+static void shardPush(simShard_t *shard, unsigned long address,
+                      unsigned int memAccessType) {
+    while (shard->iPending - __atomic_load_n(&shard->iHead, __ATOMIC_ACQUIRE) ==
+           PARALLEL_RING_SIZE) {
+        shardPublish(shard);
+        sched_yield();
+    }
+    shard->pRing[shard->iPending & PARALLEL_RING_MASK].address = address;
+    shard->pRing[shard->iPending & PARALLEL_RING_MASK].memAccessType =
+        memAccessType;
+    shard->iPending++;
+    if ((shard->iPending % PARALLEL_PUBLISH_BATCH) == 0)
+        shardPublish(shard);
+}
+
+/**
+ * @brief Worker thread, simulates every access queued on its ring.
+ *
+ * @param[in,out]   void *arg       The worker's simShard_t
+ *
+ * @return NULL.
+ */
+static void *shardWorker(void *arg) {
+    simShard_t *shard = arg;
+    unsigned long head = 0;
+
+    for (;;) {
+        unsigned long tail = __atomic_load_n(&shard->iTail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            /* The final tail is published before bDone is set */
+            if (__atomic_load_n(&shard->bDone, __ATOMIC_ACQUIRE) &&
+                (head == __atomic_load_n(&shard->iTail, __ATOMIC_ACQUIRE)))
+                break;
+            sched_yield();
+            continue;
+        }
+        while (head != tail) {
+            const shardAccess_t *access =
+                &shard->pRing[head & PARALLEL_RING_MASK];
+            checkSimulatorCache(&shard->cache, access->memAccessType,
+                                access->address);
+            head++;
+            if ((head % PARALLEL_PUBLISH_BATCH) == 0)
+                __atomic_store_n(&shard->iHead, head, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&shard->iHead, head, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
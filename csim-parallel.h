@@ -0,0 +1,33 @@
+/**
+ * @file csim-parallel.h
+ * @brief Set-partitioned multithreaded driver for the cache simulator
+ *
+ * Under LRU the sets of a cache never interact, so accesses can be routed by
+ * set index to worker threads that each own a disjoint subset of the sets.
+ * The calling thread parses the trace and feeds each worker through a
+ * lock-free single-producer single-consumer ring.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_PARALLEL_H
+#define CSIM_PARALLEL_H
+
+#include "csim-trace.h"
+#include "csim.h"
+#include <stdbool.h>
+
+/** @brief Records per worker ring, a power of two */
+#define PARALLEL_RING_SIZE 8192
+
+/** @brief Records between publications of a ring index */
+#define PARALLEL_PUBLISH_BATCH 256
+
+/** @brief Upper limit on the number of worker threads */
+#define PARALLEL_MAX_THREADS 64
+
+/* Simulate a whole trace on a cache using several worker threads */
+bool parallelSimulate(traceReader_t *inputTrace, cache_t *cache,
+                      unsigned int threadCount, bool bSplitAccesses);
+
+#endif /* CSIM_PARALLEL_H */
@@ -0,0 +1,516 @@
+/**
+ * @file csim-policy.c
+ * @brief Replacement policies of the cache simulator
+ *
+ * Policy state lives in the cache's pPolicyState words, iPolicyWordsPerSet
+ * of them per set, and starts out zeroed:
+ *  - fifo    each way's place in fill order, 0 the oldest, in fields of
+ *            just enough bits for E, one word per set up to 16 ways
+ *  - random  one word, the set's xorshift64 state, seeded on first use
+ *  - plru    the tree bits, node n (1 <= n < E) at bit n, 1 meaning the
+ *            pseudo-LRU side is the right subtree; iMruWay of the set
+ *            holds the last way touched
+ *  - srrip   2-bit re-reference prediction values, 32 ways per word
+ *  - lfu     one hit counter per way
+ * LRU keeps its recency list in pLinks, maintained by cacheLineRankUpdate.
+ *
+ * Policies only look at their own set, so set-partitioned threads stay
+ * deterministic for every policy.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-policy.h"
+#include <string.h>
+
+/* Defines */
+#define SRRIP_WAYS_PER_WORD 32
+#define SRRIP_LOW_BITS 0x5555555555555555ULL
+#define SRRIP_LONG 2
+#define RANDOM_SEED_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+/* Function prototyping */
+static bool policyAnyAssociativity(unsigned int linesPerSet);
+static bool policyPowerOfTwo(unsigned int linesPerSet);
+static unsigned int policyNoState(unsigned int linesPerSet);
+static unsigned int policyOneWord(unsigned int linesPerSet);
+static unsigned int policyWordPerWay(unsigned int linesPerSet);
+static unsigned int fifoStateWords(unsigned int linesPerSet);
+static unsigned int plruStateWords(unsigned int linesPerSet);
+static unsigned int srripStateWords(unsigned int linesPerSet);
+static void policyIgnore(cache_t *cache, unsigned long addrSVal,
+                         unsigned int way);
+static void policyHitOnce(cache_t *cache, unsigned long addrSVal,
+                          unsigned int way, unsigned long count);
+static void lruTouch(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static void lruFill(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static unsigned int lruVictim(cache_t *cache, unsigned long addrSVal);
+static void fifoFill(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static unsigned int fifoVictim(cache_t *cache, unsigned long addrSVal);
+static unsigned int randomVictim(cache_t *cache, unsigned long addrSVal);
+static void plruTouch(cache_t *cache, unsigned long addrSVal,
+                      unsigned int way);
+static void plruHit(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static void plruFill(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static unsigned int plruVictim(cache_t *cache, unsigned long addrSVal);
+static void srripHit(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static void srripFill(cache_t *cache, unsigned long addrSVal,
+                      unsigned int way);
+static unsigned int srripVictim(cache_t *cache, unsigned long addrSVal);
+static void lfuHit(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static void lfuHitRun(cache_t *cache, unsigned long addrSVal, unsigned int way,
+                      unsigned long count);
+static void lfuFill(cache_t *cache, unsigned long addrSVal, unsigned int way);
+static unsigned int lfuVictim(cache_t *cache, unsigned long addrSVal);
+
+const cachePolicy_t cacheLruPolicy = {
+    .pName = "lru",
+    .bRecencyList = true,
+    .isSupported = policyAnyAssociativity,
+    .stateWordsPerSet = policyNoState,
+    .onHit = lruTouch,
+    .onHitRun = policyHitOnce,
+    .onFill = lruFill,
+    .chooseVictim = lruVictim,
+};
+const cachePolicy_t cacheFifoPolicy = {
+    .pName = "fifo",
+    .bRecencyList = false,
+    .isSupported = policyAnyAssociativity,
+    .stateWordsPerSet = fifoStateWords,
+    .onHit = policyIgnore,
+    .onHitRun = policyHitOnce,
+    .onFill = fifoFill,
+    .chooseVictim = fifoVictim,
+};
+const cachePolicy_t cacheRandomPolicy = {
+    .pName = "random",
+    .bRecencyList = false,
+    .isSupported = policyAnyAssociativity,
+    .stateWordsPerSet = policyOneWord,
+    .onHit = policyIgnore,
+    .onHitRun = policyHitOnce,
+    .onFill = policyIgnore,
+    .chooseVictim = randomVictim,
+};
+const cachePolicy_t cachePlruPolicy = {
+    .pName = "plru",
+    .bRecencyList = false,
+    .isSupported = policyPowerOfTwo,
+    .stateWordsPerSet = plruStateWords,
+    .onHit = plruHit,
+    .onHitRun = policyHitOnce,
+    .onFill = plruFill,
+    .chooseVictim = plruVictim,
+};
+const cachePolicy_t cacheSrripPolicy = {
+    .pName = "srrip",
+    .bRecencyList = false,
+    .isSupported = policyAnyAssociativity,
+    .stateWordsPerSet = srripStateWords,
+    .onHit = srripHit,
+    .onHitRun = policyHitOnce,
+    .onFill = srripFill,
+    .chooseVictim = srripVictim,
+};
+const cachePolicy_t cacheLfuPolicy = {
+    .pName = "lfu",
+    .bRecencyList = false,
+    .isSupported = policyAnyAssociativity,
+    .stateWordsPerSet = policyWordPerWay,
+    .onHit = lfuHit,
+    .onHitRun = lfuHitRun,
+    .onFill = lfuFill,
+    .chooseVictim = lfuVictim,
+};
+
+/**
+ * @brief Looks up a replacement policy by the name given to -p.
+ *
+ * @param[in]       const char *name        Policy name
+ *
+ * @return The policy, or NULL if the name is unknown.
+ */
+const cachePolicy_t *cachePolicyFind(const char *name) {
+    static const cachePolicy_t *const policies[] = {
+        &cacheLruPolicy,  &cacheFifoPolicy,  &cacheRandomPolicy,
+        &cachePlruPolicy, &cacheSrripPolicy, &cacheLfuPolicy,
+    };
+
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        if (strcmp(policies[i]->pName, name) == 0)
+            return policies[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the policy state words of a set.
+ */
+static inline uint64_t *policyState(const cache_t *cache,
+                                    unsigned long addrSVal) {
+    return &cache->pPolicyState[addrSVal * cache->iPolicyWordsPerSet];
+}
+
+static bool policyAnyAssociativity(unsigned int linesPerSet) { return true; }
+
+static bool policyPowerOfTwo(unsigned int linesPerSet) {
+    return (linesPerSet & (linesPerSet - 1)) == 0;
+}
+
+static unsigned int policyNoState(unsigned int linesPerSet) { return 0; }
+
+static unsigned int policyOneWord(unsigned int linesPerSet) { return 1; }
+
+static unsigned int policyWordPerWay(unsigned int linesPerSet) {
+    return linesPerSet;
+}
+
+static void policyIgnore(cache_t *cache, unsigned long addrSVal,
+                         unsigned int way) {}
+
+/**
+ * @brief Repeated hits of policies where a second hit changes nothing.
+ *
+ * The first hit still matters, as after a fill SRRIP predicts the line
+ * distant until it is hit, but LRU, PLRU and SRRIP then leave the line as
+ * the first hit put it.
+ */
+static void policyHitOnce(cache_t *cache, unsigned long addrSVal,
+                          unsigned int way, unsigned long count) {
+    cache->pPolicy->onHit(cache, addrSVal, way);
+}
+
+/**
+ * @brief LRU hit, moves the line to the most recently used end.
+ */
+static void lruTouch(cache_t *cache, unsigned long addrSVal,
+                     unsigned int way) {
+    cacheLineRankUpdate(cache, addrSVal, way);
+}
+
+/**
+ * @brief LRU fill, links an empty way into the list or reuses the victim.
+ *
+ * An empty way is the one at iValidLineCount, since onFill runs before the
+ * line is counted; its links hold no list position yet.
+ */
+static void lruFill(cache_t *cache, unsigned long addrSVal, unsigned int way) {
+    cacheSet_t *set = &cache->pSets[addrSVal];
+    cacheWayLink_t *line =
+        &cache->pLinks[(addrSVal * cache->iCacheLinesPerSet) + way];
+
+    if (way == set->iValidLineCount) {
+        line->iPrevWay = CACHE_WAY_NONE;
+        line->iNextWay = CACHE_WAY_NONE;
+        /* First line of the set is both ends of the recency list */
+        if (way == 0) {
+            set->iMruWay = 0;
+            set->iLruWay = 0;
+            return;
+        }
+    }
+    cacheLineRankUpdate(cache, addrSVal, way);
+}
+
+/**
+ * @brief LRU victim, the tail of the recency list.
+ */
+static unsigned int lruVictim(cache_t *cache, unsigned long addrSVal) {
+    return cache->pSets[addrSVal].iLruWay;
+}
+
+/**
+ * @brief Bits of a FIFO rank, enough to hold E - 1.
+ */
+static inline unsigned int fifoRankBits(unsigned int linesPerSet) {
+    if (linesPerSet <= 2)
+        return 1;
+    return 32 - (unsigned int)__builtin_clz(linesPerSet - 1);
+}
+
+static unsigned int fifoStateWords(unsigned int linesPerSet) {
+    unsigned int ranksPerWord = 64 / fifoRankBits(linesPerSet);
+    return (linesPerSet + ranksPerWord - 1) / ranksPerWord;
+}
+
+/**
+ * @brief Returns the FIFO rank of a way.
+ */
+static inline unsigned int fifoRank(const uint64_t *ranks, unsigned int bits,
+                                    unsigned int way) {
+    unsigned int ranksPerWord = 64 / bits;
+
+    return (unsigned int)((ranks[way / ranksPerWord] >>
+                           (bits * (way % ranksPerWord))) &
+                          (((uint64_t)1 << bits) - 1));
+}
+
+/**
+ * @brief Stores the FIFO rank of a way.
+ */
+static inline void fifoSetRank(uint64_t *ranks, unsigned int bits,
+                               unsigned int way, unsigned int rank) {
+    unsigned int ranksPerWord = 64 / bits;
+    uint64_t *word = &ranks[way / ranksPerWord];
+    unsigned int shift = bits * (way % ranksPerWord);
+
+    *word = (*word & ~((((uint64_t)1 << bits) - 1) << shift)) |
+            ((uint64_t)rank << shift);
+}
+
+/**
+ * @brief FIFO fill, the way joins the queue last, whichever way it is.
+ *
+ * Ways behind its old place move up one, so an invalidated way the set
+ * reuses, and the victim of an eviction, both become the newest. Ranks
+ * start at 0, and as a set first fills the ways already filled move up
+ * past the empty ones, so a full set always ranks its ways 0 to E - 1.
+ */
+static void fifoFill(cache_t *cache, unsigned long addrSVal, unsigned int way) {
+    uint64_t *ranks = policyState(cache, addrSVal);
+    unsigned int lines = cache->iCacheLinesPerSet;
+    unsigned int bits = fifoRankBits(lines);
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    unsigned int old = fifoRank(ranks, bits, way);
+
+    if (cache->iPolicyWordsPerSet == 1) {
+        /* Every rank in one word, walked by shifts alone */
+        uint64_t word = *ranks;
+        for (unsigned int shift = 0; shift < bits * lines; shift += bits) {
+            word -= (uint64_t)(((word >> shift) & mask) > old) << shift;
+        }
+        *ranks = word;
+    } else {
+        for (unsigned int j = 0; j < lines; j++) {
+            unsigned int rank = fifoRank(ranks, bits, j);
+            if (rank > old)
+                fifoSetRank(ranks, bits, j, rank - 1);
+        }
+    }
+    fifoSetRank(ranks, bits, way, lines - 1);
+}
+
+/**
+ * @brief FIFO victim, the way filled longest ago.
+ */
+static unsigned int fifoVictim(cache_t *cache, unsigned long addrSVal) {
+    const uint64_t *ranks = policyState(cache, addrSVal);
+    unsigned int lines = cache->iCacheLinesPerSet;
+    unsigned int bits = fifoRankBits(lines);
+
+    if (cache->iPolicyWordsPerSet == 1) {
+        uint64_t word = *ranks;
+        uint64_t mask = ((uint64_t)1 << bits) - 1;
+        for (unsigned int j = 0; j < lines; j++, word >>= bits) {
+            if ((word & mask) == 0)
+                return j;
+        }
+        return 0;
+    }
+    for (unsigned int j = 0; j < lines; j++) {
+        if (fifoRank(ranks, bits, j) == 0)
+            return j;
+    }
+    return 0;
+}
+
+/**
+ * @brief Random victim from the set's own xorshift64 generator.
+ *
+ * The generator is seeded from the set index, so a run is reproducible and
+ * independent of how sets are split between threads.
+ */
+static unsigned int randomVictim(cache_t *cache, unsigned long addrSVal) {
+    uint64_t *rng = policyState(cache, addrSVal);
+    uint64_t x = *rng;
+
+    if (x == 0)
+        x = ((uint64_t)addrSVal + 1) * RANDOM_SEED_MULTIPLIER;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *rng = x;
+    return (unsigned int)(((x >> 32) * cache->iCacheLinesPerSet) >> 32);
+}
+
+/**
+ * @brief Tree bits of E ways fit in the E bits of one set's mask words.
+ */
+static unsigned int plruStateWords(unsigned int linesPerSet) {
+    return (linesPerSet + CACHE_MASK_WORD_BITS - 1) / CACHE_MASK_WORD_BITS;
+}
+
+/**
+ * @brief Points every tree node on a way's path away from it.
+ *
+ * Up to CACHE_MASK_WORD_BITS ways the whole tree is one word, updated in a
+ * register with one store.
+ */
+static void plruTouch(cache_t *cache, unsigned long addrSVal,
+                      unsigned int way) {
+    uint64_t *tree = policyState(cache, addrSVal);
+    unsigned int node = way + cache->iCacheLinesPerSet;
+
+    if (cache->iPolicyWordsPerSet == 1) {
+        uint64_t bits = *tree;
+        for (; node > 1; node >>= 1) {
+            uint64_t bit = (uint64_t)1 << (node >> 1);
+            /* Reached from the left child, so the right side is now older */
+            uint64_t fromLeft = (uint64_t) - (int64_t)((node & 1) ^ 1);
+            bits = (bits & ~bit) | (bit & fromLeft);
+        }
+        *tree = bits;
+        return;
+    }
+    for (; node > 1; node >>= 1) {
+        unsigned int parent = node >> 1;
+        uint64_t bit = (uint64_t)1 << (parent % CACHE_MASK_WORD_BITS);
+        if ((node & 1) == 0)
+            tree[parent / CACHE_MASK_WORD_BITS] |= bit;
+        else
+            tree[parent / CACHE_MASK_WORD_BITS] &= ~bit;
+    }
+}
+
+/**
+ * @brief PLRU hit, nothing changes when the line was also the last touched.
+ *
+ * The set's iMruWay records the last way touched, so repeated hits to one
+ * line, the common case, skip the tree walk.
+ */
+static void plruHit(cache_t *cache, unsigned long addrSVal, unsigned int way) {
+    cacheSet_t *set = &cache->pSets[addrSVal];
+
+    if (set->iMruWay == way)
+        return;
+    set->iMruWay = way;
+    plruTouch(cache, addrSVal, way);
+}
+
+/**
+ * @brief PLRU fill, every filled line starts out as the last touched.
+ */
+static void plruFill(cache_t *cache, unsigned long addrSVal,
+                     unsigned int way) {
+    cache->pSets[addrSVal].iMruWay = way;
+    plruTouch(cache, addrSVal, way);
+}
+
+/**
+ * @brief PLRU victim, follows the node bits from the root to a leaf.
+ */
+static unsigned int plruVictim(cache_t *cache, unsigned long addrSVal) {
+    const uint64_t *tree = policyState(cache, addrSVal);
+    unsigned int node = 1;
+
+    while (node < cache->iCacheLinesPerSet) {
+        unsigned int right = (unsigned int)(tree[node / CACHE_MASK_WORD_BITS] >>
+                                            (node % CACHE_MASK_WORD_BITS)) &
+                             1U;
+        node = (2 * node) + right;
+    }
+    return node - cache->iCacheLinesPerSet;
+}
+
+static unsigned int srripStateWords(unsigned int linesPerSet) {
+    return (linesPerSet + SRRIP_WAYS_PER_WORD - 1) / SRRIP_WAYS_PER_WORD;
+}
+
+/**
+ * @brief Stores the 2-bit prediction of a way.
+ */
+static inline void srripSet(cache_t *cache, unsigned long addrSVal,
+                            unsigned int way, uint64_t value) {
+    uint64_t *word = &policyState(cache, addrSVal)[way / SRRIP_WAYS_PER_WORD];
+    unsigned int shift = 2 * (way % SRRIP_WAYS_PER_WORD);
+
+    *word = (*word & ~((uint64_t)3 << shift)) | (value << shift);
+}
+
+/**
+ * @brief Low bit of every 2-bit field of a word that belongs to a real way.
+ */
+static inline uint64_t srripLanes(const cache_t *cache, unsigned int word) {
+    unsigned int ways = cache->iCacheLinesPerSet - (word * SRRIP_WAYS_PER_WORD);
+    if (ways >= SRRIP_WAYS_PER_WORD)
+        return SRRIP_LOW_BITS;
+    return SRRIP_LOW_BITS & (((uint64_t)1 << (2 * ways)) - 1);
+}
+
+/**
+ * @brief SRRIP hit, the line is predicted to be re-referenced soon.
+ */
+static void srripHit(cache_t *cache, unsigned long addrSVal,
+                     unsigned int way) {
+    srripSet(cache, addrSVal, way, 0);
+}
+
+/**
+ * @brief SRRIP fill, new lines are predicted a long re-reference interval.
+ */
+static void srripFill(cache_t *cache, unsigned long addrSVal,
+                      unsigned int way) {
+    srripSet(cache, addrSVal, way, SRRIP_LONG);
+}
+
+/**
+ * @brief SRRIP victim, the first way predicted distant, ageing if none is.
+ *
+ * A field predicts a distant re-reference, 3, when both of its bits are
+ * set, which is tested for 32 ways at once. When no way is distant every
+ * prediction is raised by one, which cannot carry out of any field.
+ */
+static unsigned int srripVictim(cache_t *cache, unsigned long addrSVal) {
+    uint64_t *state = policyState(cache, addrSVal);
+    unsigned int words = cache->iPolicyWordsPerSet;
+
+    for (;;) {
+        for (unsigned int i = 0; i < words; i++) {
+            uint64_t distant =
+                state[i] & (state[i] >> 1) & srripLanes(cache, i);
+            if (distant != 0)
+                return (i * SRRIP_WAYS_PER_WORD) +
+                       ((unsigned int)__builtin_ctzll(distant) / 2);
+        }
+        for (unsigned int i = 0; i < words; i++)
+            state[i] += srripLanes(cache, i);
+    }
+}
+
+/**
+ * @brief LFU hit, counts one more reference to the line.
+ */
+static void lfuHit(cache_t *cache, unsigned long addrSVal, unsigned int way) {
+    policyState(cache, addrSVal)[way]++;
+}
+
+/**
+ * @brief LFU repeated hits, counts each of them.
+ */
+static void lfuHitRun(cache_t *cache, unsigned long addrSVal, unsigned int way,
+                      unsigned long count) {
+    policyState(cache, addrSVal)[way] += count;
+}
+
+/**
+ * @brief LFU fill, a new line starts with the reference that brought it in.
+ */
+static void lfuFill(cache_t *cache, unsigned long addrSVal, unsigned int way) {
+    policyState(cache, addrSVal)[way] = 1;
+}
+
+/**
+ * @brief LFU victim, the lowest way among the least referenced lines.
+ */
+static unsigned int lfuVictim(cache_t *cache, unsigned long addrSVal) {
+    const uint64_t *counts = policyState(cache, addrSVal);
+    unsigned int victim = 0;
+
+    for (unsigned int j = 1; j < cache->iCacheLinesPerSet; j++) {
+        if (counts[j] < counts[victim])
+            victim = j;
+    }
+    return victim;
+}
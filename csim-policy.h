@@ -0,0 +1,31 @@
+/**
+ * @file csim-policy.h
+ * @brief Replacement policies of the cache simulator
+ *
+ * Every policy implements the cachePolicy_t interface of csim.h:
+ *  - lru     true LRU through the constant time recency list
+ *  - fifo    evicts lines in the order they were filled
+ *  - random  evicts a pseudo-random line, reproducibly per set
+ *  - plru    tree pseudo-LRU, one bit per internal node, power of two E
+ *  - srrip   static RRIP with 2-bit re-reference predictions
+ *  - lfu     evicts the least frequently hit line, lowest way on ties
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_POLICY_H
+#define CSIM_POLICY_H
+
+#include "csim.h"
+
+extern const cachePolicy_t cacheLruPolicy;
+extern const cachePolicy_t cacheFifoPolicy;
+extern const cachePolicy_t cacheRandomPolicy;
+extern const cachePolicy_t cachePlruPolicy;
+extern const cachePolicy_t cacheSrripPolicy;
+extern const cachePolicy_t cacheLfuPolicy;
+
+/* Function prototyping */
+const cachePolicy_t *cachePolicyFind(const char *name);
+
+#endif /* CSIM_POLICY_H */
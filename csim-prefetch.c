@@ -0,0 +1,208 @@
+/**
+ * @file csim-prefetch.c
+ * @brief Hardware prefetcher models of the cache simulator
+ *
+ * Prefetchers are triggered by demand misses and by the first demand hit to
+ * a prefetched line, so a stream that the prefetcher keeps ahead of still
+ * trains it. Like hardware prefetchers working on physical addresses, none
+ * of them fetch outside the 4 KiB region of the trigger block.
+ *
+ * State layout in pPrefetchState:
+ *  - nextline  none
+ *  - stride    PREFETCH_STRIDE_ENTRIES entries of four words, indexed by
+ *              region: region + 1 (0 when empty), last block, stride and
+ *              confidence
+ *  - stream    a clock word, then PREFETCH_STREAM_COUNT entries of three
+ *              words: last block, direction (0 while training, 1 or -1)
+ *              and the clock of the last use (0 when empty)
+ * Signed strides and directions are stored as their two's complement, so
+ * adding them to a block index steps backwards as well.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-prefetch.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+#define PREFETCH_REGION_BITS 12
+#define PREFETCH_STRIDE_ENTRIES 64
+#define PREFETCH_STRIDE_WORDS 4
+#define PREFETCH_STRIDE_CONFIDENT 1
+#define PREFETCH_STRIDE_MAX_CONFIDENCE 3
+#define PREFETCH_STREAM_COUNT 16
+#define PREFETCH_STREAM_WORDS 3
+#define PREFETCH_STREAM_WINDOW 16
+
+/* Function prototyping */
+static void prefetchRun(cache_t *cache, unsigned long block,
+                        unsigned long step);
+static void nextLineTrigger(cache_t *cache, unsigned long block);
+static void strideTrigger(cache_t *cache, unsigned long block);
+static void streamTrigger(cache_t *cache, unsigned long block);
+
+const cachePrefetcher_t cacheNextLinePrefetcher = {
+    .pName = "nextline",
+    .iStateWords = 0,
+    .iDefaultDegree = 1,
+    .onTrigger = nextLineTrigger,
+};
+const cachePrefetcher_t cacheStridePrefetcher = {
+    .pName = "stride",
+    .iStateWords = PREFETCH_STRIDE_ENTRIES * PREFETCH_STRIDE_WORDS,
+    .iDefaultDegree = 2,
+    .onTrigger = strideTrigger,
+};
+const cachePrefetcher_t cacheStreamPrefetcher = {
+    .pName = "stream",
+    .iStateWords = 1 + (PREFETCH_STREAM_COUNT * PREFETCH_STREAM_WORDS),
+    .iDefaultDegree = 4,
+    .onTrigger = streamTrigger,
+};
+
+/**
+ * @brief Looks up a prefetcher by the "name[:degree]" given to -f.
+ *
+ * @param[in]       const char *spec                Prefetcher name, with an
+ * optional number of blocks fetched per trigger
+ * @param[out]      unsigned int *pDegree           Blocks fetched per trigger
+ *
+ * @return The prefetcher, or NULL if the name or degree is invalid.
+ */
+const cachePrefetcher_t *cachePrefetcherFind(const char *spec,
+                                             unsigned int *pDegree) {
+    static const cachePrefetcher_t *const prefetchers[] = {
+        &cacheNextLinePrefetcher,
+        &cacheStridePrefetcher,
+        &cacheStreamPrefetcher,
+    };
+    const char *degree = strchr(spec, ':');
+    size_t nameLength = (degree != NULL) ? (size_t)(degree - spec)
+                                         : strlen(spec);
+
+    for (size_t i = 0; i < sizeof(prefetchers) / sizeof(prefetchers[0]); i++) {
+        const cachePrefetcher_t *prefetcher = prefetchers[i];
+        char *end;
+        long value;
+        if ((strlen(prefetcher->pName) != nameLength) ||
+            (strncmp(prefetcher->pName, spec, nameLength) != 0))
+            continue;
+        *pDegree = prefetcher->iDefaultDegree;
+        if (degree == NULL)
+            return prefetcher;
+        value = strtol(degree + 1, &end, 10);
+        if ((end == degree + 1) || (*end != '\0') || (value < 1) ||
+            (value > PREFETCH_MAX_DEGREE))
+            return NULL;
+        *pDegree = (unsigned int)value;
+        return prefetcher;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Prefetches degree blocks from a block onwards, step blocks apart.
+ *
+ * Stops at the edge of the block's region, and so never wraps around the
+ * address space either. Blocks of a region or more are always fetched.
+ */
+static void prefetchRun(cache_t *cache, unsigned long block,
+                        unsigned long step) {
+    unsigned int shift = (cache->iBlockBitCount < PREFETCH_REGION_BITS)
+                             ? PREFETCH_REGION_BITS - cache->iBlockBitCount
+                             : 0;
+    unsigned long target = block;
+
+    for (unsigned int k = 0; k < cache->iPrefetchDegree; k++) {
+        target += step;
+        if ((shift != 0) && ((target >> shift) != (block >> shift)))
+            return;
+        if ((shift == 0) && ((long)step > 0 ? target < block : target > block))
+            return;
+        cachePrefetch(cache, target);
+    }
+}
+
+/**
+ * @brief Next-line trigger, fetches the blocks right after the trigger.
+ */
+static void nextLineTrigger(cache_t *cache, unsigned long block) {
+    prefetchRun(cache, block, 1);
+}
+
+/**
+ * @brief Stride trigger, detects a constant stride within each region.
+ *
+ * A region's entry learns the distance between its last two triggers and
+ * prefetches along it once the same distance has been seen twice in a row.
+ */
+static void strideTrigger(cache_t *cache, unsigned long block) {
+    unsigned long region =
+        (block << cache->iBlockBitCount) >> PREFETCH_REGION_BITS;
+    uint64_t *entry =
+        &cache->pPrefetchState[(region % PREFETCH_STRIDE_ENTRIES) *
+                               PREFETCH_STRIDE_WORDS];
+    unsigned long stride;
+
+    /* entry[0] region + 1, entry[1] last block, entry[2] stride, entry[3]
+       confidence */
+    if (entry[0] != region + 1) {
+        entry[0] = region + 1;
+        entry[1] = block;
+        entry[2] = 0;
+        entry[3] = 0;
+        return;
+    }
+    stride = block - entry[1];
+    if (stride == 0)
+        return;
+    if (stride == entry[2]) {
+        if (entry[3] < PREFETCH_STRIDE_MAX_CONFIDENCE)
+            entry[3]++;
+    } else {
+        entry[2] = stride;
+        entry[3] = 0;
+    }
+    entry[1] = block;
+    if (entry[3] >= PREFETCH_STRIDE_CONFIDENT)
+        prefetchRun(cache, block, stride);
+}
+
+/**
+ * @brief Stream trigger, follows ascending and descending streams.
+ *
+ * A trigger within PREFETCH_STREAM_WINDOW blocks of a stream's last block
+ * extends it, the first extension to another block fixing its direction for
+ * good; other triggers start a new stream in place of the least recently
+ * used one. Each extension of a directed stream prefetches the next degree
+ * blocks along it, even one that steps back inside the window.
+ */
+static void streamTrigger(cache_t *cache, unsigned long block) {
+    uint64_t *clock = cache->pPrefetchState;
+    uint64_t *streams = &cache->pPrefetchState[1];
+    uint64_t *victim = streams;
+
+    (*clock)++;
+    for (unsigned int i = 0; i < PREFETCH_STREAM_COUNT; i++) {
+        uint64_t *stream = &streams[i * PREFETCH_STREAM_WORDS];
+        unsigned long distance =
+            (block > stream[0]) ? block - stream[0] : stream[0] - block;
+        if (stream[2] < victim[2])
+            victim = stream;
+        if ((stream[2] == 0) || (distance > PREFETCH_STREAM_WINDOW))
+            continue;
+        /* stream[0] last block, stream[1] direction, stream[2] last use */
+        if ((stream[1] == 0) && (block != stream[0]))
+            stream[1] = (block > stream[0]) ? 1 : ~(uint64_t)0;
+        stream[0] = block;
+        stream[2] = *clock;
+        if (stream[1] != 0)
+            prefetchRun(cache, block, stream[1]);
+        return;
+    }
+    victim[0] = block;
+    victim[1] = 0;
+    victim[2] = *clock;
+}
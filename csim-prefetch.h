@@ -0,0 +1,30 @@
+/**
+ * @file csim-prefetch.h
+ * @brief Hardware prefetcher models of the cache simulator
+ *
+ * Every prefetcher implements the cachePrefetcher_t interface of csim.h and
+ * fetches degree blocks per trigger:
+ *  - nextline  the blocks following the trigger block
+ *  - stride    a stride detector per 4 KiB region, no program counter
+ *  - stream    up and down streams, confirmed by a second nearby miss
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_PREFETCH_H
+#define CSIM_PREFETCH_H
+
+#include "csim.h"
+
+/** @brief Upper limit on the blocks fetched per trigger */
+#define PREFETCH_MAX_DEGREE 64
+
+extern const cachePrefetcher_t cacheNextLinePrefetcher;
+extern const cachePrefetcher_t cacheStridePrefetcher;
+extern const cachePrefetcher_t cacheStreamPrefetcher;
+
+/* Function prototyping */
+const cachePrefetcher_t *cachePrefetcherFind(const char *spec,
+                                             unsigned int *pDegree);
+
+#endif /* CSIM_PREFETCH_H */
@@ -0,0 +1,32 @@
+/**
+ * @file csim-probe.h
+ * @brief Tag match kernels for the set probe of the cache simulator
+ *
+ * A probe compares the tag of an access against the contiguous tags of one
+ * set and returns the way that holds it. On x86-64 CPUs with AVX2 the
+ * comparison is done four tags at a time and the lane mask is combined with
+ * the set's valid bits.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_PROBE_H
+#define CSIM_PROBE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Finds a tag among the first wayCount lines of a set.
+ *
+ * pValidBits points at the set's first valid bitmask word. Returns the
+ * matching way, or CACHE_WAY_NONE when no valid line holds the tag.
+ */
+typedef unsigned int (*cacheProbeFn_t)(const unsigned long *pTags,
+                                       const uint64_t *pValidBits,
+                                       unsigned int wayCount,
+                                       unsigned long tag);
+
+/* Function prototyping */
+cacheProbeFn_t cacheProbeSelect(unsigned int linesPerSet);
+
+#endif /* CSIM_PROBE_H */
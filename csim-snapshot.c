@@ -0,0 +1,253 @@
+/**
+ * @file csim-snapshot.c
+ * @brief Cache state checkpoints of the cache simulator
+ *
+ * A snapshot is a header, then for every cache its configuration, its
+ * counters and its metadata arrays in the order snapshotArrays lists them.
+ * The configuration is what makes two caches interchangeable, geometry,
+ * sampling rate, replacement and write policies and prefetcher, and must
+ * match the cache a snapshot is read into. The counters and arrays are
+ * then copied over its own, so the arrays keep the sizes cacheInit gave
+ * them.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-snapshot.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Defines */
+#define SNAPSHOT_BYTE_ORDER 0x01020304U
+#define SNAPSHOT_MAX_ARRAYS 10
+
+/* Snapshot header */
+typedef struct {
+    char magic[SNAPSHOT_MAGIC_LEN]; /* SNAPSHOT_MAGIC, not terminated */
+    uint32_t iVersion;              /* SNAPSHOT_VERSION */
+    uint32_t iByteOrder;            /* SNAPSHOT_BYTE_ORDER as stored */
+    uint32_t iWordBytes;            /* Size of an unsigned long */
+    uint32_t iCacheCount;           /* Caches that follow */
+    uint32_t iMemAccessType;        /* 0 after a load, 1 after a store */
+} snapshotHeader_t;
+
+/* Configuration of a cache, which a snapshot must match to be read */
+typedef struct {
+    uint32_t iSetBitCount;              /* s of the sets held */
+    uint32_t iCacheLinesPerSet;         /* E */
+    uint32_t iBlockBitCount;            /* b */
+    uint32_t iSampleBits;               /* Set sampling rate in bits */
+    uint32_t iPrefetchDegree;           /* 0 without a prefetcher */
+    uint32_t iWritePolicy;              /* CACHE_WRITE_* flags */
+    uint32_t iWriteBufferSize;          /* Write-combining buffer entries */
+    char policy[SNAPSHOT_NAME_LEN];     /* Replacement policy */
+    char prefetcher[SNAPSHOT_NAME_LEN]; /* Prefetcher, empty if none */
+} snapshotConfig_t;
+
+/* Counters of a cache, restored along with its arrays */
+typedef struct {
+    csim_stats_t stats;            /* Hits, misses and evictions */
+    unsigned long iDirtyEvictions; /* Dirty lines evicted */
+    cachePrefetchStats_t prefetch; /* Prefetch counters */
+    cacheWriteStats_t write;       /* Write counters */
+    unsigned long iSampleAccesses; /* Accesses seen by the sampling filter */
+    uint32_t iLastWay;             /* Way of the latest demand access */
+    uint32_t iWriteBufferHead;     /* Oldest buffered block */
+    uint32_t iWriteBufferCount;    /* Blocks buffered */
+} snapshotCounters_t;
+
+/* Function prototyping */
+static void snapshotDescribe(const cache_t *cache, snapshotConfig_t *config);
+static size_t snapshotArrays(const cache_t *cache,
+                             void *arrays[SNAPSHOT_MAX_ARRAYS],
+                             size_t sizes[SNAPSHOT_MAX_ARRAYS]);
+
+/**
+ * @brief Writes the state of a run's caches to a snapshot.
+ *
+ * @param[in,out]   FILE *file                      Stream written to
+ * @param[in]       const cache_t *caches           Simulated caches
+ * @param[in]       unsigned int cacheCount         Number of caches
+ * @param[in]       unsigned int memAccessType      Type of the latest load
+ * or store, 1 for a store
+ *
+ * @return False if writing failed.
+ */
+bool snapshotWrite(FILE *file, const cache_t *caches, unsigned int cacheCount,
+                   unsigned int memAccessType) {
+    snapshotHeader_t header;
+
+    memset((void *)&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+    header.iVersion = SNAPSHOT_VERSION;
+    header.iByteOrder = SNAPSHOT_BYTE_ORDER;
+    header.iWordBytes = (uint32_t)sizeof(unsigned long);
+    header.iCacheCount = cacheCount;
+    header.iMemAccessType = memAccessType;
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        return false;
+
+    for (unsigned int i = 0; i < cacheCount; i++) {
+        const cache_t *cache = &caches[i];
+        snapshotConfig_t config;
+        snapshotCounters_t counters;
+        void *arrays[SNAPSHOT_MAX_ARRAYS];
+        size_t sizes[SNAPSHOT_MAX_ARRAYS];
+        size_t arrayCount = snapshotArrays(cache, arrays, sizes);
+
+        snapshotDescribe(cache, &config);
+        memset((void *)&counters, 0, sizeof(counters));
+        counters.stats = cache->stats;
+        counters.iDirtyEvictions = cache->iDirtyEvictions;
+        counters.prefetch = cache->prefetch;
+        counters.write = cache->write;
+        counters.iSampleAccesses = cache->iSampleAccesses;
+        counters.iLastWay = cache->iLastWay;
+        counters.iWriteBufferHead = cache->iWriteBufferHead;
+        counters.iWriteBufferCount = cache->iWriteBufferCount;
+        if ((fwrite(&config, sizeof(config), 1, file) != 1) ||
+            (fwrite(&counters, sizeof(counters), 1, file) != 1))
+            return false;
+        for (size_t a = 0; a < arrayCount; a++) {
+            if (fwrite(arrays[a], 1, sizes[a], file) != sizes[a])
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Restores the state of a run's caches from a snapshot.
+ *
+ * The caches must be initialised with the configurations the snapshot was
+ * taken of, in the same order. On failure they are left partly restored.
+ *
+ * @param[in,out]   FILE *file                      Stream read from
+ * @param[in,out]   cache_t *caches                 Simulated caches
+ * @param[in]       unsigned int cacheCount         Number of caches
+ * @param[out]      unsigned int *pMemAccessType    Type of the latest load
+ * or store when the snapshot was taken
+ *
+ * @return False if the snapshot is unreadable or taken of other caches.
+ */
+bool snapshotRead(FILE *file, cache_t *caches, unsigned int cacheCount,
+                  unsigned int *pMemAccessType) {
+    snapshotHeader_t header;
+
+    if ((fread(&header, sizeof(header), 1, file) != 1) ||
+        (memcmp(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) ||
+        (header.iVersion != SNAPSHOT_VERSION) ||
+        (header.iByteOrder != SNAPSHOT_BYTE_ORDER) ||
+        (header.iWordBytes != sizeof(unsigned long)) ||
+        (header.iCacheCount != cacheCount) || (header.iMemAccessType > 1))
+        return false;
+
+    for (unsigned int i = 0; i < cacheCount; i++) {
+        cache_t *cache = &caches[i];
+        snapshotConfig_t config;
+        snapshotConfig_t expected;
+        snapshotCounters_t counters;
+        void *arrays[SNAPSHOT_MAX_ARRAYS];
+        size_t sizes[SNAPSHOT_MAX_ARRAYS];
+        size_t arrayCount = snapshotArrays(cache, arrays, sizes);
+
+        snapshotDescribe(cache, &expected);
+        if ((fread(&config, sizeof(config), 1, file) != 1) ||
+            (memcmp(&config, &expected, sizeof(config)) != 0) ||
+            (fread(&counters, sizeof(counters), 1, file) != 1) ||
+            (counters.iLastWay >= cache->iCacheLinesPerSet) ||
+            (counters.iWriteBufferCount > cache->iWriteBufferSize) ||
+            ((counters.iWriteBufferHead != 0) &&
+             (counters.iWriteBufferHead >= cache->iWriteBufferSize)))
+            return false;
+        for (size_t a = 0; a < arrayCount; a++) {
+            if (fread(arrays[a], 1, sizes[a], file) != sizes[a])
+                return false;
+        }
+        cache->stats = counters.stats;
+        cache->iDirtyEvictions = counters.iDirtyEvictions;
+        cache->prefetch = counters.prefetch;
+        cache->write = counters.write;
+        cache->iSampleAccesses = counters.iSampleAccesses;
+        cache->iLastWay = counters.iLastWay;
+        cache->iWriteBufferHead = counters.iWriteBufferHead;
+        cache->iWriteBufferCount = counters.iWriteBufferCount;
+    }
+    *pMemAccessType = header.iMemAccessType;
+    /* Anything past the last cache means the snapshot is of another run */
+    return fgetc(file) == EOF;
+}
+
+/**
+ * @brief Fills in the configuration record of a cache.
+ *
+ * The record is zeroed first, so two records of one configuration compare
+ * equal byte for byte.
+ */
+static void snapshotDescribe(const cache_t *cache, snapshotConfig_t *config) {
+    memset((void *)config, 0, sizeof(*config));
+    config->iSetBitCount = cache->iSetBitCount;
+    config->iCacheLinesPerSet = cache->iCacheLinesPerSet;
+    config->iBlockBitCount = cache->iBlockBitCount;
+    config->iSampleBits = cache->iSampleBits;
+    config->iWritePolicy = cache->iWritePolicy;
+    config->iWriteBufferSize = cache->iWriteBufferSize;
+    snprintf(config->policy, sizeof(config->policy), "%s",
+             cache->pPolicy->pName);
+    if (cache->pPrefetcher != NULL) {
+        config->iPrefetchDegree = cache->iPrefetchDegree;
+        snprintf(config->prefetcher, sizeof(config->prefetcher), "%s",
+                 cache->pPrefetcher->pName);
+    }
+}
+
+/**
+ * @brief Lists the metadata arrays of a cache and their sizes in bytes.
+ *
+ * Arrays the cache's policy, prefetcher and sampling do not use are left
+ * out, so their absence is implied by the configuration.
+ */
+static size_t snapshotArrays(const cache_t *cache,
+                             void *arrays[SNAPSHOT_MAX_ARRAYS],
+                             size_t sizes[SNAPSHOT_MAX_ARRAYS]) {
+    size_t lineCount = (size_t)cache->iSetCount * cache->iCacheLinesPerSet;
+    size_t maskWordCount = (size_t)cache->iSetCount * cache->iMaskWordsPerSet;
+    size_t count = 0;
+
+    arrays[count] = cache->pTags;
+    sizes[count++] = lineCount * sizeof(unsigned long);
+    arrays[count] = cache->pValidBits;
+    sizes[count++] = maskWordCount * sizeof(uint64_t);
+    arrays[count] = cache->pDirtyBits;
+    sizes[count++] = maskWordCount * sizeof(uint64_t);
+    arrays[count] = cache->pSets;
+    sizes[count++] = (size_t)cache->iSetCount * sizeof(cacheSet_t);
+    if (cache->pLinks != NULL) {
+        arrays[count] = cache->pLinks;
+        sizes[count++] = lineCount * sizeof(cacheWayLink_t);
+    }
+    if (cache->iPolicyWordsPerSet != 0) {
+        arrays[count] = cache->pPolicyState;
+        sizes[count++] = (size_t)cache->iSetCount *
+                         cache->iPolicyWordsPerSet * sizeof(uint64_t);
+    }
+    if (cache->pPrefetcher != NULL) {
+        arrays[count] = cache->pPrefetchBits;
+        sizes[count++] = maskWordCount * sizeof(uint64_t);
+    }
+    if ((cache->pPrefetcher != NULL) &&
+        (cache->pPrefetcher->iStateWords != 0)) {
+        arrays[count] = cache->pPrefetchState;
+        sizes[count++] = cache->pPrefetcher->iStateWords * sizeof(uint64_t);
+    }
+    if (cache->iSampleBits != 0) {
+        arrays[count] = cache->pSampleSets;
+        sizes[count++] = (size_t)cache->iSetCount * sizeof(cacheSampleSet_t);
+    }
+    if (cache->iWriteBufferSize != 0) {
+        arrays[count] = cache->pWriteBuffer;
+        sizes[count++] = cache->iWriteBufferSize * sizeof(unsigned long);
+    }
+    return count;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file csim-snapshot.h
+ * @brief Cache state checkpoints of the cache simulator
+ *
+ * A snapshot holds the complete state of every simulated cache_t of a run:
+ * tags, valid and dirty bits, recency links, replacement, prefetcher,
+ * sampling and write buffer state and the statistics accumulated so far,
+ * together with the access type the next record inherits. Loading it into
+ * caches of the same configuration resumes the simulation exactly where it
+ * was taken, so a warmup prefix or the head of a growing trace is simulated
+ * only once.
+ *
+ * The arrays are stored as they are in memory, so a snapshot is only read
+ * back on a host with the same byte order and word size, which the header
+ * records.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_SNAPSHOT_H
+#define CSIM_SNAPSHOT_H
+
+#include "csim.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** @brief First bytes of every snapshot */
+#define SNAPSHOT_MAGIC "CSIMSNAP"
+#define SNAPSHOT_MAGIC_LEN 8
+
+/** @brief Format version, bumped whenever the layout changes */
+#define SNAPSHOT_VERSION 4
+
+/** @brief Room for policy and prefetcher names, terminator included */
+#define SNAPSHOT_NAME_LEN 16
+
+/* Function prototyping */
+bool snapshotWrite(FILE *file, const cache_t *caches, unsigned int cacheCount,
+                   unsigned int memAccessType);
+bool snapshotRead(FILE *file, cache_t *caches, unsigned int cacheCount,
+                  unsigned int *pMemAccessType);
+
+#endif /* CSIM_SNAPSHOT_H */
@@ -0,0 +1,409 @@
+/**
+ * @file csim-stackdist.c
+ * @brief Stack-distance (Mattson) LRU engine for associativity sweeps
+ *
+ * Each set keeps its blocks ordered by the time of their last access. Time
+ * is a per-set slot number and a Fenwick tree counts the slots that still
+ * hold some block's most recent access, so the stack distance of a block
+ * (its LRU position, 1 being most recently used) is a prefix query in
+ * O(log n).
+ *
+ * An access at stack distance d hits in every cache with E >= d; a block
+ * pushed from position E to E + 1 has just been evicted from the E-way
+ * cache. Blocks falling below iMaxLinesPerSet are dropped since they miss
+ * in every tracked cache from then on, which bounds each set to
+ * iMaxLinesPerSet blocks and 2 * iMaxLinesPerSet slots between compactions.
+ *
+ * Dirty state is inclusive too: a block is dirty in every cache with
+ * E >= iCleanBelow, where iCleanBelow is reset to 1 by a store and raised to
+ * d by a load at distance d (which refetched it clean into every smaller
+ * cache). All per-E counters are kept as difference arrays so each access
+ * updates O(1) of them.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "csim-stackdist.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defines */
+#define STACKDIST_INITIAL_ENTRIES 1024
+#define STACKDIST_SLOT_PENDING UINT32_MAX
+#define STACKDIST_HASH_MULTIPLIER 0x9E3779B97F4A7C15UL
+
+/* Function prototyping */
+static bool stackDistSetAlloc(stackDist_t *sd, stackDistSet_t *set);
+static void stackDistCompact(stackDist_t *sd, stackDistSet_t *set);
+static void stackDistFinish(stackDist_t *sd);
+
+/**
+ * @brief Adds one to every entry of [lo, hi] of a difference array over E.
+ */
+static inline void stackDistRangeAdd(unsigned long *diff, unsigned int lo,
+                                     unsigned int hi) {
+    if (lo > hi)
+        return;
+    diff[lo]++;
+    diff[hi + 1]--;
+}
+
+/**
+ * @brief Adds delta to a slot of a set's Fenwick tree.
+ */
+static inline void stackDistFenwickAdd(stackDistSet_t *set,
+                                       unsigned int slotCount,
+                                       unsigned int slot, int delta) {
+    for (; slot <= slotCount; slot += slot & (~slot + 1))
+        set->pFenwick[slot] += delta;
+}
+
+/**
+ * @brief Counts the live slots in [1, slot] of a set.
+ */
+static inline unsigned int stackDistFenwickPrefix(const stackDistSet_t *set,
+                                                  unsigned int slot) {
+    int count = 0;
+    for (; slot > 0; slot &= slot - 1)
+        count += set->pFenwick[slot];
+    return (unsigned int)count;
+}
+
+/**
+ * @brief Home index of a block in the entry table.
+ */
+static inline size_t stackDistHome(const stackDist_t *sd, unsigned long block) {
+    unsigned long hash = block * STACKDIST_HASH_MULTIPLIER;
+    hash ^= hash >> 32;
+    return (size_t)hash & (sd->iEntryCapacity - 1);
+}
+
+/**
+ * @brief Looks up the entry of a block, NULL if it is not on any stack.
+ */
+static stackDistEntry_t *stackDistFind(stackDist_t *sd, unsigned long block) {
+    size_t mask = sd->iEntryCapacity - 1;
+    for (size_t i = stackDistHome(sd, block);; i = (i + 1) & mask) {
+        if (sd->pEntries[i].iSlot == 0)
+            return NULL;
+        if (sd->pEntries[i].iBlock == block)
+            return &sd->pEntries[i];
+    }
+}
+
+/**
+ * @brief Doubles the entry table, rehashing every entry.
+ *
+ * @return False if the larger table could not be allocated.
+ */
+static bool stackDistGrow(stackDist_t *sd) {
+    stackDistEntry_t *oldEntries = sd->pEntries;
+    size_t oldCapacity = sd->iEntryCapacity;
+    stackDistEntry_t *grown = calloc(oldCapacity * 2, sizeof(*grown));
+
+    if (grown == NULL)
+        return false;
+    sd->pEntries = grown;
+    sd->iEntryCapacity = oldCapacity * 2;
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (oldEntries[i].iSlot != 0) {
+            size_t j = stackDistHome(sd, oldEntries[i].iBlock);
+            while (grown[j].iSlot != 0)
+                j = (j + 1) & (sd->iEntryCapacity - 1);
+            grown[j] = oldEntries[i];
+        }
+    }
+    free(oldEntries);
+    return true;
+}
+
+/**
+ * @brief Adds a block to the entry table, keeping the load below one half.
+ *
+ * @return The new entry, or NULL if the table could not grow.
+ */
+static stackDistEntry_t *stackDistInsert(stackDist_t *sd,
+                                         unsigned long block) {
+    size_t i;
+
+    if (((sd->iEntryCount + 1) * 2 > sd->iEntryCapacity) && !stackDistGrow(sd))
+        return NULL;
+    for (i = stackDistHome(sd, block); sd->pEntries[i].iSlot != 0;
+         i = (i + 1) & (sd->iEntryCapacity - 1)) {
+    }
+    sd->iEntryCount++;
+    sd->pEntries[i].iBlock = block;
+    sd->pEntries[i].iSlot = STACKDIST_SLOT_PENDING;
+    return &sd->pEntries[i];
+}
+
+/**
+ * @brief Removes an entry using backward shift deletion.
+ */
+static void stackDistRemove(stackDist_t *sd, stackDistEntry_t *entry) {
+    size_t mask = sd->iEntryCapacity - 1;
+    size_t hole = (size_t)(entry - sd->pEntries);
+
+    for (size_t j = (hole + 1) & mask; sd->pEntries[j].iSlot != 0;
+         j = (j + 1) & mask) {
+        size_t home = stackDistHome(sd, sd->pEntries[j].iBlock);
+        /* Move the entry back unless its home lies in (hole, j] */
+        if (((j > hole) && ((home <= hole) || (home > j))) ||
+            ((j < hole) && (home <= hole) && (home > j))) {
+            sd->pEntries[hole] = sd->pEntries[j];
+            hole = j;
+        }
+    }
+    sd->pEntries[hole].iSlot = 0;
+    sd->iEntryCount--;
+}
+
+/**
+ * @brief Allocates the engine for every E up to maxLinesPerSet.
+ *
+ *
+ * @param[out]      stackDist_t *sd                 Engine to initialise
+ * @param[in]       unsigned int setBits            Number of set index bits
+ * @param[in]       unsigned int maxLinesPerSet     Largest E to report
+ * @param[in]       unsigned int blockBits          Number of block bits
+ *
+ * @return True on success, false if the heap allocation failed.
+ */
+bool stackDistInit(stackDist_t *sd, unsigned int setBits,
+                   unsigned int maxLinesPerSet, unsigned int blockBits) {
+    size_t counterCount = (size_t)maxLinesPerSet + 2;
+
+    memset((void *)sd, 0, sizeof(*sd));
+    sd->iSetBitCount = setBits;
+    sd->iBlockBitCount = blockBits;
+    sd->iMaxLinesPerSet = maxLinesPerSet;
+    sd->iSlotCount = 2 * maxLinesPerSet;
+    sd->iEntryCapacity = STACKDIST_INITIAL_ENTRIES;
+
+    sd->pSets = calloc((size_t)1 << setBits, sizeof(stackDistSet_t));
+    sd->pEntries = calloc(sd->iEntryCapacity, sizeof(stackDistEntry_t));
+    sd->pHits = calloc(counterCount, sizeof(unsigned long));
+    sd->pEvictions = calloc(counterCount, sizeof(unsigned long));
+    sd->pDirtyEvicted = calloc(counterCount, sizeof(unsigned long));
+    sd->pDirtyLines = calloc(counterCount, sizeof(unsigned long));
+    if ((sd->pSets == NULL) || (sd->pEntries == NULL) || (sd->pHits == NULL) ||
+        (sd->pEvictions == NULL) || (sd->pDirtyEvicted == NULL) ||
+        (sd->pDirtyLines == NULL)) {
+        stackDistFree(sd);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Releases everything held by the engine.
+ *
+ * @param[in,out]   stackDist_t *sd                 Engine to release
+ *
+ * @return void.
+ */
+void stackDistFree(stackDist_t *sd) {
+    if (sd->pSets != NULL) {
+        for (size_t i = 0; i < ((size_t)1 << sd->iSetBitCount); i++)
+            free(sd->pSets[i].pBlocks);
+    }
+    free(sd->pSets);
+    free(sd->pEntries);
+    free(sd->pHits);
+    free(sd->pEvictions);
+    free(sd->pDirtyEvicted);
+    free(sd->pDirtyLines);
+    memset((void *)sd, 0, sizeof(*sd));
+}
+
+/**
+ * @brief Allocates the stack of a set on its first access.
+ *
+ * The slot blocks, Fenwick tree and live flags share one allocation, in
+ * decreasing order of alignment.
+ */
+static bool stackDistSetAlloc(stackDist_t *sd, stackDistSet_t *set) {
+    size_t slots = (size_t)sd->iSlotCount + 1;
+    unsigned long *storage =
+        calloc(slots, sizeof(unsigned long) + sizeof(int) + 1);
+
+    if (storage == NULL)
+        return false;
+    set->pBlocks = storage;
+    set->pFenwick = (int *)(void *)(set->pBlocks + slots);
+    set->pLive = (unsigned char *)(set->pFenwick + slots);
+    set->iNextSlot = 1;
+    set->iOldest = 1;
+    return true;
+}
+
+/**
+ * @brief Renumbers the live slots of a set to 1..iLive.
+ *
+ * Runs once every iMaxLinesPerSet or more accesses to the set, keeping the
+ * slot numbers bounded by iSlotCount.
+ */
+static void stackDistCompact(stackDist_t *sd, stackDistSet_t *set) {
+    unsigned int slotCount = sd->iSlotCount;
+    unsigned int newSlot = 0;
+
+    for (unsigned int slot = set->iOldest; slot < set->iNextSlot; slot++) {
+        if (!set->pLive[slot])
+            continue;
+        newSlot++;
+        set->pBlocks[newSlot] = set->pBlocks[slot];
+        stackDistFind(sd, set->pBlocks[newSlot])->iSlot = newSlot;
+    }
+    memset(set->pLive + 1, 1, newSlot);
+    memset(set->pLive + newSlot + 1, 0, slotCount - newSlot);
+
+    /* Linear time Fenwick rebuild from the live flags */
+    for (unsigned int i = 1; i <= slotCount; i++)
+        set->pFenwick[i] = set->pLive[i];
+    for (unsigned int i = 1; i <= slotCount; i++) {
+        unsigned int parent = i + (i & (~i + 1));
+        if (parent <= slotCount)
+            set->pFenwick[parent] += set->pFenwick[i];
+    }
+    set->iNextSlot = newSlot + 1;
+    set->iOldest = 1;
+}
+
+/**
+ * @brief Records one access of the trace.
+ *
+ *
+ * @param[in,out]   stackDist_t *sd                 Engine
+ * @param[in]       unsigned int memAccessType      0 for load, 1 for store
+ * @param[in]       unsigned long memAddr           Memory address accessed
+ *
+ * @return False if the engine ran out of memory.
+ */
+bool stackDistAccess(stackDist_t *sd, unsigned int memAccessType,
+                     unsigned long memAddr) {
+    unsigned long block = memAddr >> sd->iBlockBitCount;
+    unsigned long setMask = ((unsigned long)1 << sd->iSetBitCount) - 1;
+    stackDistSet_t *set = &sd->pSets[block & setMask];
+    unsigned int maxLines = sd->iMaxLinesPerSet;
+    stackDistEntry_t *entry;
+    unsigned int slot;
+
+    if ((set->pFenwick == NULL) && !stackDistSetAlloc(sd, set))
+        return false;
+    sd->iAccesses++;
+
+    entry = stackDistFind(sd, block);
+    if (entry != NULL) {
+        /* Live slots at or above this block's last access */
+        unsigned int distance =
+            set->iLive - stackDistFenwickPrefix(set, entry->iSlot - 1);
+        sd->pHits[distance]++;
+        /* Blocks above it each slide down one position */
+        stackDistRangeAdd(sd->pEvictions, 1, distance - 1);
+        stackDistRangeAdd(sd->pDirtyEvicted, entry->iCleanBelow, distance - 1);
+        if (memAccessType == 1)
+            entry->iCleanBelow = 1;
+        else if (entry->iCleanBelow < distance)
+            entry->iCleanBelow = distance;
+        stackDistFenwickAdd(set, sd->iSlotCount, entry->iSlot, -1);
+        set->pLive[entry->iSlot] = 0;
+    } else {
+        /* Cold for every tracked cache, the whole stack slides down */
+        stackDistRangeAdd(sd->pEvictions, 1, set->iLive);
+        if (set->iLive == maxLines) {
+            /* Drop the block pushed below the largest tracked cache */
+            stackDistEntry_t *oldest;
+            while (!set->pLive[set->iOldest])
+                set->iOldest++;
+            oldest = stackDistFind(sd, set->pBlocks[set->iOldest]);
+            stackDistRangeAdd(sd->pDirtyEvicted, oldest->iCleanBelow,
+                              maxLines);
+            stackDistFenwickAdd(set, sd->iSlotCount, set->iOldest, -1);
+            set->pLive[set->iOldest] = 0;
+            stackDistRemove(sd, oldest);
+            set->iLive--;
+        }
+        entry = stackDistInsert(sd, block);
+        if (entry == NULL)
+            return false;
+        entry->iCleanBelow = (memAccessType == 1) ? 1 : maxLines + 1;
+        set->iLive++;
+    }
+
+    /* Push the block on top of the stack */
+    if (set->iNextSlot > sd->iSlotCount)
+        stackDistCompact(sd, set);
+    slot = set->iNextSlot++;
+    set->pBlocks[slot] = block;
+    set->pLive[slot] = 1;
+    stackDistFenwickAdd(set, sd->iSlotCount, slot, 1);
+    entry->iSlot = slot;
+    return true;
+}
+
+/**
+ * @brief Folds the blocks still on the stacks into the per-E counters.
+ *
+ * A block at final position p has been evicted from every cache with
+ * E < p since its last access, and is resident in all the others.
+ */
+static void stackDistFinish(stackDist_t *sd) {
+    unsigned int maxLines = sd->iMaxLinesPerSet;
+
+    for (size_t i = 0; i < ((size_t)1 << sd->iSetBitCount); i++) {
+        stackDistSet_t *set = &sd->pSets[i];
+        unsigned int position = 0;
+        if (set->pFenwick == NULL)
+            continue;
+        for (unsigned int slot = set->iNextSlot - 1; slot >= set->iOldest;
+             slot--) {
+            stackDistEntry_t *entry;
+            if (!set->pLive[slot])
+                continue;
+            position++;
+            entry = stackDistFind(sd, set->pBlocks[slot]);
+            stackDistRangeAdd(sd->pDirtyEvicted, entry->iCleanBelow,
+                              position - 1);
+            stackDistRangeAdd(sd->pDirtyLines,
+                              (entry->iCleanBelow > position)
+                                  ? entry->iCleanBelow
+                                  : position,
+                              maxLines);
+        }
+    }
+    sd->bFinished = true;
+}
+
+/**
+ * @brief Computes the statistics of one associativity.
+ *
+ * The first call ends the simulation; no accesses may follow it.
+ *
+ * @param[in,out]   stackDist_t *sd                 Engine
+ * @param[in]       unsigned int linesPerSet        E, at most iMaxLinesPerSet
+ * @param[out]      csim_stats_t *stats             Cache statistics
+ *
+ * @return void.
+ */
+void stackDistSummary(stackDist_t *sd, unsigned int linesPerSet,
+                      csim_stats_t *stats) {
+    unsigned long blockBytes = (unsigned long)1 << sd->iBlockBitCount;
+    unsigned long dirtyEvicted = 0;
+    unsigned long dirtyLines = 0;
+
+    if (!sd->bFinished)
+        stackDistFinish(sd);
+
+    memset((void *)stats, 0, sizeof(*stats));
+    for (unsigned int e = 1; e <= linesPerSet; e++) {
+        stats->hits += sd->pHits[e];
+        stats->evictions += sd->pEvictions[e];
+        dirtyEvicted += sd->pDirtyEvicted[e];
+        dirtyLines += sd->pDirtyLines[e];
+    }
+    stats->misses = sd->iAccesses - stats->hits;
+    stats->dirty_bytes = dirtyLines * blockBytes;
+    stats->dirty_evictions = dirtyEvicted * blockBytes;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file csim-stackdist.h
+ * @brief Stack-distance (Mattson) LRU engine for associativity sweeps
+ *
+ * LRU has the inclusion property: for a fixed number of sets, the contents
+ * of an E-way set are always the E most recently used blocks mapping to it.
+ * Recording the stack distance of every access therefore yields the hits,
+ * misses and evictions of every associativity up to iMaxLinesPerSet in a
+ * single pass, instead of one checkSimulatorCache run per E.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_STACKDIST_H
+#define CSIM_STACKDIST_H
+
+#include "cachelab.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Recency state of one block held in the per-set stacks */
+typedef struct {
+    unsigned long iBlock;     /* Block number, address >> b */
+    unsigned int iSlot;       /* Time slot of the last access, 0 when free */
+    unsigned int iCleanBelow; /* Dirty in every cache with E >= this value */
+} stackDistEntry_t;
+
+/* Stack of one cache set, ordered by a Fenwick tree over time slots */
+typedef struct {
+    unsigned long *pBlocks; /* Block accessed in each slot */
+    int *pFenwick;          /* Live slot counts, 1-based */
+    unsigned char *pLive;   /* Slot still holds its block's last access */
+    unsigned int iNextSlot; /* Slot given to the next access */
+    unsigned int iOldest;   /* No live slot lies below this one */
+    unsigned int iLive;     /* Blocks on the stack, at most iMaxLinesPerSet */
+} stackDistSet_t;
+
+/* Stack-distance simulation of every E in [1, iMaxLinesPerSet] */
+typedef struct {
+    unsigned int iSetBitCount;    /* Number of set index bits, s */
+    unsigned int iBlockBitCount;  /* Number of block offset bits, b */
+    unsigned int iMaxLinesPerSet; /* Largest associativity tracked */
+    unsigned int iSlotCount;      /* Time slots per set before compaction */
+    stackDistSet_t *pSets;        /* Per-set stacks, allocated on first use */
+    stackDistEntry_t *pEntries;   /* Open addressed block table */
+    size_t iEntryCapacity;        /* Table size, a power of two */
+    size_t iEntryCount;           /* Occupied table entries */
+    unsigned long iAccesses;      /* Accesses simulated */
+    unsigned long *pHits;         /* [d] accesses with stack distance d */
+    unsigned long *pEvictions;    /* Difference array over E */
+    unsigned long *pDirtyEvicted; /* Difference array over E */
+    unsigned long *pDirtyLines;   /* Difference array over E */
+    bool bFinished;               /* Live blocks folded into the arrays */
+} stackDist_t;
+
+/* Function prototyping */
+bool stackDistInit(stackDist_t *sd, unsigned int setBits,
+                   unsigned int maxLinesPerSet, unsigned int blockBits);
+void stackDistFree(stackDist_t *sd);
+bool stackDistAccess(stackDist_t *sd, unsigned int memAccessType,
+                     unsigned long memAddr);
+void stackDistSummary(stackDist_t *sd, unsigned int linesPerSet,
+                      csim_stats_t *stats);
+
+#endif /* CSIM_STACKDIST_H */
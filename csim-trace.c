@@ -0,0 +1,878 @@
+/**
+ * @file csim-trace.c
+ * @brief Trace file reader used by the cache simulator
+ *
+ * Records have the form "<op> <hex address>,<decimal size>" with one record
+ * per line. Rather than going through fscanf, which is locale aware and
+ * re-interprets its format string for every line, records are scanned
+ * directly out of the mapped file bytes with a dedicated hex decoder.
+ *
+ * When the trace cannot be mapped (it is a pipe or a device) the same parser
+ * runs over a buffer refilled with read(2). The buffer is topped up whenever
+ * fewer than TRACE_MAX_RECORD_LEN bytes remain, so a record never straddles
+ * a refill.
+ *
+ * On machines with more than one CPU an unmapped trace is parsed on a
+ * background thread that owns a private inline reader. It fills two batches
+ * of TRACE_BATCH_RECORDS records in turn while the caller consumes the other
+ * one, and the two sides only meet under a mutex once per batch. A batch
+ * shorter than TRACE_BATCH_RECORDS ends the trace.
+ *
+ * Binary traces start with a TRACE_BINARY_HEADER_SIZE byte header:
+ *   bytes 0-3   TRACE_BINARY_MAGIC
+ *   byte  4     TRACE_BINARY_VERSION
+ *   byte  5     byte order of the record count, 1 little / 2 big endian
+ *   bytes 6-7   reserved, zero
+ *   bytes 8-15  record count, TRACE_BINARY_COUNT_UNKNOWN if not known
+ * Each record is then a tag byte followed by LEB128 varints:
+ *   tag bit 0     access type, 0 load / 1 store
+ *   tag bit 1     address delta is negative
+ *   tag bits 2-7  access size, or TRACE_BINARY_SIZE_ESCAPE if it follows
+ *   varint        magnitude of the address delta from the previous record
+ *   varint        access size, only present when escaped
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* mmap, posix_madvise, pthreads and friends are POSIX, not C99 */
+#define _POSIX_C_SOURCE 200809L
+
+/* Importing header files */
+#include "csim-trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Defines */
+#define TRACE_BINARY_OP_STORE 0x1
+#define TRACE_BINARY_DELTA_NEGATIVE 0x2
+#define TRACE_BINARY_SIZE_SHIFT 2
+#define TRACE_BINARY_SIZE_ESCAPE 63
+#define TRACE_BINARY_LITTLE_ENDIAN 1
+#define TRACE_BINARY_BIG_ENDIAN 2
+#define TRACE_VARINT_MAX_LEN 10
+
+/* Background parser, batch k is either owned by the parser or, once full,
+   by the caller until it asks for the next one */
+struct traceParserThread {
+    pthread_t thread;           /* Parser thread */
+    pthread_mutex_t lock;       /* Guards the fields below */
+    pthread_cond_t changed;     /* Signalled on every change */
+    traceRecord_t *pBatches[2]; /* TRACE_BATCH_RECORDS each */
+    size_t iCounts[2];          /* Records in each full batch */
+    bool bFull[2];              /* Batch handed to the caller */
+    bool bFinished;             /* Parser published its last batch */
+    bool bStop;                 /* Caller closed the trace */
+    unsigned int iConsumed;     /* Batch the caller holds */
+    bool bHolding;              /* The caller holds a batch */
+    traceReader_t parser;       /* Inline reader of the trace */
+};
+
+/* Function prototyping */
+static bool traceReaderFill(traceReader_t *reader);
+static bool traceReaderNextInline(traceReader_t *reader,
+                                  traceRecord_t *record);
+static bool traceReaderNextBatch(traceReader_t *reader);
+static void traceReaderStartThread(traceReader_t *reader);
+static void *traceParserMain(void *arg);
+static void traceReaderDetectFormat(traceReader_t *reader);
+static bool traceParseRecord(traceReader_t *reader, traceRecord_t *record);
+static bool traceDecodeRecord(traceReader_t *reader, traceRecord_t *record);
+static unsigned char traceNativeByteOrder(void);
+static inline bool traceCoalescerRead(traceCoalescer_t *coalescer,
+                                      traceRecord_t *record);
+static inline bool traceCoalescerFits(const traceCoalescer_t *coalescer,
+                                      const traceRecord_t *record);
+
+/**
+ * @brief Open a trace file for reading.
+ *
+ * Regular, non-empty files are memory mapped. Everything else is read
+ * through a buffer of TRACE_READ_BUFFER_SIZE bytes by a background parser,
+ * or inline if the thread could not be started.
+ *
+ * @param[out]      traceReader_t *reader       Reader state to initialise
+ * @param[in]       const char *fileName        Path of the trace file, "-"
+ * for standard input
+ *
+ * @return True if the trace was opened, false otherwise.
+ */
+bool traceReaderOpen(traceReader_t *reader, const char *fileName) {
+    int fd;
+
+    /* Standard input is duplicated so closing the trace leaves it open */
+    if (strcmp(fileName, "-") == 0)
+        fd = dup(STDIN_FILENO);
+    else
+        fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        memset((void *)reader, 0, sizeof(*reader));
+        reader->fd = -1;
+        return false;
+    }
+    return traceReaderOpenFd(reader, fd);
+}
+
+/**
+ * @brief Read a trace from an open file descriptor.
+ *
+ * The reader takes ownership of the descriptor, which is closed by
+ * traceReaderClose or right away if the trace cannot be read. This lets a
+ * trace be simulated while another process is still writing it to a pipe.
+ *
+ * @param[out]      traceReader_t *reader       Reader state to initialise
+ * @param[in]       int fd                      Descriptor open for reading
+ *
+ * @return True if the trace was opened, false otherwise.
+ */
+bool traceReaderOpenFd(traceReader_t *reader, int fd) {
+    struct stat fileInfo;
+
+    memset((void *)reader, 0, sizeof(*reader));
+    reader->fd = fd;
+
+    if ((fstat(reader->fd, &fileInfo) == 0) && S_ISREG(fileInfo.st_mode) &&
+        (fileInfo.st_size > 0)) {
+        void *map = mmap(NULL, (size_t)fileInfo.st_size, PROT_READ,
+                         MAP_PRIVATE, reader->fd, 0);
+        if (map != MAP_FAILED) {
+            (void)posix_madvise(map, (size_t)fileInfo.st_size,
+                                POSIX_MADV_SEQUENTIAL);
+            reader->bMapped = true;
+            reader->bEndOfFile = true;
+            reader->pBuffer = map;
+            reader->iMappedLength = (size_t)fileInfo.st_size;
+            reader->pCursor = reader->pBuffer;
+            reader->pEnd = reader->pBuffer + reader->iMappedLength;
+            traceReaderDetectFormat(reader);
+            return true;
+        }
+    }
+
+    /* Fall back to buffered reads for pipes and unmappable files */
+    reader->pBuffer = malloc(TRACE_READ_BUFFER_SIZE);
+    if (reader->pBuffer == NULL) {
+        close(reader->fd);
+        reader->fd = -1;
+        return false;
+    }
+    reader->pCursor = reader->pBuffer;
+    reader->pEnd = reader->pBuffer;
+    if (!traceReaderFill(reader)) {
+        traceReaderClose(reader);
+        return false;
+    }
+    traceReaderDetectFormat(reader);
+    traceReaderStartThread(reader);
+    return true;
+}
+
+/**
+ * @brief Read a trace that is already in memory.
+ *
+ * The bytes are parsed in place, exactly as if they had been mapped from a
+ * file, and are not freed by traceReaderClose.
+ *
+ * @param[out]      traceReader_t *reader       Reader state to initialise
+ * @param[in]       const char *data            Text or binary trace bytes
+ * @param[in]       size_t length               Number of bytes in data
+ *
+ * @return void.
+ */
+void traceReaderOpenMemory(traceReader_t *reader, const char *data,
+                           size_t length) {
+    memset((void *)reader, 0, sizeof(*reader));
+    reader->fd = -1;
+    reader->bEndOfFile = true;
+    reader->pCursor = data;
+    reader->pEnd = data + length;
+    traceReaderDetectFormat(reader);
+}
+
+/**
+ * @brief Parse the next record of the trace.
+ *
+ * Parsing stops at the end of the trace or at the first malformed record.
+ *
+ * @param[in,out]   traceReader_t *reader       Open trace
+ * @param[out]      traceRecord_t *record       Parsed record
+ *
+ * @return True if a record was parsed, false at end of trace.
+ */
+bool traceReaderNext(traceReader_t *reader, traceRecord_t *record) {
+    if (reader->pBatchCursor == reader->pBatchEnd) {
+        if (reader->pThread == NULL)
+            return traceReaderNextInline(reader, record);
+        if (!traceReaderNextBatch(reader))
+            return false;
+    }
+    *record = *reader->pBatchCursor++;
+    return true;
+}
+
+/**
+ * @brief Parse the next record on the calling thread.
+ */
+static bool traceReaderNextInline(traceReader_t *reader,
+                                  traceRecord_t *record) {
+    if (!reader->bEndOfFile &&
+        ((size_t)(reader->pEnd - reader->pCursor) < TRACE_MAX_RECORD_LEN)) {
+        if (!traceReaderFill(reader))
+            return false;
+    }
+    if (reader->bBinary)
+        return traceDecodeRecord(reader, record);
+    return traceParseRecord(reader, record);
+}
+
+/**
+ * @brief Release all resources held by an open trace.
+ *
+ * @param[in,out]   traceReader_t *reader       Open trace
+ *
+ * @return void.
+ */
+void traceReaderClose(traceReader_t *reader) {
+    traceParserThread_t *parserThread = reader->pThread;
+
+    if (parserThread != NULL) {
+        pthread_mutex_lock(&parserThread->lock);
+        parserThread->bStop = true;
+        pthread_cond_broadcast(&parserThread->changed);
+        pthread_mutex_unlock(&parserThread->lock);
+        pthread_join(parserThread->thread, NULL);
+        traceReaderClose(&parserThread->parser);
+        pthread_cond_destroy(&parserThread->changed);
+        pthread_mutex_destroy(&parserThread->lock);
+        free(parserThread->pBatches[0]);
+        free(parserThread->pBatches[1]);
+        free(parserThread);
+    }
+    if (reader->bMapped)
+        munmap(reader->pBuffer, reader->iMappedLength);
+    else
+        free(reader->pBuffer);
+    if (reader->fd >= 0)
+        close(reader->fd);
+    memset((void *)reader, 0, sizeof(*reader));
+    reader->fd = -1;
+}
+
+/**
+ * @brief Moves an inline reader's state to a background parser thread.
+ *
+ * The reader keeps parsing inline if the thread cannot be started, and on a
+ * single CPU, where the two threads could only take turns.
+ *
+ * @param[in,out]   traceReader_t *reader       Open, unmapped trace
+ *
+ * @return void.
+ */
+static void traceReaderStartThread(traceReader_t *reader) {
+    traceParserThread_t *parserThread;
+
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        return;
+    parserThread = calloc(1, sizeof(*parserThread));
+    if (parserThread == NULL)
+        return;
+    parserThread->pBatches[0] =
+        malloc(TRACE_BATCH_RECORDS * sizeof(traceRecord_t));
+    parserThread->pBatches[1] =
+        malloc(TRACE_BATCH_RECORDS * sizeof(traceRecord_t));
+    parserThread->parser = *reader;
+    if ((parserThread->pBatches[0] == NULL) ||
+        (parserThread->pBatches[1] == NULL) ||
+        (pthread_mutex_init(&parserThread->lock, NULL) != 0)) {
+        free(parserThread->pBatches[0]);
+        free(parserThread->pBatches[1]);
+        free(parserThread);
+        return;
+    }
+    if ((pthread_cond_init(&parserThread->changed, NULL) != 0) ||
+        (pthread_create(&parserThread->thread, NULL, traceParserMain,
+                        parserThread) != 0)) {
+        pthread_mutex_destroy(&parserThread->lock);
+        free(parserThread->pBatches[0]);
+        free(parserThread->pBatches[1]);
+        free(parserThread);
+        return;
+    }
+    /* The parser owns the descriptor and buffer from here on, the caller
+       only keeps the detected format */
+    memset((void *)reader, 0, sizeof(*reader));
+    reader->fd = -1;
+    reader->bBinary = parserThread->parser.bBinary;
+    reader->pThread = parserThread;
+}
+
+/**
+ * @brief Parser thread, fills the two batches in turn until the trace ends.
+ */
+static void *traceParserMain(void *arg) {
+    traceParserThread_t *parserThread = arg;
+    unsigned int k = 0;
+    size_t count = TRACE_BATCH_RECORDS;
+
+    while (count == TRACE_BATCH_RECORDS) {
+        traceRecord_t *batch = parserThread->pBatches[k];
+        bool bStop;
+        pthread_mutex_lock(&parserThread->lock);
+        while (parserThread->bFull[k] && !parserThread->bStop)
+            pthread_cond_wait(&parserThread->changed, &parserThread->lock);
+        bStop = parserThread->bStop;
+        pthread_mutex_unlock(&parserThread->lock);
+        if (bStop)
+            break;
+
+        count = 0;
+        while ((count < TRACE_BATCH_RECORDS) &&
+               traceReaderNextInline(&parserThread->parser, &batch[count]))
+            count++;
+
+        pthread_mutex_lock(&parserThread->lock);
+        parserThread->iCounts[k] = count;
+        parserThread->bFull[k] = true;
+        if (count < TRACE_BATCH_RECORDS)
+            parserThread->bFinished = true;
+        pthread_cond_broadcast(&parserThread->changed);
+        pthread_mutex_unlock(&parserThread->lock);
+        k ^= 1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hands the consumed batch back and waits for the next one.
+ *
+ * @param[in,out]   traceReader_t *reader       Trace with a parser thread
+ *
+ * @return False once the parser has no more records.
+ */
+static bool traceReaderNextBatch(traceReader_t *reader) {
+    traceParserThread_t *parserThread = reader->pThread;
+    unsigned int k = parserThread->iConsumed;
+    bool bHaveBatch;
+
+    pthread_mutex_lock(&parserThread->lock);
+    if (parserThread->bHolding) {
+        parserThread->bFull[k] = false;
+        parserThread->bHolding = false;
+        k ^= 1;
+        pthread_cond_broadcast(&parserThread->changed);
+    }
+    while (!parserThread->bFull[k] && !parserThread->bFinished)
+        pthread_cond_wait(&parserThread->changed, &parserThread->lock);
+    bHaveBatch = parserThread->bFull[k] && (parserThread->iCounts[k] != 0);
+    if (parserThread->bFull[k]) {
+        parserThread->bHolding = true;
+        reader->pBatchCursor = parserThread->pBatches[k];
+        reader->pBatchEnd =
+            parserThread->pBatches[k] + parserThread->iCounts[k];
+    }
+    parserThread->iConsumed = k;
+    pthread_mutex_unlock(&parserThread->lock);
+    return bHaveBatch;
+}
+
+/**
+ * @brief Top up the read buffer of an unmapped trace.
+ *
+ * Unparsed bytes are moved to the start of the buffer and the remainder is
+ * filled from the file until it is full or the file is exhausted.
+ *
+ * @param[in,out]   traceReader_t *reader       Open, unmapped trace
+ *
+ * @return False on a read error, true otherwise.
+ */
+static bool traceReaderFill(traceReader_t *reader) {
+    size_t remaining = (size_t)(reader->pEnd - reader->pCursor);
+    memmove(reader->pBuffer, reader->pCursor, remaining);
+    reader->pCursor = reader->pBuffer;
+    reader->pEnd = reader->pBuffer + remaining;
+
+    while (remaining < TRACE_READ_BUFFER_SIZE) {
+        ssize_t bytesRead = read(reader->fd, reader->pBuffer + remaining,
+                                 TRACE_READ_BUFFER_SIZE - remaining);
+        if (bytesRead < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Error reading trace: %s\n", strerror(errno));
+            reader->bEndOfFile = true;
+            return false;
+        }
+        if (bytesRead == 0) {
+            reader->bEndOfFile = true;
+            break;
+        }
+        remaining += (size_t)bytesRead;
+        reader->pEnd = reader->pBuffer + remaining;
+    }
+    return true;
+}
+
+/**
+ * @brief Decode a single hexadecimal digit.
+ *
+ * @param[in]       char c      Character to decode
+ *
+ * @return Value of the digit, or -1 if c is not a hex digit.
+ */
+static inline int traceHexDigit(char c) {
+    unsigned int digit = (unsigned int)(unsigned char)c - '0';
+    if (digit < 10)
+        return (int)digit;
+    digit = ((unsigned int)(unsigned char)c | 0x20) - 'a';
+    if (digit < 6)
+        return (int)digit + 10;
+    return -1;
+}
+
+/**
+ * @brief Check for the whitespace characters fscanf would skip.
+ */
+static inline bool traceIsSpace(char c) {
+    return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r') ||
+           (c == '\v') || (c == '\f');
+}
+
+/**
+ * @brief Scan one "<op> <hex address>,<decimal size>" record.
+ *
+ * @param[in,out]   traceReader_t *reader       Open trace
+ * @param[out]      traceRecord_t *record       Parsed record
+ *
+ * @return True if a complete record was parsed, false otherwise.
+ */
+static bool traceParseRecord(traceReader_t *reader, traceRecord_t *record) {
+    const char *p = reader->pCursor;
+    const char *end = reader->pEnd;
+    unsigned long address = 0;
+    int byteSize = 0;
+    int digit;
+    bool bNegative = false;
+
+    /* Leading whitespace and the access type */
+    while ((p < end) && traceIsSpace(*p))
+        p++;
+    if (p == end)
+        return false;
+    record->accessType = *p++;
+
+    /* Hex address, with an optional 0x prefix */
+    while ((p < end) && traceIsSpace(*p))
+        p++;
+    if (((end - p) > 2) && (p[0] == '0') && ((p[1] | 0x20) == 'x') &&
+        (traceHexDigit(p[2]) >= 0))
+        p += 2;
+    if ((p == end) || (traceHexDigit(*p) < 0))
+        return false;
+    while ((p < end) && ((digit = traceHexDigit(*p)) >= 0)) {
+        address = (address << 4) | (unsigned long)digit;
+        p++;
+    }
+
+    /* Separator and decimal size */
+    if ((p == end) || (*p != ','))
+        return false;
+    p++;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        bNegative = (*p == '-');
+        p++;
+    }
+    if ((p == end) || ((unsigned int)(unsigned char)*p - '0' >= 10))
+        return false;
+    while ((p < end) && ((unsigned int)(unsigned char)*p - '0' < 10)) {
+        byteSize = (byteSize * 10) + (*p - '0');
+        p++;
+    }
+
+    /* Trailing whitespace up to the next record */
+    while ((p < end) && traceIsSpace(*p))
+        p++;
+
+    record->address = address;
+    record->byteSize = bNegative ? -byteSize : byteSize;
+    reader->pCursor = p;
+    return true;
+}
+
+/**
+ * @brief Byte order of this machine, as stored in the binary header.
+ */
+static unsigned char traceNativeByteOrder(void) {
+    const uint16_t probe = 1;
+    unsigned char firstByte;
+    memcpy(&firstByte, &probe, 1);
+    return (firstByte == 1) ? TRACE_BINARY_LITTLE_ENDIAN
+                            : TRACE_BINARY_BIG_ENDIAN;
+}
+
+/**
+ * @brief Recognise a binary trace header at the start of the buffer.
+ *
+ * Text traces cannot begin with TRACE_BINARY_MAGIC, so anything else is
+ * left for the text parser.
+ *
+ * @param[in,out]   traceReader_t *reader       Freshly opened trace
+ *
+ * @return void.
+ */
+static void traceReaderDetectFormat(traceReader_t *reader) {
+    const unsigned char *header = (const unsigned char *)reader->pCursor;
+    uint64_t recordCount = 0;
+
+    if (((size_t)(reader->pEnd - reader->pCursor) <
+         TRACE_BINARY_HEADER_SIZE) ||
+        (memcmp(header, TRACE_BINARY_MAGIC, 4) != 0) ||
+        (header[4] != TRACE_BINARY_VERSION))
+        return;
+
+    /* Assemble the count in the byte order the writer recorded */
+    for (unsigned int i = 0; i < 8; i++) {
+        unsigned int byteIndex =
+            (header[5] == TRACE_BINARY_BIG_ENDIAN) ? (8 + i) : (15 - i);
+        recordCount = (recordCount << 8) | header[byteIndex];
+    }
+
+    reader->bBinary = true;
+    reader->iRecordsLeft = recordCount;
+    reader->iPrevAddress = 0;
+    reader->pCursor += TRACE_BINARY_HEADER_SIZE;
+}
+
+/**
+ * @brief Decode an unsigned LEB128 varint.
+ *
+ * @param[in,out]   const char **cursor         Next byte, advanced past the
+ * varint
+ * @param[in]       const char *end             One past the last valid byte
+ * @param[out]      unsigned long *value        Decoded value
+ *
+ * @return False if the varint is truncated or too long.
+ */
+static inline bool traceDecodeVarint(const char **cursor, const char *end,
+                                     unsigned long *value) {
+    const char *p = *cursor;
+    unsigned long result = 0;
+
+    for (unsigned int i = 0; (p < end) && (i < TRACE_VARINT_MAX_LEN); i++) {
+        unsigned char byte = (unsigned char)*p++;
+        result |= (unsigned long)(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            *cursor = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decode one packed binary record.
+ *
+ * @param[in,out]   traceReader_t *reader       Open binary trace
+ * @param[out]      traceRecord_t *record       Decoded record
+ *
+ * @return True if a record was decoded, false at end of trace.
+ */
+static bool traceDecodeRecord(traceReader_t *reader, traceRecord_t *record) {
+    const char *p = reader->pCursor;
+    unsigned long delta = 0;
+    unsigned long byteSize;
+    unsigned char tag;
+
+    if ((reader->iRecordsLeft == 0) || (p == reader->pEnd))
+        return false;
+
+    tag = (unsigned char)*p++;
+    if (!traceDecodeVarint(&p, reader->pEnd, &delta))
+        return false;
+    byteSize = (unsigned long)(tag >> TRACE_BINARY_SIZE_SHIFT);
+    if ((byteSize == TRACE_BINARY_SIZE_ESCAPE) &&
+        !traceDecodeVarint(&p, reader->pEnd, &byteSize))
+        return false;
+
+    if (tag & TRACE_BINARY_DELTA_NEGATIVE)
+        reader->iPrevAddress -= delta;
+    else
+        reader->iPrevAddress += delta;
+
+    record->accessType = (tag & TRACE_BINARY_OP_STORE) ? 'S' : 'L';
+    record->address = reader->iPrevAddress;
+    record->byteSize = (int)byteSize;
+    reader->pCursor = p;
+    if (reader->iRecordsLeft != TRACE_BINARY_COUNT_UNKNOWN)
+        reader->iRecordsLeft--;
+    return true;
+}
+
+/**
+ * @brief Start coalescing the records of an open trace into runs.
+ *
+ * Tight loops produce long runs of accesses to one block, and every access
+ * of a run but the first is bound to hit. Handing the run over as a single
+ * traceRun_t lets the simulator count those hits at once instead of probing
+ * for each. As in csim, a record that is neither a load nor a store
+ * repeats the type of the previous one, a load before any.
+ *
+ * @param[out]      traceCoalescer_t *coalescer Coalescer to initialise
+ * @param[in,out]   traceReader_t *reader       Open trace, read through the
+ * coalescer only from now on
+ * @param[in]       unsigned int blockBits      Number of block bits, the
+ * smallest of every simulated cache
+ * @param[in]       bool bSplitAccesses         Accesses straddling a block
+ * boundary are simulated once per block, so never join a run
+ *
+ * @return void.
+ */
+void traceCoalescerInit(traceCoalescer_t *coalescer, traceReader_t *reader,
+                        unsigned int blockBits, bool bSplitAccesses) {
+    memset((void *)coalescer, 0, sizeof(*coalescer));
+    coalescer->pReader = reader;
+    coalescer->iBlockBits = blockBits;
+    coalescer->bSplitAccesses = bSplitAccesses;
+    coalescer->iMaxRecords = ULONG_MAX;
+    coalescer->accessType = 'L';
+}
+
+/**
+ * @brief Read the next run of accesses to one block.
+ *
+ * The record that breaks a run is held back to start the next one. A run
+ * also ends once it holds iMaxRecords records, which callers lower to end
+ * runs at a record count of their choosing.
+ *
+ * @param[in,out]   traceCoalescer_t *coalescer Coalescer
+ * @param[out]      traceRun_t *run             Next run
+ *
+ * @return False at the end of the trace.
+ */
+bool traceCoalescerNext(traceCoalescer_t *coalescer, traceRun_t *run) {
+    traceRecord_t record;
+    unsigned long block;
+
+    if (coalescer->bPending)
+        run->first = coalescer->pending;
+    else if (!traceCoalescerRead(coalescer, &run->first))
+        return false;
+    coalescer->bPending = false;
+    run->iRepeats = 0;
+    run->bDirty = false;
+    if (!traceCoalescerFits(coalescer, &run->first))
+        return true;
+
+    block = run->first.address >> coalescer->iBlockBits;
+    while ((run->iRepeats + 1 < coalescer->iMaxRecords) &&
+           traceCoalescerRead(coalescer, &record)) {
+        if (((record.address >> coalescer->iBlockBits) != block) ||
+            !traceCoalescerFits(coalescer, &record)) {
+            coalescer->pending = record;
+            coalescer->bPending = true;
+            break;
+        }
+        run->iRepeats++;
+        if (record.accessType == 'S')
+            run->bDirty = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Read the next record, resolving its type to a load or a store.
+ */
+static inline bool traceCoalescerRead(traceCoalescer_t *coalescer,
+                                      traceRecord_t *record) {
+    if (!traceReaderNext(coalescer->pReader, record))
+        return false;
+    if ((record->accessType == 'L') || (record->accessType == 'S'))
+        coalescer->accessType = record->accessType;
+    else
+        record->accessType = coalescer->accessType;
+    return true;
+}
+
+/**
+ * @brief Whether a record may join a run, it always may without -S.
+ *
+ * With -S it must not cross into the next block. The offset is below the
+ * block size, so the sum cannot overflow.
+ */
+static inline bool traceCoalescerFits(const traceCoalescer_t *coalescer,
+                                      const traceRecord_t *record) {
+    unsigned long offset =
+        record->address & ((1UL << coalescer->iBlockBits) - 1);
+
+    if (!coalescer->bSplitAccesses || (record->byteSize <= 1))
+        return true;
+    return ((offset + (unsigned long)record->byteSize - 1) >>
+            coalescer->iBlockBits) == 0;
+}
+
+/**
+ * @brief Encode an unsigned LEB128 varint.
+ *
+ * @param[out]      unsigned char *out          At least TRACE_VARINT_MAX_LEN
+ * bytes of output space
+ * @param[in]       unsigned long value         Value to encode
+ *
+ * @return Number of bytes written.
+ */
+static inline size_t traceEncodeVarint(unsigned char *out,
+                                       unsigned long value) {
+    size_t length = 0;
+    while (value > 0x7f) {
+        out[length++] = (unsigned char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
+
+/**
+ * @brief Write the binary header with the given record count.
+ */
+static bool traceWriteHeader(FILE *file, uint64_t recordCount) {
+    unsigned char header[TRACE_BINARY_HEADER_SIZE] = {0};
+    unsigned char byteOrder = traceNativeByteOrder();
+
+    memcpy(header, TRACE_BINARY_MAGIC, 4);
+    header[4] = TRACE_BINARY_VERSION;
+    header[5] = byteOrder;
+    memcpy(&header[8], &recordCount, sizeof(recordCount));
+    return fwrite(header, sizeof(header), 1, file) == 1;
+}
+
+/**
+ * @brief Create a trace file for writing.
+ *
+ * @param[out]      traceWriter_t *writer       Writer state to initialise
+ * @param[in]       const char *fileName        Output path, "-" for stdout
+ * @param[in]       bool bBinary                Write the binary format
+ *
+ * @return True if the trace was created, false otherwise.
+ */
+bool traceWriterOpen(traceWriter_t *writer, const char *fileName,
+                     bool bBinary) {
+    memset((void *)writer, 0, sizeof(*writer));
+    writer->bBinary = bBinary;
+    writer->pFile =
+        (strcmp(fileName, "-") == 0) ? stdout : fopen(fileName, "w");
+    if (writer->pFile == NULL)
+        return false;
+    if (bBinary &&
+        !traceWriteHeader(writer->pFile, TRACE_BINARY_COUNT_UNKNOWN)) {
+        traceWriterClose(writer);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write a trace to a stream owned by the caller.
+ *
+ * The stream is flushed but not closed by traceWriterClose, and a binary
+ * header keeps TRACE_BINARY_COUNT_UNKNOWN: streams such as open_memstream
+ * truncate to the position of the last write, so seeking back to patch the
+ * count would lose the records.
+ *
+ * @param[out]      traceWriter_t *writer       Writer state to initialise
+ * @param[in]       FILE *file                  Stream to write to
+ * @param[in]       bool bBinary                Write the binary format
+ *
+ * @return True if the header was written, false otherwise.
+ */
+bool traceWriterOpenStream(traceWriter_t *writer, FILE *file, bool bBinary) {
+    memset((void *)writer, 0, sizeof(*writer));
+    writer->bBinary = bBinary;
+    writer->bBorrowed = true;
+    writer->pFile = file;
+    if (bBinary && !traceWriteHeader(file, TRACE_BINARY_COUNT_UNKNOWN)) {
+        writer->pFile = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Append a record to the trace.
+ *
+ * @param[in,out]   traceWriter_t *writer       Open trace
+ * @param[in]       const traceRecord_t *record Record to append
+ *
+ * @return True if the record was written, false otherwise.
+ */
+bool traceWriterPut(traceWriter_t *writer, const traceRecord_t *record) {
+    unsigned char packed[1 + (2 * TRACE_VARINT_MAX_LEN)];
+    size_t length = 1;
+    unsigned long delta = record->address - writer->iPrevAddress;
+    unsigned long byteSize = (unsigned long)record->byteSize;
+    unsigned char tag = 0;
+
+    writer->iRecordCount++;
+    if (!writer->bBinary)
+        return fprintf(writer->pFile, "%c %lx,%d\n", record->accessType,
+                       record->address, record->byteSize) > 0;
+
+    /* Binary records only carry loads, stores and non-negative sizes */
+    if (((record->accessType != 'L') && (record->accessType != 'S')) ||
+        (record->byteSize < 0))
+        return false;
+
+    if (record->accessType == 'S')
+        tag |= TRACE_BINARY_OP_STORE;
+    if (record->address < writer->iPrevAddress) {
+        tag |= TRACE_BINARY_DELTA_NEGATIVE;
+        delta = writer->iPrevAddress - record->address;
+    }
+    tag |= (unsigned char)((byteSize < TRACE_BINARY_SIZE_ESCAPE
+                                ? byteSize
+                                : TRACE_BINARY_SIZE_ESCAPE)
+                           << TRACE_BINARY_SIZE_SHIFT);
+    packed[0] = tag;
+
+    length += traceEncodeVarint(&packed[length], delta);
+    if (byteSize >= TRACE_BINARY_SIZE_ESCAPE)
+        length += traceEncodeVarint(&packed[length], byteSize);
+
+    writer->iPrevAddress = record->address;
+    return fwrite(packed, length, 1, writer->pFile) == 1;
+}
+
+/**
+ * @brief Finish the trace.
+ *
+ * Binary traces written to a seekable file get their record count filled
+ * in; on pipes and caller streams it stays TRACE_BINARY_COUNT_UNKNOWN and
+ * readers stop at the end of the data instead.
+ *
+ * @param[in,out]   traceWriter_t *writer       Open trace
+ *
+ * @return True if everything was flushed successfully.
+ */
+bool traceWriterClose(traceWriter_t *writer) {
+    bool bSuccess = true;
+
+    if (writer->pFile == NULL)
+        return false;
+    if (writer->bBorrowed) {
+        bSuccess = (fflush(writer->pFile) == 0);
+        writer->pFile = NULL;
+        return bSuccess;
+    }
+    if (writer->bBinary && (fseek(writer->pFile, 0, SEEK_SET) == 0))
+        bSuccess = traceWriteHeader(writer->pFile, writer->iRecordCount);
+    if (writer->pFile == stdout)
+        bSuccess = (fflush(stdout) == 0) && bSuccess;
+    else
+        bSuccess = (fclose(writer->pFile) == 0) && bSuccess;
+    writer->pFile = NULL;
+    return bSuccess;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file csim-trace.h
+ * @brief Trace file reader used by the cache simulator
+ *
+ * Regular files are memory mapped and parsed in place; anything that cannot
+ * be mapped (pipes, standard input given as "-", character devices) is read
+ * by a background thread that runs the same parser over a read(2) buffer and
+ * hands records over in batches, so reading overlaps with simulation.
+ *
+ * Two on-disk formats are understood and told apart by the binary header:
+ *  - text, one "<op> <hex address>,<decimal size>" record per line
+ *  - packed binary, a TRACE_BINARY_HEADER_SIZE byte header followed by
+ *    variable length records (see csim-trace.c for the layout)
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef CSIM_TRACE_H
+#define CSIM_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** @brief Size of the buffer used when the trace cannot be memory mapped */
+#define TRACE_READ_BUFFER_SIZE (1 << 16)
+
+/** @brief Longest record guaranteed to parse in the buffered read path */
+#define TRACE_MAX_RECORD_LEN 256
+
+/** @brief Records handed over per batch by the background parser */
+#define TRACE_BATCH_RECORDS 4096
+
+/** @brief Magic bytes at the start of a binary trace */
+#define TRACE_BINARY_MAGIC "CSBT"
+
+/** @brief Version of the binary trace layout */
+#define TRACE_BINARY_VERSION 1
+
+/** @brief Size of the binary trace header in bytes */
+#define TRACE_BINARY_HEADER_SIZE 16
+
+/** @brief Record count stored when the writer could not seek back */
+#define TRACE_BINARY_COUNT_UNKNOWN UINT64_MAX
+
+/**
+ * @brief A single memory access parsed from a trace
+ */
+typedef struct {
+    char accessType;       /* 'L' for load, 'S' for store */
+    unsigned long address; /* Accessed memory address */
+    int byteSize;          /* Number of bytes accessed */
+} traceRecord_t;
+
+/* Background parser of an unmapped trace, private to csim-trace.c */
+typedef struct traceParserThread traceParserThread_t;
+
+/**
+ * @brief State of an open trace
+ */
+typedef struct {
+    int fd;                     /* Underlying file descriptor */
+    bool bMapped;               /* Trace is memory mapped rather than read */
+    bool bEndOfFile;            /* No more bytes will be read into the buffer */
+    bool bBinary;               /* Trace uses the packed binary format */
+    uint64_t iRecordsLeft;      /* Binary records still to be decoded */
+    unsigned long iPrevAddress; /* Binary delta decoding base */
+    char *pBuffer;              /* Mapped file or read buffer */
+    size_t iMappedLength;       /* Length of the mapping, 0 when not mapped */
+    const char *pCursor;        /* Next byte to parse */
+    const char *pEnd;           /* One past the last valid byte */
+    /* Background parser and the batch being consumed, NULL if none */
+    traceParserThread_t *pThread;
+    const traceRecord_t *pBatchCursor;
+    const traceRecord_t *pBatchEnd;
+} traceReader_t;
+
+/** @brief Open a trace file for reading, "-" reads standard input. */
+bool traceReaderOpen(traceReader_t *reader, const char *fileName);
+
+/** @brief Read a trace from a descriptor, which the reader then owns. */
+bool traceReaderOpenFd(traceReader_t *reader, int fd);
+
+/** @brief Read a trace held in memory, which must outlive the reader. */
+void traceReaderOpenMemory(traceReader_t *reader, const char *data,
+                           size_t length);
+
+/** @brief Parse the next record, returns false at end of trace. */
+bool traceReaderNext(traceReader_t *reader, traceRecord_t *record);
+
+/** @brief Release all resources held by an open trace. */
+void traceReaderClose(traceReader_t *reader);
+
+/**
+ * @brief Run of consecutive accesses to one block
+ */
+typedef struct {
+    traceRecord_t first;    /* First access, type resolved to 'L' or 'S' */
+    unsigned long iRepeats; /* Accesses to its block right after it */
+    bool bDirty;            /* One of those is a store */
+} traceRun_t;
+
+/**
+ * @brief Coalesces the records of an open trace into runs
+ */
+typedef struct {
+    traceReader_t *pReader;    /* Trace the records come from */
+    unsigned int iBlockBits;   /* Runs share a block of 2^iBlockBits bytes */
+    bool bSplitAccesses;       /* Accesses straddling blocks run alone, -S */
+    unsigned long iMaxRecords; /* Records a run holds at most, not 0 */
+    char accessType;           /* Type of the latest load or store */
+    bool bPending;             /* A record ending the last run is held */
+    traceRecord_t pending;     /* That record, type already resolved */
+} traceCoalescer_t;
+
+/** @brief Start coalescing records at the given block size. */
+void traceCoalescerInit(traceCoalescer_t *coalescer, traceReader_t *reader,
+                        unsigned int blockBits, bool bSplitAccesses);
+
+/** @brief Read the next run, returns false at end of trace. */
+bool traceCoalescerNext(traceCoalescer_t *coalescer, traceRun_t *run);
+
+/**
+ * @brief State of a trace being written
+ */
+typedef struct {
+    FILE *pFile;                /* Output stream */
+    bool bBinary;               /* Write the packed binary format */
+    bool bBorrowed;             /* Stream belongs to the caller */
+    uint64_t iRecordCount;      /* Records written so far */
+    unsigned long iPrevAddress; /* Binary delta encoding base */
+} traceWriter_t;
+
+/** @brief Create a trace file, "-" writes to standard output. */
+bool traceWriterOpen(traceWriter_t *writer, const char *fileName,
+                     bool bBinary);
+
+/** @brief Write a trace to a stream the caller opened and will close. */
+bool traceWriterOpenStream(traceWriter_t *writer, FILE *file, bool bBinary);
+
+/** @brief Append a record to the trace. */
+bool traceWriterPut(traceWriter_t *writer, const traceRecord_t *record);
+
+/** @brief Finish the trace, filling in the binary record count. */
+bool traceWriterClose(traceWriter_t *writer);
+
+#endif /* CSIM_TRACE_H */
@@ -11,81 +11,181 @@
  * Tracefile is read line by line and corresponding hits, misses, evictions,
  * number of dirty bytes in the cache and number of dirty evictions are tracked.
  *
+ * Several cache configurations can be given with -C, in which case every
+ * one of them is simulated during the same pass over the trace and a
+ * summary line is printed for each. The simulator engine itself lives in
+ * csim-cache.c.
+ *
+ * With -j the single configuration is simulated by several threads, each
+ * owning a disjoint subset of the sets (see csim-parallel.c).
+ *
+ * With -A the stack-distance engine of csim-stackdist.c is used instead, and
+ * every associativity from 1 to the given limit is reported for the -s/-b
+ * geometry from a single pass.
+ *
+ * -p selects the replacement policy of every simulated cache (see
+ * csim-policy.h); the default is LRU, which is what csim-ref simulates.
+ *
+ * -f attaches a hardware prefetcher (see csim-prefetch.h) to every cache,
+ * and adds a line of prefetch counters after each summary.
+ *
+ * Each access counts as touching the block of its first byte only, as in
+ * csim-ref. With -S an access that straddles block boundaries is simulated
+ * once per block it touches, by every engine.
+ *
+ * -L adds cache levels below the -s/-E/-b cache, which then becomes the L1
+ * of a hierarchy simulated by csim-hierarchy.c, and -I picks its inclusion
+ * policy. Without -s/-E/-b the L1 is the Haswell L1 of cachelab.h.
+ *
+ * -H instruments the first configuration with csim-heatmap.c and writes
+ * its per-set and per-region counters, misses split into compulsory,
+ * capacity and conflict, to a CSV or JSON file. -R names the regions,
+ * which are otherwise 4 KiB pages.
+ *
+ * -k simulates only 1 in 2^k of the sets of every configuration (see
+ * cacheSetSampling) and scales the counters up to ratio estimates, which
+ * spread the accesses csim counted over every set, printing the
+ * 95% confidence margin of each after its summary. The margins hold only
+ * if the sampled sets behave like the rest; a sampling_warning line says
+ * when the sampled sets saw too many or too few of the accesses for that.
+ *
+ * -w picks the write policy of every cache, write-back or write-through,
+ * write-allocate or not, and a write-combining buffer below it, and adds a
+ * line of write counters after each summary.
+ *
+ * -i writes the hits, misses, evictions and dirty bytes of every cache
+ * over each window of the given number of trace records to the CSV file
+ * given to -o, JSON Lines if it is named *.json, as the windows close (see
+ * csim-interval.h).
+ *
+ * -D writes the state of every cache to a snapshot (see csim-snapshot.h)
+ * at the end of the run, or after the first -N records of the trace, and
+ * -W loads one before the first record, so a run can carry on from where
+ * an earlier one stopped.
+ *
+ * Consecutive accesses to one block are coalesced into runs (see
+ * traceCoalescerNext) whose repeats are counted as hits without probing the
+ * caches. Runs are formed at the smallest block size simulated, and not
+ * with -v, -H, -f or -w, whose per-access output, attribution, prefetches
+ * or stores need every access simulated on its own.
+ *
  * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
  */
 
 /* Importing header files */
 #include "cachelab.h"
+#include "csim-heatmap.h"
+#include "csim-hierarchy.h"
+#include "csim-interval.h"
+#include "csim-parallel.h"
+#include "csim-policy.h"
+#include "csim-prefetch.h"
+#include "csim-snapshot.h"
+#include "csim-stackdist.h"
+#include "csim-trace.h"
+#include "csim.h"
 #include <getopt.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 /* Defines */
-#define NUM_ELEMENTS_IN_UNIT 5
-#define ADDRESS_BITS_LEN 64
-#define CACHE_INVALID_FLAG 0
-#define CACHE_VALID_FLAG 1
-#define EVICTION_RANK_VAL 1
-
-/* Cache line structure members */
-typedef struct {
-    unsigned long iTag;      /* Tag value */
-    unsigned int bDirtyFlag; /* Dirty Flag */
-    unsigned int bValidFlag; /* Valid Flag */
-    unsigned int iRank; /* Rank value that keeps track of recent access to this
-                           cache line */
-    unsigned int dirtyEvictionCount; /* Dirty eviction count */
-} cacheLine_t;
+/* Hits, misses and evictions of cacheSampleSet_t, then accesses */
+#define SAMPLE_COUNTERS 4
+#define SAMPLE_ACCESSES 3
 
 /* Function prototyping */
-void checkSimulatorCache(cacheLine_t *cacheAddr, unsigned int accFlag,
-                         unsigned long memAddr, csim_stats_t *stats);
-void cacheMissHandler(cacheLine_t *cacheAddr, unsigned long addrSVal,
-                      unsigned long addrTagVal, unsigned int memAccessType,
-                      csim_stats_t *stats);
-void cacheEvictionHandler(cacheLine_t *cacheAddr, unsigned long addrSVal,
-                          unsigned long addrTagVal, unsigned int memAccessType,
-                          csim_stats_t *stats);
-void cacheLineRankUpdate(cacheLine_t *cacheAddr, unsigned long addrSVal,
-                         unsigned int recentAccessIndex);
+bool isValidCacheConfig(long setBits, long linesPerSet, long blockBits);
+bool addCacheConfig(cacheConfig_t **configs, unsigned int *configCount,
+                    long setBits, long linesPerSet, long blockBits);
+bool parseCacheConfigList(const char *configList, cacheConfig_t **configs,
+                          unsigned int *configCount);
+void printConfigSummary(const cacheConfig_t *config,
+                        const csim_stats_t *stats);
+void printPrefetchSummary(const cache_t *cache);
+void printMissClassSummary(const heatmap_t *heatmap);
+void printSampleSummary(const cache_t *cache);
+void printWriteSummary(const cache_t *cache);
+void simulateTraceRuns(traceReader_t *inputTrace, cache_t *caches,
+                       unsigned int cacheCount, interval_t *interval,
+                       bool bSplitAccesses, unsigned int *pMemAccessType);
+bool simulateTraceRecords(traceReader_t *inputTrace, cache_t *caches,
+                          unsigned int cacheCount, heatmap_t *heatmap,
+                          interval_t *interval, bool bSplitAccesses,
+                          unsigned int *pMemAccessType,
+                          unsigned long recordLimit);
+int runAssociativitySweep(traceReader_t *inputTrace, unsigned int setBits,
+                          unsigned int maxLinesPerSet, unsigned int blockBits,
+                          bool bSplitAccesses);
+bool isValidHierarchy(const cacheConfig_t *levels, unsigned int levelCount,
+                      const cachePolicy_t *policy);
+int runHierarchy(traceReader_t *inputTrace, const cacheConfig_t *levels,
+                 unsigned int levelCount, unsigned int inclusion,
+                 const cachePolicy_t *policy, bool bSplitAccesses);
 void printHelpVerbose(void);
 
-/* Global variables */
-unsigned int iSetBitCount = 0;
-unsigned int iSetCount = 0;
-unsigned int iCacheLinesPerSet = 0;
-unsigned int iBlockBitCount = 0;
-unsigned int iBlocksPerLine = 0;
-unsigned int iRecentAccessRankValue = 0;
-bool bVerbose = false;
-
 int main(int argc, char **argv) {
-    /* Trace file pointer */
-    FILE *inputTraceFile = NULL;
-
-    /* Trace file specifics */
-    char memAccessType;
-    unsigned long memAddress;
-    int byteSize;
+    /* Trace file reader */
+    traceReader_t inputTrace;
+    bool bTraceOpened = false;
 
-    /* Simulator cache pointer and statistics*/
-    cacheLine_t *cacheImage = NULL;
+    /* Requested configurations and their simulated caches */
+    cacheConfig_t *cacheConfigs = NULL;
+    unsigned int cacheConfigCount = 0;
+    cacheConfig_t *levelConfigs = NULL;
+    unsigned int levelConfigCount = 0;
+    cache_t *cacheImages = NULL;
     csim_stats_t inputTraceStats;
-    memset((void *)&inputTraceStats, 0, sizeof(inputTraceStats));
 
     int options = 0;
     bool bHelpevoked = false;
+    bool bConfigError = false;
     unsigned int iMemAccessTypeFlag = 0;
-    unsigned int dirtyCacheLineCount = 0;
-    unsigned int dirtyEvictedCacheLineCount = 0;
-    int iSignedSetBitCount = -1;
-    int iSignedCacheLinesPerSet = -1;
-    int iSignedBlockBitCount = -1;
+    long iSignedSetBitCount = -1;
+    long iSignedCacheLinesPerSet = -1;
+    long iSignedBlockBitCount = -1;
+    long iSignedMaxLinesPerSet = -1;
+    long iSignedThreadCount = 1;
+    long iSignedSampleBits = 0;
+    unsigned int iCachesReady = 0;
+    const cachePolicy_t *pPolicy = &cacheLruPolicy;
+    bool bHierarchy = false;
+    bool bSplitAccesses = false;
+    const cachePrefetcher_t *pPrefetcher = NULL;
+    unsigned int iPrefetchDegree = 0;
+    unsigned int iInclusion = HIERARCHY_NINE;
+    const char *pHeatmapPath = NULL;
+    heatmapRegion_t heatmapRegions[HEATMAP_MAX_REGIONS];
+    unsigned int iHeatmapRegionCount = 0;
+    FILE *pHeatmapFile = NULL;
+    heatmap_t heatmap;
+    bool bHeatmap = false;
+    bool bHeatmapFailed = false;
+    bool bHeatmapWritten = true;
+    const char *pSnapshotPath = NULL;
+    const char *pWarmPath = NULL;
+    long iSignedCheckpointRecords = -1;
+    FILE *pSnapshotFile = NULL;
+    FILE *pWarmFile = NULL;
+    bool bSnapshot = false;
+    bool bWarmed = false;
+    bool bSnapshotWritten = true;
+    unsigned int iWritePolicy = 0;
+    unsigned int iWriteBufferSize = 0;
+    bool bWritePolicy = false;
+    long iSignedIntervalRecords = 0;
+    const char *pIntervalPath = NULL;
+    FILE *pIntervalFile = NULL;
+    interval_t interval;
+    bool bInterval = false;
+    bool bIntervalWritten = true;
 
     /* Trace file parsing */
-    while ((options = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    while ((options = getopt(argc, argv,
+                             "hvs:E:b:t:C:A:j:p:L:I:Sf:H:R:k:D:N:W:"
+                             "w:i:o:")) != -1) {
         switch (options) {
         case 'h':
             bHelpevoked = true;
@@ -97,21 +197,92 @@ int main(int argc, char **argv) {
             break;
         case 's':
             iSignedSetBitCount = atoi(optarg);
-            iSetBitCount = (unsigned int)iSignedSetBitCount;
-            iSetCount = 1 << iSetBitCount;
             break;
         case 'E':
             iSignedCacheLinesPerSet = atoi(optarg);
-            iCacheLinesPerSet = (unsigned int)iSignedCacheLinesPerSet;
-            iRecentAccessRankValue = iCacheLinesPerSet;
             break;
         case 'b':
             iSignedBlockBitCount = atoi(optarg);
-            iBlockBitCount = (unsigned int)iSignedBlockBitCount;
-            iBlocksPerLine = 1 << iBlockBitCount;
             break;
         case 't':
-            inputTraceFile = fopen(optarg, "r");
+            if (bTraceOpened)
+                traceReaderClose(&inputTrace);
+            bTraceOpened = traceReaderOpen(&inputTrace, optarg);
+            break;
+        case 'C':
+            if (!parseCacheConfigList(optarg, &cacheConfigs,
+                                      &cacheConfigCount))
+                bConfigError = true;
+            break;
+        case 'A':
+            iSignedMaxLinesPerSet = atoi(optarg);
+            break;
+        case 'j':
+            iSignedThreadCount = atoi(optarg);
+            break;
+        case 'p':
+            pPolicy = cachePolicyFind(optarg);
+            if (pPolicy == NULL) {
+                pPolicy = &cacheLruPolicy;
+                bConfigError = true;
+            }
+            break;
+        case 'S':
+            bSplitAccesses = true;
+            break;
+        case 'f':
+            pPrefetcher = cachePrefetcherFind(optarg, &iPrefetchDegree);
+            if (pPrefetcher == NULL)
+                bConfigError = true;
+            break;
+        case 'L':
+            bHierarchy = true;
+            if (!parseCacheConfigList(optarg, &levelConfigs,
+                                      &levelConfigCount))
+                bConfigError = true;
+            break;
+        case 'I':
+            bHierarchy = true;
+            if (!hierarchyInclusionFind(optarg, &iInclusion))
+                bConfigError = true;
+            break;
+        case 'H':
+            pHeatmapPath = optarg;
+            break;
+        case 'k':
+            iSignedSampleBits = atoi(optarg);
+            break;
+        case 'D':
+            pSnapshotPath = optarg;
+            break;
+        case 'N':
+            iSignedCheckpointRecords = atol(optarg);
+            if (iSignedCheckpointRecords < 0)
+                bConfigError = true;
+            break;
+        case 'W':
+            pWarmPath = optarg;
+            break;
+        case 'w':
+            if (!cacheWritePolicyFind(optarg, &iWritePolicy,
+                                      &iWriteBufferSize))
+                bConfigError = true;
+            break;
+        case 'i':
+            iSignedIntervalRecords = atol(optarg);
+            if (iSignedIntervalRecords <= 0)
+                bConfigError = true;
+            break;
+        case 'o':
+            pIntervalPath = optarg;
+            break;
+        case 'R':
+            if ((iHeatmapRegionCount == HEATMAP_MAX_REGIONS) ||
+                !heatmapRegionParse(optarg,
+                                    &heatmapRegions[iHeatmapRegionCount]))
+                bConfigError = true;
+            else
+                iHeatmapRegionCount++;
             break;
         default:
             printf("Invalid command flag, type -h for valid command flags "
@@ -119,258 +290,863 @@ int main(int argc, char **argv) {
             break;
         }
     }
+    /* A hierarchy has one L1, -s/-E/-b or the Haswell L1, above the -L
+       levels, and runs on its own */
+    if ((iHeatmapRegionCount != 0) && (pHeatmapPath == NULL))
+        bConfigError = true;
+    /* A checkpoint offset needs a snapshot to take there */
+    if ((iSignedCheckpointRecords != -1) && (pSnapshotPath == NULL))
+        bConfigError = true;
+    /* Windows are written to -o, which holds nothing else */
+    bInterval = (iSignedIntervalRecords != 0) || (pIntervalPath != NULL);
+    if (bInterval &&
+        ((iSignedIntervalRecords == 0) || (pIntervalPath == NULL)))
+        bConfigError = true;
+    bSnapshot = (pSnapshotPath != NULL) || (pWarmPath != NULL);
+    bWritePolicy = (iWritePolicy != 0) || (iWriteBufferSize != 0);
+    if (bHierarchy) {
+        int status = 1;
+        bool bCustomL1 = (iSignedSetBitCount != -1) ||
+                         (iSignedCacheLinesPerSet != -1) ||
+                         (iSignedBlockBitCount != -1);
+        cacheConfig_t *levels = realloc(
+            levelConfigs, (levelConfigCount + 1) * sizeof(cacheConfig_t));
+        if (levels != NULL) {
+            levelConfigs = levels;
+            memmove(&levels[1], &levels[0],
+                    levelConfigCount * sizeof(cacheConfig_t));
+            levelConfigCount++;
+            levels[0].iSetBitCount = HASWELL_L1_SET;
+            levels[0].iCacheLinesPerSet = HASWELL_L1_ASSOC;
+            levels[0].iBlockBitCount = HASWELL_L1_BLOCK;
+        }
+        if (bCustomL1 && (levels != NULL)) {
+            if (isValidCacheConfig(iSignedSetBitCount,
+                                   iSignedCacheLinesPerSet,
+                                   iSignedBlockBitCount)) {
+                levels[0].iSetBitCount = (unsigned int)iSignedSetBitCount;
+                levels[0].iCacheLinesPerSet =
+                    (unsigned int)iSignedCacheLinesPerSet;
+                levels[0].iBlockBitCount = (unsigned int)iSignedBlockBitCount;
+            } else {
+                bConfigError = true;
+            }
+        }
+        if ((levels == NULL) || bConfigError || bVerbose ||
+            (cacheConfigCount != 0) || (iSignedMaxLinesPerSet != -1) ||
+            (pPrefetcher != NULL) || (pHeatmapPath != NULL) ||
+            (iSignedThreadCount != 1) || (iSignedSampleBits != 0) ||
+            bSnapshot || bWritePolicy || bInterval ||
+            !isValidHierarchy(levels, levelConfigCount, pPolicy) ||
+            !bTraceOpened) {
+            if (!bHelpevoked)
+                printf("Invalid cache parameters encountered!\nProgram "
+                       "Terminating...\n");
+        } else {
+            status = runHierarchy(&inputTrace, levels, levelConfigCount,
+                                  iInclusion, pPolicy, bSplitAccesses);
+        }
+        free(levelConfigs);
+        free(cacheConfigs);
+        if (bTraceOpened)
+            traceReaderClose(&inputTrace);
+        return status;
+    }
+    /* Associativity sweeps take their geometry from -s and -b alone, and
+       the stack-distance engine only models LRU */
+    if (iSignedMaxLinesPerSet != -1) {
+        int status = 1;
+        if (bConfigError || (pPolicy != &cacheLruPolicy) ||
+            (pPrefetcher != NULL) || (pHeatmapPath != NULL) ||
+            (iSignedCacheLinesPerSet != -1) || (cacheConfigCount != 0) ||
+            (iSignedSampleBits != 0) || bSnapshot || bWritePolicy ||
+            bInterval ||
+            !isValidCacheConfig(iSignedSetBitCount, iSignedMaxLinesPerSet,
+                                iSignedBlockBitCount) ||
+            !bTraceOpened) {
+            if (!bHelpevoked)
+                printf("Invalid cache parameters encountered!\nProgram "
+                       "Terminating...\n");
+        } else {
+            status = runAssociativitySweep(
+                &inputTrace, (unsigned int)iSignedSetBitCount,
+                (unsigned int)iSignedMaxLinesPerSet,
+                (unsigned int)iSignedBlockBitCount, bSplitAccesses);
+        }
+        free(cacheConfigs);
+        if (bTraceOpened)
+            traceReaderClose(&inputTrace);
+        return status;
+    }
+    /* A -s/-E/-b configuration, if given, is simulated first */
+    if ((iSignedSetBitCount != -1) || (iSignedCacheLinesPerSet != -1) ||
+        (iSignedBlockBitCount != -1) || (cacheConfigCount == 0)) {
+        if (addCacheConfig(&cacheConfigs, &cacheConfigCount,
+                           iSignedSetBitCount, iSignedCacheLinesPerSet,
+                           iSignedBlockBitCount)) {
+            cacheConfig_t singleConfig = cacheConfigs[cacheConfigCount - 1];
+            memmove(&cacheConfigs[1], &cacheConfigs[0],
+                    (cacheConfigCount - 1) * sizeof(cacheConfig_t));
+            cacheConfigs[0] = singleConfig;
+        } else {
+            bConfigError = true;
+        }
+    }
+    /* Every configuration must be supported by the replacement policy */
+    for (unsigned int i = 0; i < cacheConfigCount; i++) {
+        if (!pPolicy->isSupported(cacheConfigs[i].iCacheLinesPerSet))
+            bConfigError = true;
+    }
+    /* Threads split the sets of one cache and cannot interleave -v output,
+       and a prefetcher fetches into sets other threads own */
+    if ((iSignedThreadCount < 1) ||
+        ((iSignedThreadCount > 1) &&
+         ((cacheConfigCount != 1) || bVerbose || (pPrefetcher != NULL) ||
+          (pHeatmapPath != NULL))))
+        bConfigError = true;
+    /* Prefetches evict lines outside the access the heatmap attributes */
+    if ((pHeatmapPath != NULL) && (pPrefetcher != NULL))
+        bConfigError = true;
+    /* Sampling leaves every configuration at least two sets to estimate
+       the error from, and drops the accesses -v, -j, -f and -H need */
+    if ((iSignedSampleBits < 0) ||
+        ((iSignedSampleBits > 0) &&
+         (bVerbose || (iSignedThreadCount > 1) || (pPrefetcher != NULL) ||
+          (pHeatmapPath != NULL))))
+        bConfigError = true;
+    /* Write policies need every store simulated: threads, prefetches and
+       sampling lose some and the heatmap does not classify bypasses */
+    if (bWritePolicy &&
+        ((iSignedThreadCount > 1) || (pPrefetcher != NULL) ||
+         (pHeatmapPath != NULL) || (iSignedSampleBits != 0)))
+        bConfigError = true;
+    /* Snapshots hold the caches alone, not the state of threads or of the
+       heatmap's shadow cache */
+    if (bSnapshot && ((iSignedThreadCount > 1) || (pHeatmapPath != NULL)))
+        bConfigError = true;
+    /* Threads run through the trace out of step with each other */
+    if (bInterval && (iSignedThreadCount > 1))
+        bConfigError = true;
+    for (unsigned int i = 0; i < cacheConfigCount; i++) {
+        if ((iSignedSampleBits > 0) &&
+            (iSignedSampleBits >= (long)cacheConfigs[i].iSetBitCount))
+            bConfigError = true;
+    }
     /* General error checks */
-    if ((iSetBitCount < 0) || (iSignedCacheLinesPerSet < 1) ||
-        (inputTraceFile == NULL) || (iBlockBitCount < 0) ||
-        (iSignedSetBitCount < 0) || (iSignedBlockBitCount < 0)) {
+    if (bConfigError || (cacheConfigCount == 0) || (!bTraceOpened)) {
         if (!bHelpevoked)
             printf("Invalid cache parameters encountered!\nProgram "
                    "Terminating...\n");
+        free(cacheConfigs);
+        if (bTraceOpened)
+            traceReaderClose(&inputTrace);
         return 1; /* Invalid condition evoked */
     }
-    /* Check cache for an input line of the trace file */
-    /* Initialise simulator cache by allocating memory in heap */
-    cacheImage = calloc((iSetCount * iCacheLinesPerSet), sizeof(cacheLine_t));
-    if (cacheImage != NULL) {
-        while (fscanf(inputTraceFile, "%c %lx,%d\n", &memAccessType,
-                      &memAddress, &byteSize) > 0) {
-            if (memAccessType == 'L') /* Load memory address */
-            {
-                iMemAccessTypeFlag = 0;
-            } else if (memAccessType == 'S') /* Store memory address */
-            {
-                iMemAccessTypeFlag = 1;
+    /* Initialise simulator caches by allocating memory in heap */
+    cacheImages = calloc(cacheConfigCount, sizeof(cache_t));
+    if (cacheImages != NULL) {
+        while ((iCachesReady < cacheConfigCount) &&
+               cacheInit(&cacheImages[iCachesReady],
+                         cacheConfigs[iCachesReady].iSetBitCount,
+                         cacheConfigs[iCachesReady].iCacheLinesPerSet,
+                         cacheConfigs[iCachesReady].iBlockBitCount,
+                         pPolicy)) {
+            if (!cacheSetSampling(&cacheImages[iCachesReady],
+                                  (unsigned int)iSignedSampleBits) ||
+                !cacheSetWritePolicy(&cacheImages[iCachesReady], iWritePolicy,
+                                     iWriteBufferSize) ||
+                ((pPrefetcher != NULL) &&
+                 !cacheSetPrefetcher(&cacheImages[iCachesReady], pPrefetcher,
+                                     iPrefetchDegree))) {
+                cacheFree(&cacheImages[iCachesReady]);
+                break;
             }
-            if (bVerbose)
-                printf("%c %lx,%d", memAccessType, memAddress, byteSize);
-            /* Checking simulator cache for memory hits and misses */
-            checkSimulatorCache(cacheImage, iMemAccessTypeFlag, memAddress,
-                                &inputTraceStats);
-            if (bVerbose)
-                printf("\n");
+            iCachesReady++;
         }
-    } else /* return if calloc retuned a NULL, unable to allocate space for
-                  simulator cache */
-    {
+    }
+    /* return if calloc retuned a NULL, unable to allocate space for
+       simulator cache */
+    if (iCachesReady < cacheConfigCount) {
         printf("Heap allocation for cache simulator failed!\n");
+        for (unsigned int i = 0; i < iCachesReady; i++)
+            cacheFree(&cacheImages[i]);
+        free(cacheImages);
+        free(cacheConfigs);
+        traceReaderClose(&inputTrace);
+        return 1;
+    }
+    /* Instrument the first configuration, opening the output up front so
+       a bad path fails before the simulation rather than after */
+    if (pHeatmapPath != NULL) {
+        bHeatmap = heatmapInit(&heatmap, &cacheImages[0]);
+        for (unsigned int i = 0; bHeatmap && (i < iHeatmapRegionCount); i++)
+            heatmapAddRegion(&heatmap, &heatmapRegions[i]);
+        if (bHeatmap)
+            pHeatmapFile = fopen(pHeatmapPath, "w");
+        if (pHeatmapFile == NULL) {
+            if (bHeatmap) {
+                printf("Unable to open heatmap file %s!\n", pHeatmapPath);
+                heatmapFree(&heatmap);
+            } else {
+                printf("Heap allocation for cache simulator failed!\n");
+            }
+            for (unsigned int i = 0; i < cacheConfigCount; i++)
+                cacheFree(&cacheImages[i]);
+            free(cacheImages);
+            free(cacheConfigs);
+            traceReaderClose(&inputTrace);
+            return 1;
+        }
+    }
+    /* Warm the caches up from a snapshot, and create the one to take before
+       simulating so a bad path fails first */
+    if (pWarmPath != NULL) {
+        pWarmFile = fopen(pWarmPath, "rb");
+        bWarmed = (pWarmFile != NULL) &&
+                  snapshotRead(pWarmFile, cacheImages, cacheConfigCount,
+                               &iMemAccessTypeFlag);
+        if (pWarmFile != NULL)
+            fclose(pWarmFile);
+    }
+    if (pSnapshotPath != NULL)
+        pSnapshotFile = fopen(pSnapshotPath, "wb");
+    if (((pWarmPath != NULL) && !bWarmed) ||
+        ((pSnapshotPath != NULL) && (pSnapshotFile == NULL))) {
+        if ((pWarmPath != NULL) && !bWarmed)
+            printf("Unable to load snapshot file %s for these caches!\n",
+                   pWarmPath);
+        else
+            printf("Unable to open snapshot file %s!\n", pSnapshotPath);
+        if (pSnapshotFile != NULL)
+            fclose(pSnapshotFile);
+        for (unsigned int i = 0; i < cacheConfigCount; i++)
+            cacheFree(&cacheImages[i]);
+        free(cacheImages);
+        free(cacheConfigs);
+        traceReaderClose(&inputTrace);
         return 1;
     }
-    for (unsigned int i = 0; i < iSetCount; i++) {
-        for (unsigned int j = 0; j < iCacheLinesPerSet; j++) {
-            /* compute number of dirty cache lines */
-            if (cacheImage[(i * iCacheLinesPerSet) + j].bDirtyFlag == 1) {
-                dirtyCacheLineCount++;
+    /* Open the first window once the caches are warm, so it counts from
+       the snapshot's counters */
+    if (bInterval) {
+        pIntervalFile = (strcmp(pIntervalPath, "-") == 0)
+                            ? stdout
+                            : fopen(pIntervalPath, "w");
+        if ((pIntervalFile == NULL) ||
+            !intervalInit(&interval, pIntervalFile,
+                          (heatmapFormatFind(pIntervalPath) ==
+                           HEATMAP_FORMAT_JSON)
+                              ? INTERVAL_FORMAT_JSON
+                              : INTERVAL_FORMAT_CSV,
+                          cacheImages, cacheConfigCount,
+                          (unsigned long)iSignedIntervalRecords)) {
+            if (pIntervalFile == NULL)
+                printf("Unable to open interval file %s!\n", pIntervalPath);
+            else
+                printf("Heap allocation for cache simulator failed!\n");
+            if ((pIntervalFile != NULL) && (pIntervalFile != stdout))
+                fclose(pIntervalFile);
+            if (pSnapshotFile != NULL)
+                fclose(pSnapshotFile);
+            if (bHeatmap) {
+                heatmapFree(&heatmap);
+                fclose(pHeatmapFile);
             }
-            /* compute number of dirty eviction from the cache */
-            dirtyEvictedCacheLineCount +=
-                cacheImage[(i * iCacheLinesPerSet) + j].dirtyEvictionCount;
+            for (unsigned int i = 0; i < cacheConfigCount; i++)
+                cacheFree(&cacheImages[i]);
+            free(cacheImages);
+            free(cacheConfigs);
+            traceReaderClose(&inputTrace);
+            return 1;
         }
     }
-    /* Update dirty bytes in the cache and dirty cache evictions */
-    inputTraceStats.dirty_bytes = dirtyCacheLineCount * iBlocksPerLine;
-    inputTraceStats.dirty_evictions =
-        dirtyEvictedCacheLineCount * iBlocksPerLine;
+    /* Hand the trace to the worker threads when running in parallel */
+    if ((iSignedThreadCount > 1) &&
+        !parallelSimulate(&inputTrace, &cacheImages[0],
+                          (unsigned int)iSignedThreadCount, bSplitAccesses)) {
+        printf("Unable to start simulator threads!\n");
+        cacheFree(&cacheImages[0]);
+        free(cacheImages);
+        free(cacheConfigs);
+        traceReaderClose(&inputTrace);
+        return 1;
+    }
+    /* Simulate the records before a checkpoint and dump the caches there */
+    if (iSignedCheckpointRecords != -1) {
+        (void)simulateTraceRecords(&inputTrace, cacheImages, cacheConfigCount,
+                                   NULL, bInterval ? &interval : NULL,
+                                   bSplitAccesses, &iMemAccessTypeFlag,
+                                   (unsigned long)iSignedCheckpointRecords);
+        bSnapshotWritten = snapshotWrite(pSnapshotFile, cacheImages,
+                                         cacheConfigCount, iMemAccessTypeFlag);
+    }
+    /* Check caches for each run of accesses to a block when that is exact,
+       otherwise for each input line of the trace file */
+    if (!bVerbose && !bHeatmap && (pPrefetcher == NULL) && !bWritePolicy)
+        simulateTraceRuns(&inputTrace, cacheImages, cacheConfigCount,
+                          bInterval ? &interval : NULL, bSplitAccesses,
+                          &iMemAccessTypeFlag);
+    bHeatmapFailed = !simulateTraceRecords(
+        &inputTrace, cacheImages, cacheConfigCount, bHeatmap ? &heatmap : NULL,
+        bInterval ? &interval : NULL, bSplitAccesses, &iMemAccessTypeFlag,
+        ULONG_MAX);
+    traceReaderClose(&inputTrace);
+    if (bInterval) {
+        bIntervalWritten = intervalFinish(&interval);
+        intervalFree(&interval);
+        if (((pIntervalFile != stdout) && (fclose(pIntervalFile) != 0)) ||
+            !bIntervalWritten) {
+            printf("Unable to write interval file %s!\n", pIntervalPath);
+            bIntervalWritten = false;
+        }
+    }
+    if (bHeatmapFailed) {
+        printf("Heap allocation for cache simulator failed!\n");
+        heatmapFree(&heatmap);
+        fclose(pHeatmapFile);
+        for (unsigned int i = 0; i < cacheConfigCount; i++)
+            cacheFree(&cacheImages[i]);
+        free(cacheImages);
+        free(cacheConfigs);
+        return 1;
+    }
 
-    /* free allocated cache space and closing trace file */
-    free(cacheImage);
-    fclose(inputTraceFile);
     /* submitting final summary for the trace file */
-    printSummary(&inputTraceStats);
-    return 0;
+    for (unsigned int i = 0; i < cacheConfigCount; i++) {
+        cacheSummary(&cacheImages[i], &inputTraceStats);
+        if (cacheConfigCount == 1)
+            printSummary(&inputTraceStats);
+        else
+            printConfigSummary(&cacheConfigs[i], &inputTraceStats);
+        if (pPrefetcher != NULL)
+            printPrefetchSummary(&cacheImages[i]);
+        if (iSignedSampleBits != 0)
+            printSampleSummary(&cacheImages[i]);
+        if (bWritePolicy)
+            printWriteSummary(&cacheImages[i]);
+        if (bHeatmap && (i == 0))
+            printMissClassSummary(&heatmap);
+    }
+    if (pSnapshotFile != NULL) {
+        if (iSignedCheckpointRecords == -1)
+            bSnapshotWritten = snapshotWrite(pSnapshotFile, cacheImages,
+                                             cacheConfigCount,
+                                             iMemAccessTypeFlag);
+        if ((fclose(pSnapshotFile) != 0) || !bSnapshotWritten) {
+            printf("Unable to write snapshot file %s!\n", pSnapshotPath);
+            bSnapshotWritten = false;
+        }
+    }
+    if (bHeatmap) {
+        /* Written before the caches go, heatmapWrite reads the geometry */
+        bHeatmapWritten = heatmapWrite(&heatmap, pHeatmapFile,
+                                       heatmapFormatFind(pHeatmapPath));
+        if ((fclose(pHeatmapFile) != 0) || !bHeatmapWritten) {
+            printf("Unable to write heatmap file %s!\n", pHeatmapPath);
+            bHeatmapWritten = false;
+        }
+        heatmapFree(&heatmap);
+    }
+    for (unsigned int i = 0; i < cacheConfigCount; i++)
+        cacheFree(&cacheImages[i]);
+    free(cacheImages);
+    free(cacheConfigs);
+    return (bHeatmapWritten && bSnapshotWritten && bIntervalWritten) ? 0 : 1;
 }
 
 /**
- * @brief Checks simulator cache of hits, misses and evictions.
+ * @brief Checks that a cache geometry can be simulated.
  *
+ * @param[in]       long setBits            Number of set index bits
+ * @param[in]       long linesPerSet        Number of lines per set
+ * @param[in]       long blockBits          Number of block bits
  *
- * @param[in]       cacheLine_t *cacheAddr          Pointer to the cache
- * simulator
- * @param[in]       unsigned int memAccessType      Type of memory access
- * requested
- * @param[in]       unsigned long memAddr           Memory address to be
- * accessed
- * @param[in,out]   csim_stats_t *stats             Cache statistics
+ * @return True if the geometry is valid.
+ */
+bool isValidCacheConfig(long setBits, long linesPerSet, long blockBits) {
+    return (setBits >= 0) && (linesPerSet >= 1) && (blockBits >= 0) &&
+           (linesPerSet <= (long)UINT_MAX) &&
+           ((setBits + blockBits) < ADDRESS_BITS_LEN);
+}
+
+/**
+ * @brief Appends a cache geometry to the list of configurations.
  *
- * @return void.
+ * @param[in,out]   cacheConfig_t **configs         Configuration list
+ * @param[in,out]   unsigned int *configCount       Number of configurations
+ * @param[in]       long setBits                    Number of set index bits
+ * @param[in]       long linesPerSet                Number of lines per set
+ * @param[in]       long blockBits                  Number of block bits
+ *
+ * @return False if the geometry is invalid or the list could not grow.
  */
-void checkSimulatorCache(cacheLine_t *cacheAddr, unsigned int memAccessType,
-                         unsigned long memAddr, csim_stats_t *stats) {
+bool addCacheConfig(cacheConfig_t **configs, unsigned int *configCount,
+                    long setBits, long linesPerSet, long blockBits) {
+    cacheConfig_t *grown;
 
-    /* Local variables */
-    unsigned long addrSVal = 0;
-    unsigned long addrTagVal = 0;
-    unsigned long setMask = 0;
-    unsigned long tagMask = 0;
-    bool hitFlag = false;
+    if (!isValidCacheConfig(setBits, linesPerSet, blockBits))
+        return false;
+    grown = realloc(*configs, (*configCount + 1) * sizeof(cacheConfig_t));
+    if (grown == NULL)
+        return false;
+    grown[*configCount].iSetBitCount = (unsigned int)setBits;
+    grown[*configCount].iCacheLinesPerSet = (unsigned int)linesPerSet;
+    grown[*configCount].iBlockBitCount = (unsigned int)blockBits;
+    *configs = grown;
+    (*configCount)++;
+    return true;
+}
 
-    /* Compute cache set to access */
-    for (unsigned int i = 0; i < iSetBitCount; i++) {
-        setMask = (setMask << 1) + 1;
-    }
-    addrSVal = (memAddr >> iBlockBitCount) & setMask;
+/**
+ * @brief Parses a "s:E:b[,s:E:b...]" list of cache configurations.
+ *
+ * @param[in]       const char *configList          List given to -C
+ * @param[in,out]   cacheConfig_t **configs         Configuration list
+ * @param[in,out]   unsigned int *configCount       Number of configurations
+ *
+ * @return False if any entry of the list is malformed.
+ */
+bool parseCacheConfigList(const char *configList, cacheConfig_t **configs,
+                          unsigned int *configCount) {
+    const char *p = configList;
+    char *end;
 
-    /* Compute Tag corresponding to the memory address */
-    for (unsigned int i = 0;
-         i < (ADDRESS_BITS_LEN - (iSetBitCount + iBlockBitCount)); i++) {
-        tagMask = (tagMask << 1) + 1;
+    while (*p != '\0') {
+        long geometry[3];
+        for (unsigned int i = 0; i < 3; i++) {
+            geometry[i] = strtol(p, &end, 10);
+            if ((end == p) || ((i < 2) && (*end != ':')))
+                return false;
+            p = (i < 2) ? end + 1 : end;
+        }
+        if (!addCacheConfig(configs, configCount, geometry[0], geometry[1],
+                            geometry[2]))
+            return false;
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return false;
     }
-    addrTagVal = (memAddr >> (iBlockBitCount + iSetBitCount)) & tagMask;
+    return true;
+}
 
-    /* Cache handler section */
-    for (unsigned int j = 0; j < iCacheLinesPerSet; j++) {
-        /* Check if address tag matches with cache line tag and update rank for
-         the cache line, if not call the miss routine */
-        if ((cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iTag ==
-             addrTagVal) &&
-            (cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bValidFlag !=
-             CACHE_INVALID_FLAG)) {
-            stats->hits++;
-            hitFlag = true;
-            /* Updating cache line rank upon access*/
-            if (cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iRank !=
-                iRecentAccessRankValue) {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iRank =
-                    iRecentAccessRankValue;
-                cacheLineRankUpdate(cacheAddr, addrSVal, j);
-            }
-            /* Updating dirty memory access */
-            if (memAccessType == 1) {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bDirtyFlag = 1;
-            }
-            if (bVerbose) {
-                printf("\thit");
-            }
-            break;
+/**
+ * @brief Prints the summary of one configuration in a multi-config run.
+ *
+ * @param[in]       const cacheConfig_t *config     Simulated configuration
+ * @param[in]       const csim_stats_t *stats       Its statistics
+ *
+ * @return void.
+ */
+void printConfigSummary(const cacheConfig_t *config,
+                        const csim_stats_t *stats) {
+    printf("s:%u E:%u b:%u hits:%ld misses:%ld evictions:%ld "
+           "dirty_bytes_in_cache:%ld dirty_bytes_evicted:%ld\n",
+           config->iSetBitCount, config->iCacheLinesPerSet,
+           config->iBlockBitCount, stats->hits, stats->misses,
+           stats->evictions, stats->dirty_bytes, stats->dirty_evictions);
+}
+
+/**
+ * @brief Prints the prefetch counters of a cache.
+ *
+ * Useless prefetches are the prefetched lines never hit, whether evicted or
+ * still in the cache. Coverage is the share of the misses the cache would
+ * otherwise have taken that prefetching turned into hits.
+ *
+ * @param[in]       const cache_t *cache            Simulated cache
+ *
+ * @return void.
+ */
+void printPrefetchSummary(const cache_t *cache) {
+    unsigned long wouldMiss = cache->stats.misses + cache->prefetch.iUseful;
+    double coverage = 0;
+
+    if (wouldMiss != 0)
+        coverage = 100.0 * (double)cache->prefetch.iUseful / (double)wouldMiss;
+    printf("prefetches:%lu useful:%lu useless:%lu coverage:%.2f%%\n",
+           cache->prefetch.iIssued, cache->prefetch.iUseful,
+           cache->prefetch.iIssued - cache->prefetch.iUseful, coverage);
+}
+
+/**
+ * @brief Prints the write counters of a cache with a write policy.
+ *
+ * Memory writes are the block writes that reached memory, blocks still in
+ * the write-combining buffer excluded. Dirty lines written back on eviction
+ * are counted in the summary's dirty_bytes_evicted.
+ *
+ * @param[in]       const cache_t *cache            Simulated cache
+ *
+ * @return void.
+ */
+void printWriteSummary(const cache_t *cache) {
+    printf("writes:%lu combined:%lu memory_writes:%lu buffered:%u\n",
+           cache->write.iWrites, cache->write.iCombined,
+           cache->write.iTransactions, cache->iWriteBufferCount);
+}
+
+/**
+ * @brief Prints the sampling rate and error margins of a sampled cache.
+ *
+ * The sampled sets are treated as a simple random sample of the cache's
+ * sets, and each estimate of cacheSampleEstimate as a ratio estimate: the
+ * counter per access of the sampled sets, times the accesses to every set.
+ * Its variance is that of a sample mean drawn without replacement, taken
+ * of each set's count less the ratio times its accesses, so sets that see
+ * more accesses than others widen the margin only if they also hit or miss
+ * at another rate. The margin is 1.96 standard deviations, the 95%
+ * interval of the normal approximation.
+ *
+ * That interval only holds if the sampled sets hit and miss as the others
+ * do. A trace whose accesses pile up in a few sets, a stack or one hot
+ * array, is estimated from whether those sets happen to be sampled, and a
+ * warning is printed when the sampled sets saw more or fewer accesses than
+ * 1 in 2^iSampleBits of them, by more than the margin of a plain per-set
+ * estimate would allow.
+ *
+ * @param[in]       const cache_t *cache            Sampled cache, with at
+ * least two sampled sets
+ *
+ * @return void.
+ */
+void printSampleSummary(const cache_t *cache) {
+    double sampled = (double)cache->iSetCount;
+    double population = ldexp(sampled, (int)cache->iSampleBits);
+    double sum[SAMPLE_COUNTERS] = {0};
+    double sumSquares[SAMPLE_COUNTERS] = {0};
+    double sumProducts[SAMPLE_COUNTERS] = {0};
+    unsigned long margin[SAMPLE_COUNTERS];
+
+    for (unsigned int i = 0; i < cache->iSetCount; i++) {
+        const cacheSampleSet_t *set = &cache->pSampleSets[i];
+        double counts[SAMPLE_COUNTERS] = {
+            (double)set->iHits, (double)set->iMisses, (double)set->iEvictions,
+            (double)set->iHits + (double)set->iMisses};
+        for (unsigned int c = 0; c < SAMPLE_COUNTERS; c++) {
+            sum[c] += counts[c];
+            sumSquares[c] += counts[c] * counts[c];
+            sumProducts[c] += counts[c] * counts[SAMPLE_ACCESSES];
         }
     }
-    if (!hitFlag)
-        cacheMissHandler(cacheAddr, addrSVal, addrTagVal, memAccessType, stats);
+    for (unsigned int c = 0; c < SAMPLE_COUNTERS; c++) {
+        /* Sample variance of the per-set residuals of the ratio estimate,
+           and for the accesses themselves, of the per-set counts */
+        double ratio = (c == SAMPLE_ACCESSES || sum[SAMPLE_ACCESSES] == 0)
+                           ? 0
+                           : sum[c] / sum[SAMPLE_ACCESSES];
+        double variance =
+            (sumSquares[c] - 2 * ratio * sumProducts[c] +
+             ratio * ratio * sumSquares[SAMPLE_ACCESSES] -
+             (sum[c] - ratio * sum[SAMPLE_ACCESSES]) *
+                 (sum[c] - ratio * sum[SAMPLE_ACCESSES]) / sampled) /
+            (sampled - 1);
+        if (variance < 0)
+            variance = 0;
+        margin[c] = (unsigned long)ceil(
+            1.96 * population *
+            sqrt((1 - sampled / population) * variance / sampled));
+    }
+    printf("sampled_sets:%u/%u hits:+-%lu misses:+-%lu evictions:+-%lu "
+           "(95%% confidence)\n",
+           cache->iSetCount, cache->iSetCount << cache->iSampleBits,
+           margin[0], margin[1], margin[2]);
+    if (fabs(population * sum[SAMPLE_ACCESSES] / sampled -
+             (double)cache->iSampleAccesses) > (double)margin[SAMPLE_ACCESSES])
+        printf("sampling_warning: sampled sets saw %.0f of %lu accesses, not "
+               "about 1 in %u, so the sets differ and the margins do not "
+               "hold\n",
+               sum[SAMPLE_ACCESSES], cache->iSampleAccesses,
+               1U << cache->iSampleBits);
 }
 
 /**
- * @brief Cache misses are handled in this function.
- *
+ * @brief Prints the miss classes of the instrumented cache.
  *
- * @param[in]       cacheLine_t *cacheAddr          Pointer to the cache
- * simulator
- * @param[in]       unsigned long addrSVal          Cache set to be accessed
- * @param[in]       unsigned long addrTagVal        Tag value of the memory
- * address to be accessed
- * @param[in]       unsigned int memAccessType      Memory access type
- * @param[in,out]   csim_stats_t *stats             Cache statistics
+ * @param[in]       const heatmap_t *heatmap        Heatmap of the cache
  *
  * @return void.
  */
-void cacheMissHandler(cacheLine_t *cacheAddr, unsigned long addrSVal,
-                      unsigned long addrTagVal, unsigned int memAccessType,
-                      csim_stats_t *stats) {
-    /* local variable */
-    bool evictFlag = false;
+void printMissClassSummary(const heatmap_t *heatmap) {
+    printf("compulsory:%lu capacity:%lu conflict:%lu\n",
+           heatmap->total.iMisses[HEATMAP_COMPULSORY],
+           heatmap->total.iMisses[HEATMAP_CAPACITY],
+           heatmap->total.iMisses[HEATMAP_CONFLICT]);
+}
 
-    /* Cache miss handler */
-    stats->misses++;
-    if (bVerbose)
-        printf("\tmiss");
+/**
+ * @brief Reports every associativity up to a limit from one trace pass.
+ *
+ * Uses the stack-distance engine, which is exact for LRU, and prints one
+ * summary line per associativity.
+ *
+ * @param[in,out]   traceReader_t *inputTrace       Open trace
+ * @param[in]       unsigned int setBits            Number of set index bits
+ * @param[in]       unsigned int maxLinesPerSet     Largest E to report
+ * @param[in]       unsigned int blockBits          Number of block bits
+ * @param[in]       bool bSplitAccesses             Split accesses that
+ * straddle blocks
+ *
+ * @return Exit status for main.
+ */
+int runAssociativitySweep(traceReader_t *inputTrace, unsigned int setBits,
+                          unsigned int maxLinesPerSet, unsigned int blockBits,
+                          bool bSplitAccesses) {
+    stackDist_t stackDist;
+    traceRecord_t traceRecord;
+    csim_stats_t stats;
+    unsigned int iMemAccessTypeFlag = 0;
 
-    for (unsigned int j = 0; j < iCacheLinesPerSet; j++) {
-        /* Check if cache lines are empty and update the tag and rank for the
-         cache line, if not call the eviction routine */
-        if (cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bValidFlag ==
-            CACHE_INVALID_FLAG) {
-            cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bValidFlag =
-                CACHE_VALID_FLAG;
-            cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iTag = addrTagVal;
-            cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iRank =
-                iRecentAccessRankValue;
-            /* Updating dirty memory access */
-            if (memAccessType == 1) {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bDirtyFlag = 1;
-            } else {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bDirtyFlag = 0;
-            }
-            /* Updating cache line rank upon access*/
-            cacheLineRankUpdate(cacheAddr, addrSVal, j);
-            evictFlag = false;
-            break;
-        } else {
-            evictFlag = true;
+    if (!stackDistInit(&stackDist, setBits, maxLinesPerSet, blockBits)) {
+        printf("Heap allocation for cache simulator failed!\n");
+        return 1;
+    }
+    while (traceReaderNext(inputTrace, &traceRecord)) {
+        unsigned long block = traceRecord.address >> blockBits;
+        unsigned long lastBlock = block;
+        bool bAllocated;
+        if (traceRecord.accessType == 'L')
+            iMemAccessTypeFlag = 0;
+        else if (traceRecord.accessType == 'S')
+            iMemAccessTypeFlag = 1;
+        if (bSplitAccesses)
+            lastBlock = cacheSpanLastBlock(traceRecord.address,
+                                           traceRecord.byteSize, blockBits);
+        bAllocated = stackDistAccess(&stackDist, iMemAccessTypeFlag,
+                                     traceRecord.address);
+        while (bAllocated && (block != lastBlock)) {
+            block++;
+            bAllocated = stackDistAccess(&stackDist, iMemAccessTypeFlag,
+                                         block << blockBits);
+        }
+        if (!bAllocated) {
+            printf("Heap allocation for cache simulator failed!\n");
+            stackDistFree(&stackDist);
+            return 1;
         }
     }
-    if (evictFlag)
-        cacheEvictionHandler(cacheAddr, addrSVal, addrTagVal, memAccessType,
-                             stats);
+    for (unsigned int e = 1; e <= maxLinesPerSet; e++) {
+        cacheConfig_t config = {setBits, e, blockBits};
+        stackDistSummary(&stackDist, e, &stats);
+        printConfigSummary(&config, &stats);
+    }
+    stackDistFree(&stackDist);
+    return 0;
 }
 
 /**
- * @brief Cache evictions are handled in this function.
+ * @brief Simulates a trace on every cache, one run of accesses at a time.
  *
+ * The first access of a run goes through the caches like any other, after
+ * which its block is the most recently used line of its set in each of
+ * them, so the repeats all hit and are applied by cacheRepeatHits.
  *
- * @param[in]       cacheLine_t *cacheAddr          Pointer to the cache
- * simulator
- * @param[in]       unsigned long addrSVal          Cache set to be accessed
- * @param[in]       unsigned long addrTagVal        Tag value of the memory
- * address to be accessed
- * @param[in]       unsigned int memAccessType      Memory access type
- * @param[in,out]   csim_stats_t *stats             Cache statistics
+ * @param[in,out]   traceReader_t *inputTrace       Open trace, read to its
+ * end
+ * @param[in,out]   cache_t *caches                 Caches to simulate
+ * @param[in]       unsigned int cacheCount         Number of caches
+ * @param[in,out]   interval_t *interval            Windows the records are
+ * counted in, NULL for none
+ * @param[in]       bool bSplitAccesses             Simulate every block an
+ * access touches
+ * @param[in,out]   unsigned int *pMemAccessType    Type of the latest load
+ * or store, 1 for a store
  *
  * @return void.
  */
-void cacheEvictionHandler(cacheLine_t *cacheAddr, unsigned long addrSVal,
-                          unsigned long addrTagVal, unsigned int memAccessType,
-                          csim_stats_t *stats) {
-    /* Cache eviction handler */
-    stats->evictions++;
-    if (bVerbose)
-        printf("\teviction");
-    for (unsigned int j = 0; j < iCacheLinesPerSet; j++) {
-        /* If cache line rank == "EVICTION_RANK_VAL" then evict line
-         and update tag and rank for cache line */
-        if (cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iRank ==
-            EVICTION_RANK_VAL) {
-            cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iTag = addrTagVal;
-            cacheAddr[(addrSVal * iCacheLinesPerSet) + j].iRank =
-                iRecentAccessRankValue;
-            /* If eviction was dirty then update dirty eviction count */
-            if (cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bDirtyFlag == 1) {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j]
-                    .dirtyEvictionCount++;
-            }
-            /* Updating dirty memory access flag */
-            if (memAccessType == 0) {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bDirtyFlag = 0;
-            } else {
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + j].bDirtyFlag = 1;
-            }
-            /* Updating cache line rank upon access */
-            cacheLineRankUpdate(cacheAddr, addrSVal, j);
-            break;
+void simulateTraceRuns(traceReader_t *inputTrace, cache_t *caches,
+                       unsigned int cacheCount, interval_t *interval,
+                       bool bSplitAccesses, unsigned int *pMemAccessType) {
+    traceCoalescer_t coalescer;
+    traceRun_t run;
+    unsigned int blockBits = caches[0].iBlockBitCount;
+
+    for (unsigned int i = 1; i < cacheCount; i++) {
+        if (caches[i].iBlockBitCount < blockBits)
+            blockBits = caches[i].iBlockBitCount;
+    }
+    traceCoalescerInit(&coalescer, inputTrace, blockBits, bSplitAccesses);
+    coalescer.accessType = (*pMemAccessType == 1) ? 'S' : 'L';
+    if (interval != NULL)
+        coalescer.iMaxRecords = interval->iWindowEnd - interval->iRecords;
+    while (traceCoalescerNext(&coalescer, &run)) {
+        unsigned int memAccessType = (run.first.accessType == 'S') ? 1 : 0;
+        for (unsigned int i = 0; i < cacheCount; i++) {
+            if (bSplitAccesses)
+                checkSimulatorCacheSpan(&caches[i], memAccessType,
+                                        run.first.address,
+                                        run.first.byteSize);
+            else
+                checkSimulatorCache(&caches[i], memAccessType,
+                                    run.first.address);
+            if (run.iRepeats != 0)
+                cacheRepeatHits(&caches[i], run.first.address, run.iRepeats,
+                                run.bDirty);
+        }
+        /* Runs end at window boundaries, so a window closes exactly */
+        if (interval != NULL) {
+            interval->iRecords += run.iRepeats + 1;
+            if (interval->iRecords == interval->iWindowEnd)
+                intervalWrite(interval);
+            coalescer.iMaxRecords = interval->iWindowEnd - interval->iRecords;
         }
     }
+    *pMemAccessType = (coalescer.accessType == 'S') ? 1 : 0;
 }
 
 /**
- * @brief Cache line rank updates are handled in this function.
+ * @brief Simulates a trace on every cache, one record at a time.
  *
+ * Used when runs would not be exact, see main, and for the records before
+ * a checkpoint, past which the coalescer would read ahead.
  *
- * @param[in]       cacheLine_t *cacheAddr              Pointer to the cache
- * simulator
- * @param[in]       unsigned long addrSVal              Cache set to be accessed
- * @param[in]       unsigned int recentAccessIndex      Most recently accessed
- * cache line index
+ * @param[in,out]   traceReader_t *inputTrace       Open trace
+ * @param[in,out]   cache_t *caches                 Caches to simulate
+ * @param[in]       unsigned int cacheCount         Number of caches
+ * @param[in,out]   heatmap_t *heatmap              Heatmap instrumenting the
+ * first cache, NULL for none
+ * @param[in,out]   interval_t *interval            Windows the records are
+ * counted in, NULL for none
+ * @param[in]       bool bSplitAccesses             Simulate every block an
+ * access touches
+ * @param[in,out]   unsigned int *pMemAccessType    Type of the latest load
+ * or store, 1 for a store
+ * @param[in]       unsigned long recordLimit       Most records simulated
  *
- * @return void.
+ * @return False if the heatmap allocation failed.
  */
-void cacheLineRankUpdate(cacheLine_t *cacheAddr, unsigned long addrSVal,
-                         unsigned int recentAccessIndex) {
-    for (unsigned int i = 0; i < iCacheLinesPerSet; i++) {
-        if ((i != recentAccessIndex) &&
-            (cacheAddr[(addrSVal * iCacheLinesPerSet) + i].bValidFlag ==
-             CACHE_VALID_FLAG)) {
-            cacheAddr[(addrSVal * iCacheLinesPerSet) + i].iRank =
-                cacheAddr[(addrSVal * iCacheLinesPerSet) + i].iRank - 1;
+bool simulateTraceRecords(traceReader_t *inputTrace, cache_t *caches,
+                          unsigned int cacheCount, heatmap_t *heatmap,
+                          interval_t *interval, bool bSplitAccesses,
+                          unsigned int *pMemAccessType,
+                          unsigned long recordLimit) {
+    traceRecord_t traceRecord;
+    bool bHeatmapFailed = false;
+
+    for (unsigned long r = 0; !bHeatmapFailed && (r < recordLimit) &&
+                              traceReaderNext(inputTrace, &traceRecord);
+         r++) {
+        if (traceRecord.accessType == 'L') /* Load memory address */
+        {
+            *pMemAccessType = 0;
+        } else if (traceRecord.accessType == 'S') /* Store memory address */
+        {
+            *pMemAccessType = 1;
         }
+        if (bVerbose)
+            printf("%c %lx,%d", traceRecord.accessType, traceRecord.address,
+                   traceRecord.byteSize);
+        /* Checking simulator caches for memory hits and misses */
+        for (unsigned int i = 0; i < cacheCount; i++) {
+            if ((heatmap != NULL) && (i == 0))
+                bHeatmapFailed =
+                    !(bSplitAccesses
+                          ? heatmapAccessSpan(heatmap, *pMemAccessType,
+                                              traceRecord.address,
+                                              traceRecord.byteSize)
+                          : heatmapAccess(heatmap, *pMemAccessType,
+                                          traceRecord.address));
+            else if (bSplitAccesses)
+                checkSimulatorCacheSpan(&caches[i], *pMemAccessType,
+                                        traceRecord.address,
+                                        traceRecord.byteSize);
+            else
+                checkSimulatorCache(&caches[i], *pMemAccessType,
+                                    traceRecord.address);
+        }
+        if (bVerbose)
+            printf("\n");
+        if ((interval != NULL) &&
+            (++interval->iRecords == interval->iWindowEnd))
+            intervalWrite(interval);
     }
+    return !bHeatmapFailed;
 }
+
+/**
+ * @brief Checks that a list of levels forms a hierarchy csim can simulate.
+ *
+ * Blocks move between levels whole, so every level needs the same block
+ * size, and the replacement policy must support every associativity.
+ *
+ * @param[in]       const cacheConfig_t *levels     Levels, L1 first
+ * @param[in]       unsigned int levelCount         Number of levels
+ * @param[in]       const cachePolicy_t *policy     Replacement policy
+ *
+ * @return True if the hierarchy is valid.
+ */
+bool isValidHierarchy(const cacheConfig_t *levels, unsigned int levelCount,
+                      const cachePolicy_t *policy) {
+    if (levelCount > HIERARCHY_MAX_LEVELS)
+        return false;
+    for (unsigned int i = 0; i < levelCount; i++) {
+        if ((levels[i].iBlockBitCount != levels[0].iBlockBitCount) ||
+            !policy->isSupported(levels[i].iCacheLinesPerSet))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Simulates a trace on a multi-level hierarchy.
+ *
+ * Prints one summary line per level, L1 first, with the number of lines the
+ * level lost to back-invalidations from the levels below.
+ *
+ * @param[in,out]   traceReader_t *inputTrace       Open trace
+ * @param[in]       const cacheConfig_t *levels     Levels, L1 first
+ * @param[in]       unsigned int levelCount         Number of levels
+ * @param[in]       unsigned int inclusion          One of HIERARCHY_*
+ * @param[in]       const cachePolicy_t *policy     Replacement policy
+ * @param[in]       bool bSplitAccesses             Split accesses that
+ * straddle blocks
+ *
+ * @return Exit status for main.
+ */
+int runHierarchy(traceReader_t *inputTrace, const cacheConfig_t *levels,
+                 unsigned int levelCount, unsigned int inclusion,
+                 const cachePolicy_t *policy, bool bSplitAccesses) {
+    cacheHierarchy_t hierarchy;
+    traceRecord_t traceRecord;
+    csim_stats_t stats;
+    unsigned int iMemAccessTypeFlag = 0;
+
+    if (!hierarchyInit(&hierarchy, levels, levelCount, inclusion, policy)) {
+        printf("Heap allocation for cache simulator failed!\n");
+        return 1;
+    }
+    while (traceReaderNext(inputTrace, &traceRecord)) {
+        /* Every level has the L1 block size */
+        unsigned int blockBits = levels[0].iBlockBitCount;
+        unsigned long block = traceRecord.address >> blockBits;
+        unsigned long lastBlock = block;
+        if (traceRecord.accessType == 'L')
+            iMemAccessTypeFlag = 0;
+        else if (traceRecord.accessType == 'S')
+            iMemAccessTypeFlag = 1;
+        if (bSplitAccesses)
+            lastBlock = cacheSpanLastBlock(traceRecord.address,
+                                           traceRecord.byteSize, blockBits);
+        hierarchyAccess(&hierarchy, iMemAccessTypeFlag, traceRecord.address);
+        while (block != lastBlock) {
+            block++;
+            hierarchyAccess(&hierarchy, iMemAccessTypeFlag, block << blockBits);
+        }
+    }
+    for (unsigned int i = 0; i < levelCount; i++) {
+        hierarchySummary(&hierarchy, i, &stats);
+        printf("L%u s:%u E:%u b:%u hits:%lu misses:%lu evictions:%lu "
+               "dirty_bytes_in_cache:%lu dirty_bytes_evicted:%lu "
+               "back_invalidations:%lu\n",
+               i + 1, levels[i].iSetBitCount, levels[i].iCacheLinesPerSet,
+               levels[i].iBlockBitCount, stats.hits, stats.misses,
+               stats.evictions, stats.dirty_bytes, stats.dirty_evictions,
+               hierarchy.pBackInvalidations[i]);
+    }
+    hierarchyFree(&hierarchy);
+    return 0;
+}
+
 /**
  * @brief Print verbose for help.
  *
@@ -381,5 +1157,41 @@ void printHelpVerbose(void) {
            "-s -> number of set bits\n"
            "-E -> number of lines per cache set\n"
            "-b -> number of block bits per cache line\n"
-           "-t -> input trace file\n");
+           "-t -> input trace file, text or binary, - for standard input\n"
+           "-C -> extra configurations as s:E:b[,s:E:b...], all simulated "
+           "in one pass\n"
+           "-A -> report every E from 1 to this limit for -s/-b, using the "
+           "stack-distance engine\n"
+           "-j -> number of threads, each simulating a subset of the sets "
+           "of a single configuration\n"
+           "-p -> replacement policy: lru (default), fifo, random, plru "
+           "(power of two E), srrip or lfu\n"
+           "-L -> lower cache levels as s:E:b[,s:E:b...], simulated as a "
+           "hierarchy below the -s/-E/-b L1 (Haswell L1 if not given)\n"
+           "-I -> hierarchy inclusion policy: nine (default), inclusive or "
+           "exclusive\n"
+           "-S -> simulate every block an access touches, not only the "
+           "block of its first byte\n"
+           "-f -> prefetcher as name[:degree]: nextline, stride (per 4 KiB "
+           "region) or stream\n"
+           "-H -> write per-set and per-region hits, misses by class and "
+           "evictions of the first configuration to a CSV file, JSON if "
+           "named *.json\n"
+           "-R -> heatmap region as name:start:size, repeatable, instead of "
+           "4 KiB pages\n"
+           "-k -> simulate 1 in 2^k sets, below s, and estimate the counts "
+           "with 95%% confidence margins, which hold only if the sets are "
+           "alike, warning when they are not\n"
+           "-D -> write the state of every cache to a snapshot file at the "
+           "end of the run\n"
+           "-N -> take the -D snapshot after this many trace records "
+           "instead\n"
+           "-W -> load the state of every cache from a snapshot file before "
+           "simulating\n"
+           "-w -> write policy as policy[:entries]: wb (default), wt, wb-nwa "
+           "or wt-nwa, with a write-combining buffer of that many blocks\n"
+           "-i -> write the counters of every cache over each window of "
+           "this many trace records to the -o file\n"
+           "-o -> -i output file, CSV, JSON Lines if named *.json, - for "
+           "standard output\n");
 }
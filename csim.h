@@ -1,29 +1,210 @@
 /**
  * @file csim.h
- * @brief Header file for csim.c
+ * @brief Cache simulator engine shared by csim.c and its tools
  *
+ * A cache_t owns the metadata and statistics of one simulated cache
+ * geometry, so any number of configurations can be driven side by side
+ * from a single pass over a trace.
  *
  * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
  */
+
+#ifndef CSIM_H
+#define CSIM_H
+
 #include "cachelab.h"
+#include "csim-probe.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 /* Defines */
-#define NUM_ELEMENTS_IN_UNIT            5
-#define ADDRESS_BITS_LEN                64
-#define CACHE_INVALID_FLAG              0
-#define CACHE_VALID_FLAG                1
-#define EVICTION_RANK_VAL               1
+#define ADDRESS_BITS_LEN 64
+#define CACHE_WAY_NONE UINT_MAX
+#define CACHE_MASK_WORD_BITS 64
+
+/* Write policy flags of cacheSetWritePolicy, none for write-back allocate */
+#define CACHE_WRITE_THROUGH 0x1     /* Stores go on past clean lines */
+#define CACHE_WRITE_NO_ALLOCATE 0x2 /* Store misses bypass the cache */
+#define CACHE_WRITE_BUFFER_MAX 64   /* Write-combining buffer entries */
+
+/* Recency list links of one cache line */
+typedef struct {
+    unsigned int iPrevWay; /* More recently used line in the set */
+    unsigned int iNextWay; /* Less recently used line in the set */
+} cacheWayLink_t;
+
+/* Cache set structure members, heads the set's recency list */
+typedef struct {
+    unsigned int iMruWay;           /* Most recently used line */
+    unsigned int iLruWay;           /* Least recently used line, next victim */
+    unsigned int iValidLineCount;   /* Lines filled so far, ways [0, count) */
+    unsigned int iInvalidLineCount; /* Invalidated lines below the count */
+} cacheSet_t;
 
-/* Cache line structure members */
+/* Cache geometry, one (s, E, b) configuration */
 typedef struct {
-    unsigned long iTag;                             /* Tag value */
-    unsigned int bDirtyFlag;                        /* Dirty Flag */
-    unsigned int bValidFlag;                        /* Valid Flag */
-    unsigned int iRank;                             /* Rank value that keeps track of recent access to this memory */
-    unsigned int dirtyEvictionCount;                /* Dirty eviction count */
-} cacheLine_t;
+    unsigned int iSetBitCount;      /* s */
+    unsigned int iCacheLinesPerSet; /* E */
+    unsigned int iBlockBitCount;    /* b */
+} cacheConfig_t;
+
+/* Per-set counters of a sampled cache, see cacheSetSampling */
+typedef struct {
+    unsigned long iHits;      /* Hits in the set */
+    unsigned long iMisses;    /* Misses in the set */
+    unsigned long iEvictions; /* Evictions from the set */
+} cacheSampleSet_t;
+
+/* Stores a write policy sends on past the cache, dirty evictions aside */
+typedef struct {
+    unsigned long iWrites;       /* Stores written through or around */
+    unsigned long iCombined;     /* Of these, merged into a buffered block */
+    unsigned long iTransactions; /* Block writes that left the buffer, or
+                                    the stores themselves without one */
+} cacheWriteStats_t;
+
+/* Line displaced from a cache, as seen by the next level of a hierarchy */
+typedef struct {
+    bool bValid;            /* Set by every eviction, cleared by the reader */
+    bool bDirty;            /* The line was dirty */
+    unsigned long iAddress; /* First byte of the evicted block */
+} cacheVictim_t;
+
+typedef struct cache cache_t;
+
+/* Simulates one access, specialised for a cache geometry */
+typedef void (*cacheAccessFn_t)(cache_t *cache, unsigned int memAccessType,
+                                unsigned long memAddr);
+
+/*
+ * Replacement policy. Each set owns iPolicyWordsPerSet zero-initialised
+ * words of pPolicyState; a set with every word zero is in the policy's
+ * initial state. Ways are filled in order while a set has empty lines, so
+ * chooseVictim is only asked once the set is full. onFill runs before a
+ * newly filled line is counted in iValidLineCount. A line invalidated by
+ * cacheInvalidate is refilled, through onFill, before any victim is chosen.
+ * onHitRun stands for count calls of onHit on the line the previous access
+ * touched, of which most policies only need the first.
+ */
+typedef struct {
+    const char *pName;   /* Name given to -p */
+    bool bRecencyList;   /* Needs the pLinks LRU recency list */
+    bool (*isSupported)(unsigned int linesPerSet);
+    unsigned int (*stateWordsPerSet)(unsigned int linesPerSet);
+    void (*onHit)(cache_t *cache, unsigned long addrSVal, unsigned int way);
+    void (*onHitRun)(cache_t *cache, unsigned long addrSVal, unsigned int way,
+                     unsigned long count);
+    void (*onFill)(cache_t *cache, unsigned long addrSVal, unsigned int way);
+    unsigned int (*chooseVictim)(cache_t *cache, unsigned long addrSVal);
+} cachePolicy_t;
+
+/*
+ * Hardware prefetcher. onTrigger sees the block of every demand miss and
+ * of the first demand hit to each prefetched line, and brings blocks in
+ * with cachePrefetch. Its iStateWords words of pPrefetchState start zeroed.
+ */
+typedef struct {
+    const char *pName;           /* Name given to -f */
+    unsigned int iStateWords;    /* Words of pPrefetchState per cache */
+    unsigned int iDefaultDegree; /* Blocks fetched per trigger by default */
+    void (*onTrigger)(cache_t *cache, unsigned long block);
+} cachePrefetcher_t;
+
+/* Prefetch counters, lines issued but never hit are the useless ones */
+typedef struct {
+    unsigned long iIssued; /* Blocks brought in by the prefetcher */
+    unsigned long iUseful; /* Prefetched lines later hit by a demand access */
+} cachePrefetchStats_t;
+
+/*
+ * Simulated cache, one per (s, E, b) configuration.
+ *
+ * Line metadata is stored as a structure of arrays: the tags of a set are
+ * contiguous so a probe streams through them, and the valid and dirty
+ * flags are bitmasks of iMaskWordsPerSet words per set. Recency links are
+ * only touched once the probe has found its way.
+ *
+ * A sampled cache holds its sampled sets only, so its geometry fields
+ * describe those: iSetBitCount is s minus iSampleBits.
+ */
+struct cache {
+    unsigned int iSetBitCount;       /* Number of set index bits, s */
+    unsigned int iSetCount;          /* Number of sets, 2^s */
+    unsigned int iCacheLinesPerSet;  /* Associativity, E */
+    unsigned int iBlockBitCount;     /* Number of block offset bits, b */
+    unsigned int iBlocksPerLine;     /* Bytes per cache line, 2^b */
+    unsigned int iMaskWordsPerSet;   /* Words of valid/dirty bits per set */
+    unsigned long *pTags;            /* Tags of all lines, set major */
+    uint64_t *pValidBits;            /* Valid bit of every line */
+    uint64_t *pDirtyBits;            /* Dirty bit of every line */
+    cacheWayLink_t *pLinks;          /* Recency links, LRU policy only */
+    cacheSet_t *pSets;               /* Fill count and LRU list of every set */
+    const cachePolicy_t *pPolicy;    /* Replacement policy */
+    uint64_t *pPolicyState;          /* Per-set replacement policy state */
+    unsigned int iPolicyWordsPerSet; /* Words of pPolicyState per set */
+    cacheProbeFn_t pProbe;           /* Tag match kernel for this geometry */
+    cacheAccessFn_t pAccess;         /* Access kernel for this geometry */
+    unsigned long iDirtyEvictions;   /* Dirty lines evicted so far */
+    cacheVictim_t victim;            /* Line displaced by the latest fill */
+    unsigned int iLastWay;           /* Way of the latest demand access */
+    /* Prefetcher, NULL if none */
+    const cachePrefetcher_t *pPrefetcher;
+    uint64_t *pPrefetchBits;         /* Prefetched lines not yet hit */
+    uint64_t *pPrefetchState;        /* Prefetcher tables */
+    unsigned int iPrefetchDegree;    /* Blocks fetched per trigger */
+    cachePrefetchStats_t prefetch;   /* Prefetch counters */
+    csim_stats_t stats;              /* Hits, misses and evictions so far */
+    /* Set sampling, 1 in 2^iSampleBits sets simulated, 0 if every set */
+    unsigned int iSampleBits;
+    cacheAccessFn_t pSampledAccess;  /* Kernel behind the sampling filter */
+    cacheSampleSet_t *pSampleSets;   /* Counters of every sampled set */
+    unsigned long iSampleAccesses;   /* Accesses to every set, sampled or not */
+    /* Write policy, CACHE_WRITE_* flags, 0 for write-back write-allocate */
+    unsigned int iWritePolicy;
+    unsigned long *pWriteBuffer;     /* Blocks in the write-combining buffer */
+    unsigned int iWriteBufferSize;   /* Its entries, 0 if there is none */
+    unsigned int iWriteBufferHead;   /* Oldest buffered block */
+    unsigned int iWriteBufferCount;  /* Blocks buffered */
+    cacheWriteStats_t write;         /* Writes sent on past the cache */
+};
+
+/* Print hit/miss/eviction per access */
+extern bool bVerbose;
 
 /* Function prototyping */
-void checkSimulatorCache(cacheLine_t *cacheAddr,unsigned int accFlag, unsigned long memAddr, csim_stats_t *stats);
-void cacheMissHandler(cacheLine_t *cacheAddr, unsigned long addrSVal, unsigned long addrTagVal, unsigned int memAccessType, csim_stats_t *stats);
-void cacheEvictionHandler(cacheLine_t *cacheAddr, unsigned long addrSVal, unsigned long addrTagVal, unsigned int memAccessType, csim_stats_t *stats);
+bool cacheInit(cache_t *cache, unsigned int setBits, unsigned int linesPerSet,
+               unsigned int blockBits, const cachePolicy_t *policy);
+void cacheFree(cache_t *cache);
+void cacheSampledSummary(const cache_t *cache, csim_stats_t *stats);
+void cacheSampleEstimate(csim_stats_t *stats, unsigned long accesses);
+void cacheSummary(const cache_t *cache, csim_stats_t *stats);
+void checkSimulatorCache(cache_t *cache, unsigned int memAccessType,
+                         unsigned long memAddr);
+void checkSimulatorCacheSpan(cache_t *cache, unsigned int memAccessType,
+                             unsigned long memAddr, int byteSize);
+void cacheRepeatHits(cache_t *cache, unsigned long memAddr,
+                     unsigned long repeats, bool bDirty);
+unsigned long cacheSpanLastBlock(unsigned long memAddr, int byteSize,
+                                 unsigned int blockBits);
+void cacheMissHandler(cache_t *cache, unsigned long addrSVal,
+                      unsigned long addrTagVal, unsigned int memAccessType);
+unsigned int cacheEvictionHandler(cache_t *cache, unsigned long addrSVal,
+                                  unsigned long addrTagVal,
+                                  unsigned int memAccessType);
+bool cacheAccessIfPresent(cache_t *cache, unsigned int memAccessType,
+                          unsigned long memAddr);
+bool cacheInvalidate(cache_t *cache, unsigned long memAddr, bool *pDirty);
+void cacheInsert(cache_t *cache, unsigned long memAddr, bool bDirty);
+bool cacheSetPrefetcher(cache_t *cache, const cachePrefetcher_t *prefetcher,
+                        unsigned int degree);
+void cachePrefetch(cache_t *cache, unsigned long block);
+bool cacheSetSampling(cache_t *cache, unsigned int sampleBits);
+bool cacheWritePolicyFind(const char *spec, unsigned int *pWritePolicy,
+                          unsigned int *pBufferSize);
+bool cacheSetWritePolicy(cache_t *cache, unsigned int writePolicy,
+                         unsigned int bufferSize);
+void cacheLineRankUpdate(cache_t *cache, unsigned long addrSVal,
+                         unsigned int recentAccessIndex);
 
+#endif /* CSIM_H */
@@ -9,6 +9,9 @@ correctness and performance of their transpose function.
 * It runs ./test-trans on two different sized matrices (32x32 and 63x65) to
   test the correctness and performance of the transpose function.
 
+With -j, up to that many test-trans runs go at once. Their output is still
+printed in the order of the tests.
+
 """
 
 import subprocess
@@ -19,6 +22,7 @@ import argparse
 import hashlib
 import numbers
 import collections
+import concurrent.futures
 import json
 
 # Maximum scores for each part
@@ -94,8 +98,8 @@ def test_csim():
 
 
 def run_test_trans(cmd):
-    """Runs a test-trans command and returns the cycle count"""
-    print("Running %s" % cmd)
+    """Runs a test-trans command and returns the cycle count and its log"""
+    log = ["Running %s" % cmd]
     p = subprocess.Popen("%s | grep TEST_TRANS_RESULTS" % cmd,
                          shell=True, stdout=subprocess.PIPE, encoding='utf-8')
 
@@ -103,45 +107,44 @@ def run_test_trans(cmd):
         stdout_data = p.communicate(timeout=30)[0]
     except subprocess.TimeoutExpired:
         p.kill()
-        print("Error: command timed out.")
-        return None
+        log.append("Error: command timed out.")
+        return None, log
 
     if p.returncode != 0:
-        print("Error: return code indicates failure:", p.returncode)
-        return None
+        log.append("Error: return code indicates failure: %d" % p.returncode)
+        return None, log
 
     result = re.match(r'TEST_TRANS_RESULTS=(\d+):(\d+)', stdout_data)
     if result is None or result.group(1) != '1':
-        print("Error: return data indicates failure:", stdout_data)
-        return None
+        log.append("Error: return data indicates failure: %s" % stdout_data)
+        return None, log
+
+    return int(result.group(2)), log
+
 
-    return int(result.group(2))
+def run_test_trans_all(cmds, jobs):
+    """Runs test-trans commands, up to jobs at once, printing their logs in
+    order, and returns their cycle counts"""
+    with concurrent.futures.ThreadPoolExecutor(max_workers=jobs) as pool:
+        outcomes = list(pool.map(run_test_trans, cmds))
+    for _, log in outcomes:
+        print("\n".join(log))
+    return [cycles for cycles, _ in outcomes]
 
 
-def test_trans():
+def test_trans(jobs):
     """Checks the correctness of the transpose functions"""
     print("Part B: Testing transpose function correctness")
 
-    transOK = True
-    for rc in tests:
-        r = rc[0]
-        c = rc[1]
-        cmd = "./test-trans -s -M %d -N %d" % rc
-        cycles = run_test_trans(cmd)
-        if cycles is None:
-            transOK = False
+    cmds = ["./test-trans -s -M %d -N %d" % rc for rc in tests]
+    transOK = None not in run_test_trans_all(cmds, jobs)
 
     if transOK:
-        # 32x32 transpose
-        cmd = "./test-trans -s -M 32 -N 32"
-        cycles32 = run_test_trans(cmd)
-        if cycles32 is None:
-            transOK = False
-
-        # 1024x1024 transpose
-        cmd = "./test-trans -s -M 1024 -N 1024 -l"
-        cycles1024 = run_test_trans(cmd)
-        if cycles1024 is None:
+        # 32x32 and 1024x1024 transpose
+        cycles32, cycles1024 = run_test_trans_all(
+            ["./test-trans -s -M 32 -N 32",
+             "./test-trans -s -M 1024 -N 1024 -l"], jobs)
+        if cycles32 is None or cycles1024 is None:
             transOK = False
 
     if transOK:
@@ -166,13 +169,16 @@ def main():
     p = argparse.ArgumentParser(description="Autograder for Cachelab")
     p.add_argument("-A", action="store_true", dest="autograde",
                    help="emit autoresult string for Autolab")
+    p.add_argument("-j", type=int, default=1, dest="jobs",
+                   help="number of test-trans runs to run at once")
     args = p.parse_args()
     autograde = args.autograde
 
     # Compute scores for each part
     traces_score = test_traces()
     csim_cscore = test_csim()
-    cycles32, cycles1024, trans32_score, trans1024_score = test_trans()
+    cycles32, cycles1024, trans32_score, trans1024_score = test_trans(
+        max(args.jobs, 1))
     total_score = traces_score + csim_cscore + trans32_score + trans1024_score
 
     # Summarize the results
@@ -5,135 +5,727 @@
  * This program checks the correctness and performance of all of the
  * student's transpose functions and records the results for their
  * official submitted version as well.
+ *
+ * With -j, a pool of worker threads evaluates several functions at once.
+ * Each function gets its own trace file, named after the process and the
+ * function so concurrent test-trans runs never share one either, and its
+ * report is buffered and printed in registration order once every worker
+ * is done.
+ *
+ * With -p, no trace file is written at all. tracegen-ct's trace writer is
+ * pointed at a pipe, and the simulator library parses and simulates the
+ * accesses as they arrive, on a parser thread and the evaluating thread,
+ * while the transpose is still being traced. -d also saves each streamed
+ * trace in the binary format.
+ *
+ * With -t, nothing is traced or simulated. Each function is run natively on
+ * this machine instead, as are the vector kernels of trans-simd.c, and the
+ * fastest of the given number of runs is reported.
+ *
+ * With -c, each function is also scored by a cost model that, unlike
+ * get_clock_cycles, charges for the blocks written back to memory and caps
+ * the memory bandwidth. A model may simulate the cache under another write
+ * policy, alongside the graded one. The grade itself is always the
+ * cachelab score.
+ *
+ * With -e, each function is simulated on the Haswell L1, as with -l, and
+ * then run natively under the CPU's hardware counters. The cycles, L1D,
+ * LLC and dTLB events of its native runs are reported next to the
+ * simulated statistics, so a function that simulates well but stalls on
+ * the TLB or on prefetches shows up.
  */
 
+/* posix_spawn, open_memstream, pthreads, posix_memalign and clock_gettime
+   are POSIX, not C99, and syscall, for perf_event_open, is neither */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <limits.h> // for LONG_MAX
+#include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h> // for WEXITSTATUS
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__)
+#include <x86intrin.h> // for __rdtsc
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h> // for SYS_perf_event_open
+#define HW_COUNTERS 1
+#endif
+
 #include "cachelab.h"
+#include "csim-lib.h"
+#include "trans-simd.h"
 
 #define CMD_BUFSIZE 334
 #define FILENAME_BUFSIZE 255
 
+/** @brief Upper limit on -j */
+#define MAX_WORKERS 64
+
+/** @brief Descriptor tracegen-ct writes a streamed trace to */
+#define TRACE_PIPE_FD 3
+
+/** @brief Upper limit on -t */
+#define MAX_TIMED_RUNS 1000
+
+/** @brief Bytes read between timed runs where the C library does not know
+           the size of the last-level cache */
+#define FLUSH_BYTES (256UL << 20)
+
+/** @brief Times the last-level cache the flush buffer spans, so reading it
+           also evicts a cache that does not hold lines in LRU order */
+#define FLUSH_MARGIN 2
+
+/** @brief Distance between the flush reads, one per cache line */
+#define FLUSH_STRIDE 64
+
+/** @brief Upper limit on -e */
+#define MAX_COUNTED_RUNS 1000
+
+/** @brief Hardware events counted by -e, indices into hw_events */
+#define HW_CYCLES 0
+#define HW_L1D_LOADS 1
+#define HW_L1D_LOAD_MISSES 2
+#define HW_L1D_STORES 3
+#define HW_L1D_STORE_MISSES 4
+#define HW_LLC_MISSES 5
+#define HW_DTLB_LOAD_MISSES 6
+#define HW_DTLB_STORE_MISSES 7
+#define HW_EVENT_COUNT 8
+
+/** @brief Cost model scoring a simulated trace, see -c */
+typedef struct {
+    const char *name;              /* Name given to -c */
+    const char *description;       /* One line for the usage message */
+    const char *write_policy;      /* csim -w policy, NULL for write-back */
+    unsigned long hit_cycles;      /* Cycles of a hit */
+    unsigned long miss_cycles;     /* Cycles of a miss served by memory */
+    unsigned long write_cycles;    /* Cycles of a block written to memory */
+    unsigned long bytes_per_cycle; /* Memory bandwidth, 0 for no cap */
+} cost_model_t;
+
+/** @brief Cost models -c accepts by name */
+static const cost_model_t cost_models[] = {
+    {"cachelab", "Hits and misses only, as graded", NULL, HIT_CYCLES,
+     MISS_CYCLES, 0, 0},
+    {"writeback", "Also charges every dirty block written back", NULL,
+     HIT_CYCLES, MISS_CYCLES, MISS_CYCLES / 2, 0},
+    {"writethrough", "Write-through with an 8-entry write-combining buffer",
+     "wt:8", HIT_CYCLES, MISS_CYCLES, MISS_CYCLES / 2, 0},
+    {"streaming", "Overlapped misses, 1 byte per cycle of memory bandwidth",
+     NULL, HIT_CYCLES, MISS_CYCLES / 5, MISS_CYCLES / 10, 1},
+};
+
+/** @brief Model given to -c as hit,miss,write,bandwidth[,policy] */
+static cost_model_t custom_model = {"custom", NULL, NULL, 0, 0, 0, 0};
+
+/** @brief Hardware event counted by -e */
+typedef struct {
+    const char *name; /* Label in the report */
+    uint32_t type;    /* perf_event_attr type */
+    uint64_t config;  /* perf_event_attr config */
+} hw_event_t;
+
+/* Entry of hw_events, whose perf_event_attr fields only exist on Linux */
+#ifdef HW_COUNTERS
+#define HW_EVENT(name, type, config) {name, type, config}
+#else
+#define HW_EVENT(name, type, config) {name, 0, 0}
+#endif
+
+/* perf_event_attr config of a PERF_TYPE_HW_CACHE event */
+#define HW_CACHE_EVENT(cache, op, result)                                      \
+    ((uint64_t)PERF_COUNT_HW_CACHE_##cache |                                   \
+     ((uint64_t)PERF_COUNT_HW_CACHE_OP_##op << 8) |                            \
+     ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_##result << 16))
+
+static const hw_event_t hw_events[HW_EVENT_COUNT] = {
+    [HW_CYCLES] =
+        HW_EVENT("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES),
+    [HW_L1D_LOADS] = HW_EVENT("l1d_loads", PERF_TYPE_HW_CACHE,
+                              HW_CACHE_EVENT(L1D, READ, ACCESS)),
+    [HW_L1D_LOAD_MISSES] = HW_EVENT("l1d_load_misses", PERF_TYPE_HW_CACHE,
+                                    HW_CACHE_EVENT(L1D, READ, MISS)),
+    [HW_L1D_STORES] = HW_EVENT("l1d_stores", PERF_TYPE_HW_CACHE,
+                               HW_CACHE_EVENT(L1D, WRITE, ACCESS)),
+    [HW_L1D_STORE_MISSES] = HW_EVENT("l1d_store_misses", PERF_TYPE_HW_CACHE,
+                                     HW_CACHE_EVENT(L1D, WRITE, MISS)),
+    [HW_LLC_MISSES] = HW_EVENT("llc_misses", PERF_TYPE_HARDWARE,
+                               PERF_COUNT_HW_CACHE_MISSES),
+    [HW_DTLB_LOAD_MISSES] = HW_EVENT("dtlb_load_misses", PERF_TYPE_HW_CACHE,
+                                     HW_CACHE_EVENT(DTLB, READ, MISS)),
+    [HW_DTLB_STORE_MISSES] = HW_EVENT("dtlb_store_misses", PERF_TYPE_HW_CACHE,
+                                      HW_CACHE_EVENT(DTLB, WRITE, MISS)),
+};
+
+/** @brief Open hardware counters of this process, see hw_open */
+typedef struct {
+    int fds[HW_EVENT_COUNT];    /* Counter descriptors, -1 if unavailable */
+    int errors[HW_EVENT_COUNT]; /* errno of the opens that failed */
+} hw_counters_t;
+
+/** @brief Buffers of the native runs of -t and -e */
+typedef struct {
+    double *A;            /* Source matrix */
+    double *B;            /* Destination matrix */
+    double *tmp;          /* Temporary array */
+    unsigned char *flush; /* Read between runs to empty the caches */
+    size_t flush_bytes;   /* Bytes of flush, see flush_size */
+} native_bufs_t;
+
 /* Globals set on the command line */
 static size_t M = 0;
 static size_t N = 0;
 
+/* Environment handed to tracegen-ct */
+extern char **environ;
+
+/* Held while a trace pipe is created and handed to tracegen-ct */
+static pthread_mutex_t spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Sum of the flush reads, kept so they are not optimized away */
+static volatile unsigned char flush_sink;
+
+/** @brief Evaluation of one transpose function */
+typedef struct {
+    int funcid;         /* Index in func_list */
+    bool correct;       /* Trace generated and simulated */
+    csim_stats_t stats; /* Simulated statistics, valid if correct */
+    unsigned long cost; /* Cycles under the -c cost model */
+    char *output;       /* Buffered report, NULL if not buffered */
+    size_t output_size; /* Length of the buffered report */
+} eval_job_t;
+
+/** @brief Jobs shared by the worker threads */
+typedef struct {
+    eval_job_t *jobs;          /* Jobs in registration order */
+    int job_count;             /* Number of jobs */
+    int next_job;              /* Next unclaimed job, advanced atomically */
+    unsigned int s;            /* log2 of the number of sets */
+    unsigned int E;            /* associativity */
+    unsigned int b;            /* log2 of the block size */
+    bool streamed;             /* Traces are piped into the simulator */
+    bool dumped;               /* Streamed traces are also saved in binary */
+    const cost_model_t *model; /* -c cost model, NULL for none */
+} eval_pool_t;
+
 /** @brief Results of testing the submitted transpose function */
 static struct {
     int funcid;
     bool correct;
     csim_stats_t stats;
-} results = {-1, false, {LONG_MAX, LONG_MAX, LONG_MAX, LONG_MAX, LONG_MAX}};
+    unsigned long cost;
+} results = {-1,
+             false,
+             {LONG_MAX, LONG_MAX, LONG_MAX, LONG_MAX, LONG_MAX},
+             ULONG_MAX};
+
+/**
+ * @brief Starts tracegen-ct on a specific transpose function.
+ *
+ * tracegen-ct is spawned directly rather than through system(), which is
+ * not safe to call from several threads at once.
+ *
+ * @param[in]  out        Stream the report goes to
+ * @param[in]  trace_path Path tracegen-ct should write the trace to
+ * @param[in]  i          Index of the transpose function to use
+ * @param[in]  pipe_fd    Descriptor to pass on as TRACE_PIPE_FD, or -1
+ * @param[out] pid        Process ID of tracegen-ct
+ *
+ * @return True if tracegen-ct was started, and false otherwise
+ */
+static bool spawn_tracegen(FILE *out, const char *trace_path, int i,
+                           int pipe_fd, pid_t *pid) {
+    /* Arguments and environment of tracegen-ct */
+    char m_arg[32], n_arg[32], f_arg[32];
+    char trace_env[FILENAME_BUFSIZE + 16];
+    snprintf(m_arg, sizeof(m_arg), "%zu", M);
+    snprintf(n_arg, sizeof(n_arg), "%zu", N);
+    snprintf(f_arg, sizeof(f_arg), "%d", i);
+    snprintf(trace_env, sizeof(trace_env), "CONTECH_TRACE=%s", trace_path);
+    char *const args[] = {(char *)"./tracegen-ct", (char *)"-M", m_arg,
+                          (char *)"-N", n_arg, (char *)"-F", f_arg, NULL};
+
+    size_t env_count = 0;
+    while (environ[env_count] != NULL)
+        env_count++;
+    char **env = malloc((env_count + 2) * sizeof(char *));
+    if (env == NULL) {
+        fprintf(out, "Failed to run tracegen-ct: out of memory\n");
+        return false;
+    }
+    size_t n = 0;
+    for (size_t k = 0; k < env_count; k++) {
+        if (strncmp(environ[k], "CONTECH_TRACE=", 14) != 0)
+            env[n++] = environ[k];
+    }
+    env[n++] = trace_env;
+    env[n] = NULL;
+
+    posix_spawn_file_actions_t actions;
+    int error = posix_spawn_file_actions_init(&actions);
+    if (error == 0 && pipe_fd >= 0) {
+        error =
+            posix_spawn_file_actions_adddup2(&actions, pipe_fd, TRACE_PIPE_FD);
+    }
+    if (error == 0) {
+        error = posix_spawn(pid, args[0], &actions, NULL, args, env);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    free(env);
+    if (error != 0) {
+        fprintf(out, "Failed to run tracegen-ct: %s\n", strerror(error));
+        return false;
+    }
+    return true;
+}
 
 /**
- * @brief Calculates the number of clock cycles for the trace
+ * @brief Waits for tracegen-ct and checks that the function validated.
+ *
+ * @param[in] out        Stream the report goes to
+ * @param[in] pid        Process ID of tracegen-ct
+ * @param[in] trace_path Path tracegen-ct wrote the trace to
+ * @param[in] i          Index of the transpose function used
+ *
+ * @return True if the function succeeded, and false otherwise
  */
-static unsigned long get_clock_cycles(unsigned long hits,
-                                      unsigned long misses) {
-    return HIT_CYCLES * hits + MISS_CYCLES * misses;
+static bool wait_tracegen(FILE *out, pid_t pid, const char *trace_path,
+                          int i) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            fprintf(out, "Failed to run tracegen-ct: %s\n", strerror(errno));
+            return false;
+        }
+    }
+
+    if (!WIFEXITED(status)) {
+        fprintf(out,
+                "Internal error: ./tracegen-ct aborted for unknown "
+                "reason (status %x).\n",
+                status);
+        fprintf(out,
+                "Command run: CONTECH_TRACE=%s ./tracegen-ct -M %zd -N %zd "
+                "-F %d\n",
+                trace_path, M, N, i);
+        return false;
+    }
+
+    if (WEXITSTATUS(status) != 0) {
+        fprintf(out,
+                "Validation error at function %d! Run ./tracegen-ct -v -M "
+                "%zd -N %zd -F %d for details.\n",
+                i, M, N, i);
+        fprintf(out, "Exit status %d\n", WEXITSTATUS(status));
+        return false;
+    }
+
+    return true;
 }
 
 /**
  * @brief Generates a trace file for a specific transpose function.
  *
+ * @param[in] out       Stream the report goes to
  * @param[in] file_name File name where the trace should be stored
  * @param[in] i         Index of the transpose function to use
  *
  * @return True if the function succeeded, and false otherwise
  */
-static bool generate_trace(const char *file_name, int i) {
-    char cmd[CMD_BUFSIZE];
-    snprintf(cmd, sizeof(cmd),
-             "CONTECH_TRACE=%s ./tracegen-ct -M %ld -N %ld -F %d", file_name, M,
-             N, i);
+static bool generate_trace(FILE *out, const char *file_name, int i) {
+    pid_t pid;
+    if (!spawn_tracegen(out, file_name, i, -1, &pid)) {
+        return false;
+    }
+    return wait_tracegen(out, pid, file_name, i);
+}
 
-    int status = system(cmd);
-    if (status < 0) {
-        printf("Failed to run tracegen-ct: %s\n", strerror(errno));
+/**
+ * @brief Creates the pipe a streamed trace is written through.
+ *
+ * Both ends are moved above TRACE_PIPE_FD and marked close-on-exec, so the
+ * only write end a tracegen-ct inherits is its own, duplicated onto
+ * TRACE_PIPE_FD. Must be called with spawn_lock held, as other threads'
+ * tracegen-ct would otherwise inherit the ends before they are marked.
+ *
+ * @param[out] fds Read and write ends of the pipe
+ *
+ * @return True if the pipe was created, and false otherwise
+ */
+static bool open_trace_pipe(int fds[2]) {
+    if (pipe(fds) != 0) {
         return false;
     }
+    for (int k = 0; k < 2; k++) {
+        int fd = fcntl(fds[k], F_DUPFD_CLOEXEC, TRACE_PIPE_FD + 1);
+        close(fds[k]);
+        fds[k] = fd;
+    }
+    if (fds[0] < 0 || fds[1] < 0) {
+        int error = errno;
+        for (int k = 0; k < 2; k++) {
+            if (fds[k] >= 0) {
+                close(fds[k]);
+            }
+        }
+        errno = error;
+        return false;
+    }
+    return true;
+}
 
-    if (!WIFEXITED(status)) {
-        printf("Internal error: ./tracegen-ct aborted for unknown "
-               "reason (status %x).\n",
-               status);
-        printf("Command run: %s\n", cmd);
+/**
+ * @brief Creates the simulators a trace is evaluated with.
+ *
+ * sims[0] is the graded cache. If the cost model has a write policy of its
+ * own, sims[1] is the same cache under that policy.
+ *
+ * @param[in]  out   Stream the report goes to
+ * @param[in]  pool  Cache geometry to simulate and cost model
+ * @param[out] sims  Simulators created
+ *
+ * @return Number of simulators created, 0 on failure
+ */
+static size_t create_sims(FILE *out, const eval_pool_t *pool,
+                          csim_t *sims[2]) {
+    size_t count = 1;
+
+    sims[0] = csim_create(pool->s, pool->E, pool->b, NULL);
+    if (sims[0] != NULL && pool->model != NULL &&
+        pool->model->write_policy != NULL) {
+        sims[1] = csim_create(pool->s, pool->E, pool->b, NULL);
+        count = 2;
+        if (sims[1] == NULL ||
+            !csim_set_write_policy(sims[1], pool->model->write_policy)) {
+            csim_destroy(sims[1]);
+            csim_destroy(sims[0]);
+            sims[0] = NULL;
+        }
+    }
+    if (sims[0] == NULL) {
+        fprintf(out, "Cache simulator error.  Unable to create the "
+                     "simulator\n");
+        return 0;
+    }
+    return count;
+}
+
+/**
+ * @brief Releases the simulators of create_sims.
+ */
+static void destroy_sims(csim_t *sims[2], size_t count) {
+    for (size_t k = 0; k < count; k++) {
+        csim_destroy(sims[k]);
+    }
+}
+
+/**
+ * @brief Scores a simulated trace under a cost model.
+ *
+ * Every miss fills a block, and every block written to memory, whether
+ * evicted dirty, still dirty at the end, or sent on by the write policy,
+ * costs write_cycles. With a bandwidth cap, the trace takes at least as
+ * long as moving those blocks does.
+ *
+ * @param[in] model Cost model
+ * @param[in] sim   Simulator of the cache the model describes
+ * @param[in] b     log2 of the block size
+ *
+ * @return Cycles the trace takes under the model
+ */
+static unsigned long model_cycles(const cost_model_t *model,
+                                  const csim_t *sim, unsigned int b) {
+    csim_stats_t stats;
+    csim_write_stats_t writes;
+    unsigned long block_bytes = 1UL << b;
+
+    csim_stats(sim, &stats);
+    csim_write_stats(sim, &writes);
+    unsigned long blocks_written =
+        (stats.dirty_evictions + stats.dirty_bytes) / block_bytes +
+        writes.memory_writes + writes.buffered;
+    unsigned long cycles = model->hit_cycles * stats.hits +
+                           model->miss_cycles * stats.misses +
+                           model->write_cycles * blocks_written;
+    if (model->bytes_per_cycle != 0) {
+        unsigned long traffic = (stats.misses + blocks_written) * block_bytes;
+        unsigned long bound = (traffic + model->bytes_per_cycle - 1) /
+                              model->bytes_per_cycle;
+        if (bound > cycles) {
+            cycles = bound;
+        }
+    }
+    return cycles;
+}
+
+/**
+ * @brief Records the statistics of a simulated trace in its job.
+ */
+static void record_stats(eval_job_t *job, const eval_pool_t *pool,
+                         csim_t *sims[2], size_t count) {
+    csim_stats(sims[0], &job->stats);
+    if (pool->model != NULL) {
+        job->cost = model_cycles(pool->model, sims[count - 1], pool->b);
+    }
+}
+
+/**
+ * @brief Simulates a transpose function's trace while it is generated.
+ *
+ * tracegen-ct writes the trace to /dev/fd/TRACE_PIPE_FD, the write end of
+ * a pipe whose read end feeds the simulator library, so the trace never
+ * touches the disk unless dump_name is given.
+ *
+ * @param[in]  out       Stream the report goes to
+ * @param[in]  i         Index of the transpose function to use
+ * @param[in]  pool      Cache geometry to simulate
+ * @param[in]  dump_name Binary trace file to save the trace to, or NULL
+ * @param[out] job       Job the statistics are recorded in
+ *
+ * @return True if the function succeeded, and false otherwise
+ */
+static bool stream_trace(FILE *out, int i, const eval_pool_t *pool,
+                         const char *dump_name, eval_job_t *job) {
+    char trace_path[FILENAME_BUFSIZE];
+    snprintf(trace_path, sizeof(trace_path), "/dev/fd/%d", TRACE_PIPE_FD);
+
+    csim_t *sims[2];
+    size_t sim_count = create_sims(out, pool, sims);
+    if (sim_count == 0) {
         return false;
     }
 
-    if (WEXITSTATUS(status) != 0) {
-        printf("Validation error at function %d! Run ./tracegen-ct -v -M "
-               "%zd -N %zd -F %d for details.\n",
-               i, M, N, i);
-        printf("Exit status %d\n", WEXITSTATUS(status));
+    int fds[2];
+    pid_t pid;
+    pthread_mutex_lock(&spawn_lock);
+    bool piped = open_trace_pipe(fds);
+    bool spawned = piped && spawn_tracegen(out, trace_path, i, fds[1], &pid);
+    pthread_mutex_unlock(&spawn_lock);
+    if (!piped) {
+        fprintf(out, "Failed to create the trace pipe: %s\n",
+                strerror(errno));
+        destroy_sims(sims, sim_count);
+        return false;
+    }
+
+    /* tracegen-ct now holds the only write end, the trace ends as it exits */
+    close(fds[1]);
+    if (!spawned) {
+        close(fds[0]);
+        destroy_sims(sims, sim_count);
         return false;
     }
 
+    traceWriter_t dump;
+    bool dumping = false;
+    bool dumped = true;
+    if (dump_name != NULL) {
+        dumping = traceWriterOpen(&dump, dump_name, true);
+        dumped = dumping;
+    }
+
+    traceReader_t reader;
+    bool read = traceReaderOpenFd(&reader, fds[0]);
+    if (read) {
+        if (!csim_run_readers(sims, sim_count, &reader,
+                              dumping ? &dump : NULL)) {
+            dumped = false;
+        }
+        traceReaderClose(&reader);
+    }
+    if (dumping && !traceWriterClose(&dump)) {
+        dumped = false;
+    }
+
+    /* A function that failed validation may have left a partial trace */
+    if (!wait_tracegen(out, pid, trace_path, i)) {
+        destroy_sims(sims, sim_count);
+        return false;
+    }
+    if (!read) {
+        fprintf(out, "Cache simulator error.  Unable to read trace from "
+                     "tracegen-ct\n");
+        destroy_sims(sims, sim_count);
+        return false;
+    }
+    if (!dumped) {
+        fprintf(out, "Warning: unable to save the trace to %s\n", dump_name);
+    }
+
+    record_stats(job, pool, sims, sim_count);
+    destroy_sims(sims, sim_count);
     return true;
 }
 
 /**
- * @brief Compute statistics for a trace using the reference simulator.
+ * @brief Compute statistics for a trace with the in-process simulator.
+ *
+ * The simulator library models the same LRU cache as csim-ref, so this
+ * gives csim-ref's results without running it and reading them back from
+ * the results file.
  *
+ * @param[in]  out       Stream the report goes to
  * @param[in]  file_name File name where the trace is be stored
- * @param[in]  s         log2 of the number of sets
- * @param[in]  E         associativity
- * @param[in]  b         log2 of the block size
- * @param[out] stats     Statistics computed from the trace file
+ * @param[in]  pool      Cache geometry to simulate and cost model
+ * @param[out] job       Job the statistics are recorded in
  *
  * @return True if the function succeeded, and false otherwise
  */
-static bool compute_stats(const char *file_name, unsigned int s, unsigned int E,
-                          unsigned int b, csim_stats_t *stats) {
-    char cmd[CMD_BUFSIZE];
-    snprintf(cmd, sizeof(cmd), "./csim-ref -s %u -E %u -b %u -t %s > /dev/null",
-             s, E, b, file_name);
-
-    int status = system(cmd);
-    if (status < 0) {
-        printf("Failed to run csim-ref: %s\n", strerror(errno));
+static bool compute_stats(FILE *out, const char *file_name,
+                          const eval_pool_t *pool, eval_job_t *job) {
+    csim_t *sims[2];
+    size_t sim_count = create_sims(out, pool, sims);
+    if (sim_count == 0) {
         return false;
     }
 
-    int flag = WEXITSTATUS(status);
-    if (flag != 0) {
-        printf("Cache simulator error.  The reference simulator exited "
-               "with value %d\n",
-               flag);
+    traceReader_t reader;
+    if (!traceReaderOpen(&reader, file_name)) {
+        fprintf(out, "Cache simulator error.  Unable to read trace %s\n",
+                file_name);
+        destroy_sims(sims, sim_count);
         return false;
     }
+    (void)csim_run_readers(sims, sim_count, &reader, NULL);
+    traceReaderClose(&reader);
 
-    /* Collect results from the reference simulator */
-    bool success = loadSummary(stats);
-    if (!success) {
-        printf("Cache simulator error.  Simulator generated invalid "
-               "results\n");
-        return false;
+    record_stats(job, pool, sims, sim_count);
+    destroy_sims(sims, sim_count);
+    return true;
+}
+
+/**
+ * @brief Evaluates one transpose function, reporting to a stream.
+ *
+ * The trace is removed once simulated, so a run over many functions never
+ * holds more than one trace per worker on disk.
+ */
+static void eval_func(eval_job_t *job, const eval_pool_t *pool, FILE *out) {
+    int i = job->funcid;
+
+    /* Run and generate a trace file */
+    char file_name[FILENAME_BUFSIZE];
+    snprintf(file_name, sizeof(file_name), "trace.f%d.%ld", i, (long)getpid());
+
+    fprintf(out, "\nFunction %d out of %d (%s)\n", i, func_counter,
+            func_list[i].description);
+
+    if (pool->streamed) {
+        /* Validate and simulate in one go, saving the trace if asked to */
+        char dump_name[FILENAME_BUFSIZE];
+        snprintf(dump_name, sizeof(dump_name), "trace.f%d.bin", i);
+        fprintf(out, "Step 1: Validating and streaming memory traces\n");
+        fprintf(out, "Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n",
+                pool->s, pool->E, pool->b);
+        if (!stream_trace(out, i, pool, pool->dumped ? dump_name : NULL,
+                          job)) {
+            return;
+        }
+    } else {
+        fprintf(out, "Step 1: Validating and generating memory traces\n");
+
+        if (!generate_trace(out, file_name, i)) {
+            remove(file_name);
+            return;
+        }
+
+        /* Run the reference simulator */
+        fprintf(out, "Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n",
+                pool->s, pool->E, pool->b);
+        bool success = compute_stats(out, file_name, pool, job);
+        remove(file_name);
+        if (!success) {
+            return;
+        }
     }
 
-    return true;
+    /* Mark this function as correct */
+    fprintf(out,
+            "Results for func %d (%s): hits:%ld, misses:%ld, evictions:%ld, "
+            "clock_cycles:%ld\n",
+            i, func_list[i].description, job->stats.hits, job->stats.misses,
+            job->stats.evictions,
+            get_clock_cycles(job->stats.hits, job->stats.misses));
+    if (pool->model != NULL) {
+        fprintf(out, "Cost of func %d under the %s model: cycles:%lu\n", i,
+                pool->model->name, job->cost);
+    }
+    job->correct = true;
+}
+
+/**
+ * @brief Worker thread, evaluates unclaimed jobs into their own buffers.
+ */
+static void *eval_worker(void *arg) {
+    eval_pool_t *pool = arg;
+
+    for (;;) {
+        int k = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_RELAXED);
+        if (k >= pool->job_count) {
+            return NULL;
+        }
+        eval_job_t *job = &pool->jobs[k];
+        FILE *out = open_memstream(&job->output, &job->output_size);
+        if (out == NULL) {
+            continue;
+        }
+        eval_func(job, pool, out);
+        if (fclose(out) != 0) {
+            job->correct = false;
+        }
+    }
 }
 
 /**
  * @brief Evaluate the performance of the registered transpose functions
+ *
+ * @param[in] s               log2 of the number of sets
+ * @param[in] E               associativity
+ * @param[in] b               log2 of the block size
+ * @param[in] submission_only Only evaluate the submitted function
+ * @param[in] workers         Number of functions evaluated at once
+ * @param[in] streamed        Pipe traces straight into the simulator
+ * @param[in] dumped          Also save streamed traces in binary
+ * @param[in] model           Cost model to also score with, or NULL
+ * @param[out] job_count      Number of jobs evaluated
+ *
+ * @return The evaluated jobs, which the caller frees, or NULL
  */
-static void eval_perf(unsigned int s, unsigned int E, unsigned int b,
-                      bool submission_only) {
+static eval_job_t *eval_perf(unsigned int s, unsigned int E, unsigned int b,
+                             bool submission_only, int workers,
+                             bool streamed, bool dumped,
+                             const cost_model_t *model, int *job_count) {
+    eval_pool_t pool = {NULL, 0, 0, s, E, b, streamed, dumped, model};
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
 
     registerFunctions();
 
-    /* Evaluate the performance of each registered transpose function */
+    /* Queue every function to test, in registration order */
+    *job_count = 0;
+    pool.jobs = calloc((size_t)func_counter + 1, sizeof(eval_job_t));
+    if (pool.jobs == NULL) {
+        printf("Error: unable to allocate the evaluation jobs\n");
+        return NULL;
+    }
     for (int i = 0; i < func_counter; i++) {
         /* Remember if this function is the submission */
         if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0) {
@@ -144,52 +736,557 @@ static void eval_perf(unsigned int s, unsigned int E, unsigned int b,
         if (submission_only && results.funcid != i) {
             continue;
         }
+        pool.jobs[pool.job_count++].funcid = i;
+    }
 
-        /* Run and generate a trace file */
-        char file_name[FILENAME_BUFSIZE];
-        sprintf(file_name, "trace.f%d", i);
+    /* Evaluate in place, or on worker threads and report afterwards */
+    if (workers > pool.job_count) {
+        workers = pool.job_count;
+    }
+    if (workers <= 1) {
+        for (int k = 0; k < pool.job_count; k++) {
+            eval_func(&pool.jobs[k], &pool, stdout);
+        }
+    } else {
+        while (started < workers &&
+               pthread_create(&threads[started], NULL, eval_worker, &pool) ==
+                   0) {
+            started++;
+        }
+        /* The calling thread mops up if not every worker started */
+        if (started == 0) {
+            eval_worker(&pool);
+        }
+        for (int t = 0; t < started; t++) {
+            pthread_join(threads[t], NULL);
+        }
+    }
 
-        printf("\nFunction %d out of %d (%s)\n", i, func_counter,
-               func_list[i].description);
-        printf("Step 1: Validating and generating memory traces\n");
+    for (int k = 0; k < pool.job_count; k++) {
+        eval_job_t *job = &pool.jobs[k];
+        if (workers > 1) {
+            if (job->output != NULL) {
+                fwrite(job->output, 1, job->output_size, stdout);
+            } else {
+                printf("\nFunction %d out of %d (%s)\n"
+                       "Error: unable to buffer the evaluation report\n",
+                       job->funcid, func_counter,
+                       func_list[job->funcid].description);
+            }
+            free(job->output);
+        }
+
+        /* If it is transpose_submit(), record number of misses */
+        if (results.funcid == job->funcid && job->correct) {
+            memcpy(&results.stats, &job->stats, sizeof(results.stats));
+            results.cost = job->cost;
+            results.correct = true;
+        }
+    }
+    *job_count = pool.job_count;
+    return pool.jobs;
+}
+
+/**
+ * @brief Sizes the flush buffer from the largest cache the C library knows.
+ *
+ * @return FLUSH_MARGIN times that cache in bytes, or FLUSH_BYTES if the
+ *         size of none is known
+ */
+static size_t flush_size(void) {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    static const int levels[] = {_SC_LEVEL4_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE,
+                                 _SC_LEVEL2_CACHE_SIZE};
+    for (size_t k = 0; k < sizeof(levels) / sizeof(levels[0]); k++) {
+        long size = sysconf(levels[k]);
+        if (size > 0) {
+            return FLUSH_MARGIN * (size_t)size;
+        }
+    }
+#endif
+    return FLUSH_BYTES;
+}
+
+/**
+ * @brief Allocates and initializes the buffers of native runs.
+ *
+ * The matrices are sized like tracegen-ct's, so functions that assume a
+ * multiple of their tile size do not run off the end either. The flush
+ * buffer is written once: pages never written all map the one zero page,
+ * and reading them would evict nothing.
+ *
+ * @param[out] bufs Buffers allocated
+ *
+ * @return True on success, and false if an allocation failed
+ */
+static bool native_alloc(native_bufs_t *bufs) {
+    memset(bufs, 0, sizeof(*bufs));
+    bufs->flush_bytes = flush_size();
+    if (posix_memalign((void **)&bufs->A, 64,
+                       MAXN * MAXN * sizeof(double)) != 0 ||
+        posix_memalign((void **)&bufs->B, 64,
+                       MAXN * MAXN * sizeof(double)) != 0 ||
+        posix_memalign((void **)&bufs->tmp, 64,
+                       TMPCOUNT * sizeof(double)) != 0 ||
+        (bufs->flush = malloc(bufs->flush_bytes)) == NULL) {
+        free(bufs->A);
+        free(bufs->B);
+        free(bufs->tmp);
+        return false;
+    }
+    memset(bufs->flush, 1, bufs->flush_bytes);
+    initMatrix(M, N, (double(*)[M])bufs->A, (double(*)[N])bufs->B);
+    return true;
+}
+
+/**
+ * @brief Releases the buffers of native_alloc.
+ */
+static void native_free(native_bufs_t *bufs) {
+    free(bufs->A);
+    free(bufs->B);
+    free(bufs->tmp);
+    free(bufs->flush);
+}
+
+/**
+ * @brief Evicts the matrices from every cache level by reading a buffer
+ *        larger than the last-level cache.
+ *
+ * @param[in] bufs Buffers of the native runs
+ */
+static void flush_caches(const native_bufs_t *bufs) {
+    unsigned char sum = 0;
+    for (size_t k = 0; k < bufs->flush_bytes; k += FLUSH_STRIDE) {
+        sum = (unsigned char)(sum + bufs->flush[k]);
+    }
+    flush_sink = sum;
+}
+
+/**
+ * @brief Reads the time stamp counter, 0 where there is none.
+ */
+static unsigned long long read_tsc(void) {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
 
-        if (!generate_trace(file_name, i)) {
+/**
+ * @brief Reads the monotonic clock in seconds.
+ */
+static double read_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Times one transpose function natively and reports its speed.
+ *
+ * The caches are flushed before every run, so each run starts from memory
+ * just as the simulated one starts from an empty cache. The report gives
+ * the bandwidth of the fastest run, counting each double read and written
+ * once, and its time stamp counter cycles per element.
+ *
+ * @param[in] func  Function to time
+ * @param[in] id    Label of the function in the report
+ * @param[in] runs  Number of timed runs
+ * @param[in] A     Source matrix, already initialized
+ * @param[in] B     Destination matrix
+ * @param[in] tmp   Temporary array
+ * @param[in] bufs  Buffers of the native runs, flushed between them
+ */
+static void time_func(const trans_func_t *func, const char *id, int runs,
+                      double A[N][M], double B[M][N], double *tmp,
+                      const native_bufs_t *bufs) {
+    double best = 0.0;
+    double total = 0.0;
+    unsigned long long best_ticks = 0;
+    double elements = (double)M * (double)N;
+    double bytes = 2.0 * elements * (double)sizeof(double);
+    bool correct = true;
+
+    printf("\nFunction %s (%s)\n", id, func->description);
+    memset(B, 0, M * N * sizeof(double));
+    for (int run = 0; run < runs; run++) {
+        flush_caches(bufs);
+        double start = read_seconds();
+        unsigned long long start_ticks = read_tsc();
+        (*func->func_ptr)(M, N, A, B, tmp);
+        unsigned long long ticks = read_tsc() - start_ticks;
+        double elapsed = read_seconds() - start;
+
+        if (run == 0) {
+            for (size_t i = 0; i < N && correct; i++) {
+                for (size_t j = 0; j < M && correct; j++) {
+                    correct = (A[i][j] == B[j][i]);
+                }
+            }
+            if (!correct) {
+                printf("Error: incorrect result, not timed\n");
+                return;
+            }
+        }
+        if (run == 0 || elapsed < best) {
+            best = elapsed;
+            best_ticks = ticks;
+        }
+        total += elapsed;
+    }
+
+    printf("native: best_ms:%.3f mean_ms:%.3f GB/s:%.2f", best * 1e3,
+           total / runs * 1e3, bytes / (best > 0.0 ? best : 1e-9) / 1e9);
+    if (best_ticks != 0) {
+        printf(" cycles/element:%.2f", (double)best_ticks / elements);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Times every transpose function natively.
+ *
+ * The register-blocked kernels of trans-simd.c are timed after the
+ * registered functions, except with -s.
+ *
+ * @param[in] submission_only Only time the submitted function
+ * @param[in] runs            Number of timed runs of each function
+ */
+static void time_perf(bool submission_only, int runs) {
+    trans_func_t kernels[TRANS_SIMD_MAX_KERNELS];
+    size_t kernel_count = 0;
+    native_bufs_t bufs;
+
+    registerFunctions();
+
+    if (!native_alloc(&bufs)) {
+        printf("Error: unable to allocate the timed matrices\n");
+        return;
+    }
+    double *A = bufs.A;
+    double *B = bufs.B;
+    double *tmp = bufs.tmp;
+
+    for (int i = 0; i < func_counter; i++) {
+        char id[16];
+        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0) {
+            results.funcid = i;
+        }
+        if (submission_only && results.funcid != i) {
             continue;
         }
+        snprintf(id, sizeof(id), "%d", i);
+        time_func(&func_list[i], id, runs, (double(*)[M])A, (double(*)[N])B,
+                  tmp, &bufs);
+    }
+    if (!submission_only) {
+        kernel_count = trans_simd_kernels(kernels);
+    }
+    for (size_t k = 0; k < kernel_count; k++) {
+        char id[16];
+        snprintf(id, sizeof(id), "simd%zu", k);
+        time_func(&kernels[k], id, runs, (double(*)[M])A, (double(*)[N])B,
+                  tmp, &bufs);
+    }
 
-        /* Run the reference simulator */
-        csim_stats_t stats;
+    native_free(&bufs);
+}
+
+/**
+ * @brief Opens a counter of this process for every event of hw_events.
+ *
+ * Counters count user space only and are opened separately rather than as
+ * a group, so an event the CPU or kernel lacks leaves the others working,
+ * and the kernel multiplexes them if there are more than the PMU holds.
+ * They also count the threads the process starts, such as those of
+ * transpose_parallel, which the kernel adds in as each thread exits.
+ *
+ * @param[out] counters Counters opened, with the errno of those that failed
+ */
+static void hw_open(hw_counters_t *counters) {
+    for (size_t k = 0; k < HW_EVENT_COUNT; k++) {
+#ifdef HW_COUNTERS
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = hw_events[k].type;
+        attr.config = hw_events[k].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counters->fds[k] =
+            (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        counters->errors[k] = (counters->fds[k] < 0) ? errno : 0;
+#else
+        counters->fds[k] = -1;
+        counters->errors[k] = ENOSYS;
+#endif
+    }
+}
+
+/**
+ * @brief Closes the counters of hw_open.
+ */
+static void hw_close(hw_counters_t *counters) {
+    for (size_t k = 0; k < HW_EVENT_COUNT; k++) {
+        if (counters->fds[k] >= 0) {
+            close(counters->fds[k]);
+        }
+    }
+}
 
-        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        if (!compute_stats(file_name, s, E, b, &stats)) {
+/**
+ * @brief Zeroes and starts, or stops, every open counter.
+ */
+static void hw_enable(const hw_counters_t *counters, bool enable) {
+#ifdef HW_COUNTERS
+    for (size_t k = 0; k < HW_EVENT_COUNT; k++) {
+        if (counters->fds[k] < 0) {
             continue;
         }
+        if (enable) {
+            ioctl(counters->fds[k], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[k], PERF_EVENT_IOC_ENABLE, 0);
+        } else {
+            ioctl(counters->fds[k], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+#endif
+}
 
-        (void)remove(".csim_results");
+/**
+ * @brief Reads a stopped counter, scaled up for the time it was
+ *        multiplexed out.
+ *
+ * @param[in]  counters Open counters
+ * @param[in]  k        Index of the event in hw_events
+ * @param[out] value    Events counted
+ *
+ * @return False if the counter is not open or never ran
+ */
+static bool hw_read(const hw_counters_t *counters, size_t k,
+                    unsigned long long *value) {
+    /* Count, then time enabled and time running, per read_format */
+    uint64_t data[3];
+
+    if (counters->fds[k] < 0 ||
+        read(counters->fds[k], data, sizeof(data)) != (ssize_t)sizeof(data) ||
+        data[2] == 0) {
+        return false;
+    }
+    *value = (unsigned long long)((double)data[0] * (double)data[1] /
+                                  (double)data[2]);
+    return true;
+}
 
-        /* Mark this function as correct */
-        printf("Results for func %d (%s): hits:%ld, misses:%ld, evictions:%ld, "
-               "clock_cycles:%ld\n",
-               i, func_list[i].description, stats.hits, stats.misses,
-               stats.evictions, get_clock_cycles(stats.hits, stats.misses));
+/**
+ * @brief Runs one simulated transpose function under the hardware
+ *        counters and reports both.
+ *
+ * The caches are flushed before every run, as for -t, so every counted run
+ * starts from memory as the simulated one starts cold. Each event is
+ * reported as the fewest any run counted, since interrupts and other noise
+ * only add events. The native loads and stores also include the
+ * function's own stack traffic, which the trace leaves out.
+ *
+ * @param[in] job      Evaluation of the function on the Haswell L1
+ * @param[in] runs     Number of counted runs
+ * @param[in] bufs     Buffers of the native runs
+ * @param[in] counters Open counters
+ */
+static void count_func(const eval_job_t *job, int runs,
+                       const native_bufs_t *bufs,
+                       const hw_counters_t *counters) {
+    const trans_func_t *func = &func_list[job->funcid];
+    unsigned long long best[HW_EVENT_COUNT];
+    bool counted[HW_EVENT_COUNT] = {false};
 
-        /* If it is transpose_submit(), record number of misses */
-        if (results.funcid == i) {
-            memcpy(&results.stats, &stats, sizeof(results.stats));
-            results.correct = true;
+    memset(bufs->B, 0, M * N * sizeof(double));
+    for (int run = 0; run < runs; run++) {
+        flush_caches(bufs);
+        hw_enable(counters, true);
+        (*func->func_ptr)(M, N, (double(*)[M])bufs->A,
+                          (double(*)[N])bufs->B, bufs->tmp);
+        hw_enable(counters, false);
+        for (size_t k = 0; k < HW_EVENT_COUNT; k++) {
+            unsigned long long value;
+            if (hw_read(counters, k, &value) &&
+                (!counted[k] || value < best[k])) {
+                best[k] = value;
+                counted[k] = true;
+            }
+        }
+    }
+
+    unsigned long accesses = job->stats.hits + job->stats.misses;
+    printf("\nFunction %d (%s), fewest events of %d runs\n", job->funcid,
+           func->description, runs);
+    printf("simulated: accesses:%lu hits:%lu misses:%lu evictions:%lu "
+           "dirty_bytes_evicted:%lu\n",
+           accesses, job->stats.hits, job->stats.misses,
+           job->stats.evictions, job->stats.dirty_evictions);
+    printf("measured:");
+    for (size_t k = 0; k < HW_EVENT_COUNT; k++) {
+        if (counted[k]) {
+            printf(" %s:%llu", hw_events[k].name, best[k]);
+        } else {
+            printf(" %s:n/a", hw_events[k].name);
+        }
+    }
+    printf("\n");
+
+    /* Miss rates over the accesses whose misses were counted too */
+    unsigned long long l1d_accesses = 0;
+    unsigned long long l1d_misses = 0;
+    if (counted[HW_L1D_LOADS] && counted[HW_L1D_LOAD_MISSES]) {
+        l1d_accesses += best[HW_L1D_LOADS];
+        l1d_misses += best[HW_L1D_LOAD_MISSES];
+    }
+    if (counted[HW_L1D_STORES] && counted[HW_L1D_STORE_MISSES]) {
+        l1d_accesses += best[HW_L1D_STORES];
+        l1d_misses += best[HW_L1D_STORE_MISSES];
+    }
+    printf("l1d_miss_rate: simulated:%.4f",
+           (double)job->stats.misses / (double)(accesses ? accesses : 1));
+    if (l1d_accesses != 0) {
+        printf(" measured:%.4f",
+               (double)l1d_misses / (double)l1d_accesses);
+    } else {
+        printf(" measured:n/a");
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Runs every correctly simulated function under the hardware
+ *        counters.
+ *
+ * @param[in] jobs      Evaluations on the Haswell L1
+ * @param[in] job_count Number of evaluations
+ * @param[in] runs      Number of counted runs of each function
+ */
+static void count_perf(const eval_job_t *jobs, int job_count, int runs) {
+    native_bufs_t bufs;
+    hw_counters_t counters;
+    size_t open_count = 0;
+
+    if (!native_alloc(&bufs)) {
+        printf("Error: unable to allocate the counted matrices\n");
+        return;
+    }
+    hw_open(&counters);
+    for (size_t k = 0; k < HW_EVENT_COUNT; k++) {
+        if (counters.fds[k] >= 0) {
+            open_count++;
         }
     }
+    printf("\nHardware counters (%zu of %d events available)\n", open_count,
+           HW_EVENT_COUNT);
+    if (open_count == 0) {
+        printf("Warning: unable to open hardware counters: %s\n",
+               strerror(counters.errors[HW_CYCLES]));
+    }
+
+    for (int k = 0; k < job_count; k++) {
+        if (jobs[k].correct) {
+            count_func(&jobs[k], runs, &bufs, &counters);
+        }
+    }
+
+    hw_close(&counters);
+    native_free(&bufs);
+}
+
+/**
+ * @brief Looks up the cost model named or spelled out by -c.
+ *
+ * @param[in] spec Name of a model in cost_models, or
+ *                 hit,miss,write,bandwidth[,policy] with policy as
+ *                 given to csim -w
+ *
+ * @return The model, or NULL if spec is invalid
+ */
+static const cost_model_t *parse_cost_model(const char *spec) {
+    for (size_t k = 0; k < sizeof(cost_models) / sizeof(cost_models[0]);
+         k++) {
+        if (strcmp(spec, cost_models[k].name) == 0) {
+            return &cost_models[k];
+        }
+    }
+
+    unsigned long *fields[] = {&custom_model.hit_cycles,
+                               &custom_model.miss_cycles,
+                               &custom_model.write_cycles,
+                               &custom_model.bytes_per_cycle};
+    size_t field_count = sizeof(fields) / sizeof(fields[0]);
+    const char *p = spec;
+    for (size_t k = 0; k < field_count; k++) {
+        char *end;
+        if (*p < '0' || *p > '9') {
+            return NULL;
+        }
+        errno = 0;
+        *fields[k] = strtoul(p, &end, 10);
+        if (errno != 0 ||
+            (*end != ',' && (*end != '\0' || k + 1 < field_count))) {
+            return NULL;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    custom_model.description = spec;
+    custom_model.write_policy = (*p != '\0') ? p : NULL;
+
+    /* Reject a bad policy now rather than in every evaluation */
+    if (custom_model.write_policy != NULL) {
+        csim_t *sim = csim_create(0, 1, 0, NULL);
+        bool valid = sim != NULL &&
+                     csim_set_write_policy(sim, custom_model.write_policy);
+        csim_destroy(sim);
+        if (!valid) {
+            return NULL;
+        }
+    }
+    return &custom_model;
 }
 
 /**
  * @brief Print usage info
  */
 static void usage(char *argv[]) {
-    printf("Usage: %s [-h] [-s] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-h] [-s] [-l] [-p] [-d] [-c <model>] [-j <jobs>] "
+           "[-e <runs>] [-t <runs>] -M <rows> -N <cols>\n",
+           argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
     printf("  -s          Check official submission only.\n");
     printf("  -l          Simulate large (Haswell L1) cache\n");
+    printf("  -j <jobs>   Evaluate up to this many functions at once (max "
+           "%d)\n",
+           MAX_WORKERS);
+    printf("  -p          Stream traces into the simulator, no trace files\n");
+    printf("  -d          Like -p, also saving traces in binary as "
+           "trace.f<N>.bin\n");
+    printf("  -c <model>  Also score with a cost model, one of:\n");
+    for (size_t k = 0; k < sizeof(cost_models) / sizeof(cost_models[0]);
+         k++) {
+        printf("                %-13s %s\n", cost_models[k].name,
+               cost_models[k].description);
+    }
+    printf("              or hit,miss,write,bandwidth[,policy] cycles, "
+           "bytes per cycle\n"
+           "              and a csim -w write policy\n");
+    printf("  -e <runs>   Simulate on the Haswell L1 and compare with "
+           "hardware counters\n"
+           "              of this many native runs (max %d)\n",
+           MAX_COUNTED_RUNS);
+    printf("  -t <runs>   Time functions natively, fastest of this many runs "
+           "(max %d)\n",
+           MAX_TIMED_RUNS);
     printf("  -M <rows>   Number of destination matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of destination matrix columns (max %d)\n",
            MAXN);
@@ -227,8 +1324,18 @@ int main(int argc, char *argv[]) {
 
     bool submission_only = false;
     bool use_large_cache = false;
+    int workers = 1;
+    bool streamed = false;
+    bool dumped = false;
+    bool timed = false;
+    int timed_runs = 0;
+    const cost_model_t *model = NULL;
+    bool counted = false;
+    int counted_runs = 0;
+    eval_job_t *jobs;
+    int job_count;
 
-    while ((c = getopt(argc, argv, "hcslM:N:")) != -1) {
+    while ((c = getopt(argc, argv, "hslpdc:j:e:t:M:N:")) != -1) {
         switch (c) {
         case 'M':
             M = (size_t)atoi(optarg);
@@ -242,6 +1349,32 @@ int main(int argc, char *argv[]) {
         case 'l':
             use_large_cache = true;
             break;
+        case 'p':
+            streamed = true;
+            break;
+        case 'd':
+            streamed = true;
+            dumped = true;
+            break;
+        case 'c':
+            model = parse_cost_model(optarg);
+            if (model == NULL) {
+                printf("Error: unknown cost model %s\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            break;
+        case 'j':
+            workers = atoi(optarg);
+            break;
+        case 'e':
+            counted = true;
+            counted_runs = atoi(optarg);
+            break;
+        case 't':
+            timed = true;
+            timed_runs = atoi(optarg);
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -263,6 +1396,30 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
+    if (workers < 1 || workers > MAX_WORKERS) {
+        printf("Error: -j must be between 1 and %d\n", MAX_WORKERS);
+        usage(argv);
+        exit(1);
+    }
+
+    if (timed && (timed_runs < 1 || timed_runs > MAX_TIMED_RUNS)) {
+        printf("Error: -t must be between 1 and %d\n", MAX_TIMED_RUNS);
+        usage(argv);
+        exit(1);
+    }
+
+    if (counted && (counted_runs < 1 || counted_runs > MAX_COUNTED_RUNS)) {
+        printf("Error: -e must be between 1 and %d\n", MAX_COUNTED_RUNS);
+        usage(argv);
+        exit(1);
+    }
+
+    if (counted && timed) {
+        printf("Error: -e and -t are exclusive\n");
+        usage(argv);
+        exit(1);
+    }
+
     /* Install SIGSEGV and SIGALRM handlers */
     if (signal(SIGSEGV, sigsegv_handler) == SIG_ERR) {
         fprintf(stderr, "Unable to install SIGALRM handler\n");
@@ -277,16 +1434,31 @@ int main(int argc, char *argv[]) {
     /* Time out and give up after a while */
     alarm(360);
 
+    /* Time natively rather than grading */
+    if (timed) {
+        time_perf(submission_only, timed_runs);
+        return 0;
+    }
+
     /* Check the performance of the student's transpose function */
-    if (use_large_cache) {
-        /* Use Haswell L1 cache */
-        eval_perf(HASWELL_L1_SET, HASWELL_L1_ASSOC, HASWELL_L1_BLOCK,
-                  submission_only);
+    if (use_large_cache || counted) {
+        /* Use Haswell L1 cache, which the hardware counters measure */
+        jobs = eval_perf(HASWELL_L1_SET, HASWELL_L1_ASSOC, HASWELL_L1_BLOCK,
+                         submission_only, workers, streamed, dumped, model,
+                         &job_count);
     } else {
         /* Use original cache otherwise */
-        eval_perf(TEST_LOG_SET, TEST_ASSOC, TEST_LOG_BLOCK, submission_only);
+        jobs = eval_perf(TEST_LOG_SET, TEST_ASSOC, TEST_LOG_BLOCK,
+                         submission_only, workers, streamed, dumped, model,
+                         &job_count);
     }
 
+    /* Measure on this machine what was just simulated */
+    if (counted && jobs != NULL) {
+        count_perf(jobs, job_count, counted_runs);
+    }
+    free(jobs);
+
     /* Emit the results for this particular test */
     if (results.funcid == -1) {
         printf("\nError: We could not find your transpose_submit() function\n");
@@ -300,16 +1472,14 @@ int main(int argc, char *argv[]) {
                "cycles=%ld\n",
                results.funcid, results.correct,
                get_clock_cycles(results.stats.hits, results.stats.misses));
+        if (model != NULL && results.correct) {
+            printf("Cost of official submission under the %s model: "
+                   "cycles=%lu\n",
+                   model->name, results.cost);
+        }
         printf("\nTEST_TRANS_RESULTS=%d:%ld\n", results.correct,
                get_clock_cycles(results.stats.hits, results.stats.misses));
     }
 
-    /* Remove hidden trace files */
-    for (int i = 0; i < MAX_TRANS_FUNCS; i++) {
-        char traceFile[FILENAME_BUFSIZE];
-        snprintf(traceFile, sizeof(traceFile), "trace.f%d", i);
-        remove(traceFile);
-    }
-
     return status;
 }
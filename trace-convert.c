@@ -0,0 +1,109 @@
+/**
+ * @file trace-convert.c
+ * @brief Converts traces between the text and packed binary formats
+ *
+ * The input format is detected from the file itself, and by default the
+ * output is written in the other format, so the same command packs a text
+ * trace and unpacks a binary one:
+ *
+ *     ./trace-convert -t traces/csim/long.trace -o long.btrace
+ *     ./trace-convert -t long.btrace -o long.trace
+ *
+ * Both formats are read natively by csim -t.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csim-trace.h"
+
+/**
+ * @brief Print usage info
+ */
+static void usage(char *argv[]) {
+    printf("Usage: %s [-h] [-f text|binary] -t <input> -o <output>\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h             Print this help message.\n");
+    printf("  -f <format>    Output format, the opposite of the input by "
+           "default\n");
+    printf("  -t <input>     Trace to convert, text or binary\n");
+    printf("  -o <output>    Converted trace, '-' for standard output\n");
+}
+
+/**
+ * @brief Main routine
+ */
+int main(int argc, char *argv[]) {
+    const char *inputName = NULL;
+    const char *outputName = NULL;
+    const char *format = NULL;
+    traceReader_t reader;
+    traceWriter_t writer;
+    traceRecord_t record;
+    bool bBinaryOutput;
+    bool bSuccess = true;
+    int c;
+
+    while ((c = getopt(argc, argv, "hf:t:o:")) != -1) {
+        switch (c) {
+        case 'f':
+            format = optarg;
+            break;
+        case 't':
+            inputName = optarg;
+            break;
+        case 'o':
+            outputName = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if ((inputName == NULL) || (outputName == NULL)) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+    if ((format != NULL) && (strcmp(format, "text") != 0) &&
+        (strcmp(format, "binary") != 0)) {
+        printf("Error: Unknown output format '%s'\n", format);
+        usage(argv);
+        exit(1);
+    }
+
+    if (!traceReaderOpen(&reader, inputName)) {
+        fprintf(stderr, "Error: Unable to open trace '%s'\n", inputName);
+        exit(1);
+    }
+    bBinaryOutput = (format != NULL) ? (strcmp(format, "binary") == 0)
+                                     : !reader.bBinary;
+    if (!traceWriterOpen(&writer, outputName, bBinaryOutput)) {
+        fprintf(stderr, "Error: Unable to create trace '%s'\n", outputName);
+        traceReaderClose(&reader);
+        exit(1);
+    }
+
+    while (bSuccess && traceReaderNext(&reader, &record)) {
+        bSuccess = traceWriterPut(&writer, &record);
+    }
+    if (!bSuccess) {
+        fprintf(stderr, "Error: Record %lu could not be written: %c %lx,%d\n",
+                (unsigned long)writer.iRecordCount, record.accessType,
+                record.address, record.byteSize);
+    }
+
+    bSuccess = traceWriterClose(&writer) && bSuccess;
+    traceReaderClose(&reader);
+    return bSuccess ? 0 : 1;
+}
@@ -8,6 +8,9 @@
  * all of the accesses together.
  */
 
+/* posix_memalign is POSIX, not C99 */
+#define _POSIX_C_SOURCE 200809L
+
 #include "cachelab.h"
 #include <assert.h>
 #include <getopt.h>
@@ -24,57 +27,102 @@
 extern void __roi_begin(void);
 extern void __roi_end(void);
 
-/* Need to make sure A and B start on cache block boundaries */
-static double bigA[MAXN][MAXN] __attribute__((aligned(64)));
-static double bigT[TMPCOUNT] __attribute__((aligned(64)));
-static double bigB[MAXN][MAXN] __attribute__((aligned(64)));
-static double bigAcopy[MAXN][MAXN];
-static double bigBtarg[MAXN][MAXN];
+/* Rows past the end of B checked for out-of-bounds writes */
+#define GUARD_ROWS 10
+
+/* A is padded to a multiple of this many bytes, which is larger than the
+   index range of any cache the lab simulates, so A, tmp and B map to the
+   same sets as if they were MAXN x MAXN arrays placed one after the other */
+#define REGION_ALIGN (1UL << 20)
+
+/* Columns of A validated together, so the strided reads of A share lines */
+#define VALIDATE_TILE 32
+
+/* Matrices sized to M x N, allocated once by allocate_matrices. A and B
+   start on cache block boundaries, and tmp sits between them */
+static double *bigA;
+static double *bigT;
+static double *bigB;
+static double *bigAcopy;
 static size_t M;
 static size_t N;
 
-bool validate(int fn, double A[N][M], double Acopy[N][M], double B[M][N],
-              double Btarg[M][N]) {
-    size_t i, j;
-    size_t xM = M + 10;
-    if (xM > MAXN)
-        xM = MAXN;
-    for (i = 0; i < M; i++) {
-        for (j = 0; j < N; j++) {
-            if (B[i][j] != Btarg[i][j]) {
-                fprintf(stderr,
-                        "Validation failed on function %d! Expected %.3f but "
-                        "got %.3f at B[%zd][%zd]\n",
-                        fn, Btarg[i][j], B[i][j], i, j);
-                return false;
-            }
-        }
+/**
+ * @brief Allocates the matrices for M x N.
+ *
+ * A, tmp and B share one allocation, with GUARD_ROWS zeroed rows after B.
+ * Only these bytes are cleared, so the padding after A is never touched and
+ * costs address space only.
+ *
+ * @return False if the allocation failed.
+ */
+static bool allocate_matrices(void) {
+    size_t a_bytes = M * N * sizeof(double);
+    size_t a_region = ((a_bytes + REGION_ALIGN - 1) / REGION_ALIGN) *
+                      REGION_ALIGN;
+    size_t t_bytes = TMPCOUNT * sizeof(double);
+    size_t b_bytes = (M + GUARD_ROWS) * N * sizeof(double);
+    void *arena;
+
+    if (posix_memalign(&arena, 64, a_region + t_bytes + b_bytes) != 0) {
+        return false;
+    }
+    bigA = arena;
+    bigT = (double *)((char *)arena + a_region);
+    bigB = bigT + TMPCOUNT;
+    bigAcopy = malloc(a_bytes);
+    if (bigAcopy == NULL) {
+        free(arena);
+        return false;
     }
+    memset(bigA, 0, a_bytes);
+    memset(bigT, 0, t_bytes + b_bytes);
+    return true;
+}
 
-    /* Look for changes to A */
-    for (j = 0; j < N; j++) {
+/**
+ * @brief Checks a function's result in one sweep over B and its guard rows.
+ *
+ * B must be the transpose of the saved copy of A, A must still equal the
+ * copy, and the GUARD_ROWS rows after B must still be zero.
+ */
+bool validate(int fn, double A[N][M], double Acopy[N][M],
+              double B[M + GUARD_ROWS][N]) {
+    size_t i, j, jj;
+    for (jj = 0; jj < N; jj += VALIDATE_TILE) {
+        size_t j_end = (jj + VALIDATE_TILE < N) ? jj + VALIDATE_TILE : N;
         for (i = 0; i < M; i++) {
-            if (A[j][i] != Acopy[j][i]) {
-                fprintf(
-                    stderr,
-                    "Validation failed on function %d! A[%zd][%zd] corrupted\n",
-                    fn, j, i);
-                return false;
+            for (j = jj; j < j_end; j++) {
+                if (B[i][j] != Acopy[j][i]) {
+                    fprintf(stderr,
+                            "Validation failed on function %d! Expected %.3f "
+                            "but got %.3f at B[%zd][%zd]\n",
+                            fn, Acopy[j][i], B[i][j], i, j);
+                    return false;
+                }
+                /* Look for changes to A */
+                if (A[j][i] != Acopy[j][i]) {
+                    fprintf(stderr,
+                            "Validation failed on function %d! A[%zd][%zd] "
+                            "corrupted\n",
+                            fn, j, i);
+                    return false;
+                }
             }
         }
-    }
-
-    /* Look for out of bounds writes to B, scanning a few more rows */
-    for (i = M; i < xM; i++)
-        for (j = 0; j < N; j++) {
-            if (B[i][j] != 0) {
-                fprintf(stderr,
-                        "Validation failed on function %d! Out-of-bounds write "
-                        "to B[%zd][%zd]\n",
-                        fn, i, j);
-                return false;
+        /* Look for out of bounds writes to B, scanning a few more rows */
+        for (i = M; i < M + GUARD_ROWS; i++) {
+            for (j = jj; j < j_end; j++) {
+                if (B[i][j] != 0) {
+                    fprintf(stderr,
+                            "Validation failed on function %d! Out-of-bounds "
+                            "write to B[%zd][%zd]\n",
+                            fn, i, j);
+                    return false;
+                }
             }
         }
+    }
     return true;
 }
 
@@ -149,36 +197,37 @@ int entry(int argc, char *argv[]) {
     /*  Register transpose functions */
     registerFunctions();
 
-    /* Clear out matrices */
-    memset(bigA, 0, sizeof(bigA));
-    memset(bigB, 0, sizeof(bigB));
+    /* Allocate cleared matrices */
+    if (!allocate_matrices()) {
+        fprintf(stderr, "Error: unable to allocate the matrices\n");
+        exit(1);
+    }
+    double(*A)[M] = (double(*)[M])bigA;
+    double(*B)[N] = (double(*)[N])bigB;
+    double(*Acopy)[M] = (double(*)[M])bigAcopy;
 
     /* Fill A with data */
-    initMatrix(M, N, bigA, bigB);
-    /* Make copy of A */
-    memset(bigAcopy, 0, sizeof(bigAcopy));
-    copyMatrix(M, N, bigAcopy, bigA);
-    /* Generate target version */
-    memset(bigBtarg, 0, sizeof(bigBtarg));
-    correctTrans(M, N, bigA, bigBtarg);
+    initMatrix(M, N, A, B);
+    /* Make copy of A, which is also the target of B transposed */
+    copyMatrix(M, N, Acopy, A);
 
     if (-1 == selectedFunc) {
         /* Invoke registered transpose functions */
         for (i = 0; i < func_counter; i++) {
-            memset(bigT, 0, sizeof(bigT));
+            memset(bigT, 0, TMPCOUNT * sizeof(double));
             __roi_begin();
-            (*func_list[i].func_ptr)(M, N, bigA, bigB, bigT);
+            (*func_list[i].func_ptr)(M, N, A, B, bigT);
             __roi_end();
-            if (!validate(i, bigA, bigAcopy, bigB, bigBtarg)) {
+            if (!validate(i, A, Acopy, B)) {
                 return i + 1;
             }
         }
     } else {
-        memset(bigT, 0, sizeof(bigT));
+        memset(bigT, 0, TMPCOUNT * sizeof(double));
         __roi_begin();
-        (*func_list[selectedFunc].func_ptr)(M, N, bigA, bigB, bigT);
+        (*func_list[selectedFunc].func_ptr)(M, N, A, B, bigT);
         __roi_end();
-        if (!validate(selectedFunc, bigA, bigAcopy, bigB, bigBtarg)) {
+        if (!validate(selectedFunc, A, Acopy, B)) {
             return 1;
         }
     }
@@ -0,0 +1,154 @@
+/**
+ * @file trans-kernel.h
+ * @brief Tiled transpose kernel shared by trans.c and trans-tune
+ *
+ * The kernel recursively splits A into tiles and copies each tile into B as
+ * a trans_plan_t describes. It does all of its element accesses through
+ * hooks, which the including file defines before including this header:
+ *
+ *   TRANS_KERNEL_PARAMS    Parameter list of every kernel function
+ *   TRANS_KERNEL_ARGS      The same parameters passed on as arguments
+ *   TRANS_COPY(i, j)       Copies A[i][j] to B[j][i]
+ *   TRANS_STAGE(k, i, j)   Copies A[i][j] to tmp[k]
+ *   TRANS_UNSTAGE(k, j, i) Copies tmp[k] to B[j][i]
+ *
+ * trans.c defines them as the copies themselves, trans-tune as simulated
+ * accesses to the addresses tracegen-ct would load and store, so the plans
+ * trans-tune scores are exactly what transpose_submit runs.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef TRANS_KERNEL_H
+#define TRANS_KERNEL_H
+
+#include "cachelab.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Doubles per cache line of the graded caches */
+#define TRANS_LINE_DOUBLES 8
+
+/** @brief Diagonal handling of trans_plan_t diagonal */
+#define TRANS_DIAGONAL_DIRECT 0 /* Copy the diagonal in order */
+#define TRANS_DIAGONAL_DEFER 1  /* Copy it after the rest of its row of A */
+
+/** @brief tmp staging of trans_plan_t staging */
+#define TRANS_STAGING_NONE 0     /* Copy every tile straight into B */
+#define TRANS_STAGING_DIAGONAL 1 /* Stage the tiles crossing the diagonal */
+#define TRANS_STAGING_ALL 2      /* Stage every tile */
+
+/**
+ * @brief How the kernel transposes a matrix.
+ *
+ * A staged tile is first copied row by row from A to tmp, then column by
+ * column from tmp to B, so A and B are never accessed in turn. Staging needs
+ * tile_rows * tile_cols to be at most TMPCOUNT.
+ */
+typedef struct {
+    unsigned int tile_rows; /* Rows of A in the largest tile */
+    unsigned int tile_cols; /* Columns of A in the largest tile */
+    unsigned int diagonal;  /* TRANS_DIAGONAL_* of unstaged tiles */
+    unsigned int staging;   /* TRANS_STAGING_* */
+} trans_plan_t;
+
+/**
+ * @brief Splits a range of rows or columns in two halves.
+ *
+ * Long ranges are split on a multiple of TRANS_LINE_DOUBLES, so every tile
+ * starts on a cache line of A and B, short ones in the middle.
+ *
+ * @param[in]     length    Number of rows or columns, more than one
+ *
+ * @return Length of the first half, between 1 and length - 1.
+ */
+static inline size_t trans_kernel_split(size_t length) {
+    size_t half = ((length / 2 + TRANS_LINE_DOUBLES - 1) / TRANS_LINE_DOUBLES) *
+                  TRANS_LINE_DOUBLES;
+
+    if ((length <= TRANS_LINE_DOUBLES) || (half >= length)) {
+        half = length / 2;
+    }
+    return half;
+}
+
+/**
+ * @brief Transposes one tile of A.
+ *
+ * @param[in]     row       First row of A in the tile
+ * @param[in]     rows      Number of rows of A in the tile
+ * @param[in]     col       First column of A in the tile
+ * @param[in]     cols      Number of columns of A in the tile
+ * @param[in]     plan      Plan the tile is transposed with
+ *
+ * @return void.
+ */
+static inline void trans_kernel_tile(TRANS_KERNEL_PARAMS, size_t row,
+                                     size_t rows, size_t col, size_t cols,
+                                     trans_plan_t plan) {
+    bool diagonal = (row < col + cols) && (col < row + rows);
+
+    if ((plan.staging == TRANS_STAGING_ALL) ||
+        ((plan.staging == TRANS_STAGING_DIAGONAL) && diagonal)) {
+        for (size_t i = row; i < row + rows; i++) {
+            for (size_t j = col; j < col + cols; j++) {
+                TRANS_STAGE((i - row) * cols + (j - col), i, j);
+            }
+        }
+        for (size_t j = col; j < col + cols; j++) {
+            for (size_t i = row; i < row + rows; i++) {
+                TRANS_UNSTAGE((i - row) * cols + (j - col), j, i);
+            }
+        }
+        return;
+    }
+
+    for (size_t i = row; i < row + rows; i++) {
+        for (size_t j = col; j < col + cols; j++) {
+            if ((i != j) || (plan.diagonal == TRANS_DIAGONAL_DIRECT)) {
+                TRANS_COPY(i, j);
+            }
+        }
+        /* A[i][i] and B[i][i] share a set of a direct-mapped cache, storing
+           the diagonal element last keeps A's row in it until then */
+        if ((plan.diagonal == TRANS_DIAGONAL_DEFER) && (i >= col) &&
+            (i < col + cols)) {
+            TRANS_COPY(i, i);
+        }
+    }
+}
+
+/**
+ * @brief Recursively transposes a tile of A of any shape.
+ *
+ * The longer side of the tile is halved until it is at most plan.tile_rows
+ * by plan.tile_cols, which fits in the cache whatever the size of A, so each
+ * line of A and B is brought in about once.
+ *
+ * @param[in]     row       First row of A in the tile
+ * @param[in]     rows      Number of rows of A in the tile
+ * @param[in]     col       First column of A in the tile
+ * @param[in]     cols      Number of columns of A in the tile
+ * @param[in]     plan      Plan the tile is transposed with
+ *
+ * @return void.
+ */
+static void trans_kernel_recurse(TRANS_KERNEL_PARAMS, size_t row, size_t rows,
+                                 size_t col, size_t cols, trans_plan_t plan) {
+    if ((rows <= plan.tile_rows) && (cols <= plan.tile_cols)) {
+        trans_kernel_tile(TRANS_KERNEL_ARGS, row, rows, col, cols, plan);
+    } else if ((rows > plan.tile_rows) &&
+               ((rows >= cols) || (cols <= plan.tile_cols))) {
+        size_t half = trans_kernel_split(rows);
+        trans_kernel_recurse(TRANS_KERNEL_ARGS, row, half, col, cols, plan);
+        trans_kernel_recurse(TRANS_KERNEL_ARGS, row + half, rows - half, col,
+                             cols, plan);
+    } else {
+        size_t half = trans_kernel_split(cols);
+        trans_kernel_recurse(TRANS_KERNEL_ARGS, row, rows, col, half, plan);
+        trans_kernel_recurse(TRANS_KERNEL_ARGS, row, rows, col + half,
+                             cols - half, plan);
+    }
+}
+
+#endif /* TRANS_KERNEL_H */
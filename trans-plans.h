@@ -0,0 +1,24 @@
+/**
+ * @file trans-plans.h
+ * @brief Transpose plans picked by trans-tune, do not edit
+ *
+ * Generated by: ./trans-tune -o trans-plans.h 32:32:5:1:6 1024:1024:6:8:6
+ */
+
+#ifndef TRANS_PLANS_H
+#define TRANS_PLANS_H
+
+#include "trans-kernel.h"
+
+/*
+ * PLAN(M, N, s, E, b, tile_rows, tile_cols, diagonal, staging)
+ *   32x32 on s=5 E=1 b=6: 35456 cycles
+ *   1024x1024 on s=6 E=8 b=6: 33751040 cycles
+ */
+#define TRANS_TUNED_PLANS(PLAN)                                                \
+    PLAN(32, 32, 5, 1, 6, 16, 8, TRANS_DIAGONAL_DEFER,                         \
+         TRANS_STAGING_NONE)                                                   \
+    PLAN(1024, 1024, 6, 8, 6, 8, 4, TRANS_DIAGONAL_DIRECT,                     \
+         TRANS_STAGING_NONE)
+
+#endif /* TRANS_PLANS_H */
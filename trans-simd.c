@@ -0,0 +1,201 @@
+/**
+ * @file trans-simd.c
+ * @brief Register-blocked vector transpose kernels for native timing
+ *
+ * The AVX2 kernel transposes 4 x 4 blocks of doubles held in four ymm
+ * registers. It pairs rows with unpacks, then swaps 128-bit lanes with
+ * permutes. The AVX-512 kernel transposes 8 x 8 blocks held in eight zmm
+ * registers with unpacks and then two rounds of 128-bit lane shuffles.
+ *
+ * Blocks are visited tile by tile, TRANS_SIMD_TILE doubles a side, so the
+ * lines of B that a tile writes stay in L1 until they are full. Rows and
+ * columns past the last full block are copied one double at a time.
+ *
+ * The kernels keep doubles in registers and move 32 or 64 bytes per
+ * access. trans.c's rules forbid both, and tracegen-ct traces 8-byte
+ * accesses, so the kernels are never registered with the driver. Like the
+ * probe kernels of csim-probe.c, each is built with a per-function target
+ * attribute and only offered when the running CPU supports it.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+/* Importing header files */
+#include "trans-simd.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TRANS_SIMD_X86 1
+#endif
+
+/* Defines */
+#define TRANS_SIMD_TILE 32
+/* _mm512_shuffle_f64x2 selectors of lanes 0, 2 or 1, 3 of each source */
+#define TRANS_SIMD_EVEN_LANES _MM_SHUFFLE(2, 0, 2, 0)
+#define TRANS_SIMD_ODD_LANES _MM_SHUFFLE(3, 1, 3, 1)
+
+/* Function prototyping */
+static void trans_simd_edges(size_t M, size_t N, double A[N][M],
+                             double B[M][N], size_t rows, size_t cols);
+#ifdef TRANS_SIMD_X86
+static void trans_avx2(size_t M, size_t N, double A[N][M], double B[M][N],
+                       double tmp[TMPCOUNT]);
+static void trans_avx512(size_t M, size_t N, double A[N][M], double B[M][N],
+                         double tmp[TMPCOUNT]);
+#endif
+
+/**
+ * @brief Lists the kernels the running CPU supports.
+ *
+ * @param[out] kernels Supported kernels, widest vectors last
+ *
+ * @return Number of kernels listed, 0 on CPUs without AVX2.
+ */
+size_t trans_simd_kernels(trans_func_t kernels[TRANS_SIMD_MAX_KERNELS]) {
+    size_t count = 0;
+
+#ifdef TRANS_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels[count].func_ptr = trans_avx2;
+        kernels[count++].description = "AVX2 4x4 register-blocked transpose";
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels[count].func_ptr = trans_avx512;
+        kernels[count++].description =
+            "AVX-512 8x8 register-blocked transpose";
+    }
+#endif
+    return count;
+}
+
+/**
+ * @brief Copies the elements of A outside its leading rows x cols block.
+ *
+ * @param[in]     M         Width of A, height of B
+ * @param[in]     N         Height of A, width of B
+ * @param[in]     A         Source matrix
+ * @param[out]    B         Destination matrix
+ * @param[in]     rows      Rows of A the vector loop transposed
+ * @param[in]     cols      Columns of A the vector loop transposed
+ */
+static void trans_simd_edges(size_t M, size_t N, double A[N][M],
+                             double B[M][N], size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = cols; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+    for (size_t i = rows; i < N; i++) {
+        for (size_t j = 0; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+#ifdef TRANS_SIMD_X86
+/**
+ * @brief AVX2 kernel, transposes 4 x 4 blocks in registers.
+ *
+ * As in csim-probe.c, the upper register halves are cleared by hand before
+ * the scalar edge loops.
+ */
+__attribute__((target("avx2"))) static void
+trans_avx2(size_t M, size_t N, double A[N][M], double B[M][N],
+           double tmp[TMPCOUNT]) {
+    size_t rows = N - N % 4;
+    size_t cols = M - M % 4;
+
+    for (size_t ti = 0; ti < rows; ti += TRANS_SIMD_TILE) {
+        size_t i_end = (ti + TRANS_SIMD_TILE < rows) ? ti + TRANS_SIMD_TILE
+                                                     : rows;
+        for (size_t tj = 0; tj < cols; tj += TRANS_SIMD_TILE) {
+            size_t j_end = (tj + TRANS_SIMD_TILE < cols) ? tj + TRANS_SIMD_TILE
+                                                         : cols;
+            for (size_t i = ti; i < i_end; i += 4) {
+                for (size_t j = tj; j < j_end; j += 4) {
+                    __m256d r0 = _mm256_loadu_pd(&A[i][j]);
+                    __m256d r1 = _mm256_loadu_pd(&A[i + 1][j]);
+                    __m256d r2 = _mm256_loadu_pd(&A[i + 2][j]);
+                    __m256d r3 = _mm256_loadu_pd(&A[i + 3][j]);
+                    /* t0 = a00 a10 a02 a12, t1 = a01 a11 a03 a13, ... */
+                    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+                    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+                    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+                    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+                    _mm256_storeu_pd(&B[j][i],
+                                     _mm256_permute2f128_pd(t0, t2, 0x20));
+                    _mm256_storeu_pd(&B[j + 1][i],
+                                     _mm256_permute2f128_pd(t1, t3, 0x20));
+                    _mm256_storeu_pd(&B[j + 2][i],
+                                     _mm256_permute2f128_pd(t0, t2, 0x31));
+                    _mm256_storeu_pd(&B[j + 3][i],
+                                     _mm256_permute2f128_pd(t1, t3, 0x31));
+                }
+            }
+        }
+    }
+    _mm256_zeroupper();
+    trans_simd_edges(M, N, A, B, rows, cols);
+}
+
+/**
+ * @brief AVX-512 kernel, transposes 8 x 8 blocks in registers.
+ *
+ * After the unpacks, 128-bit lane k of t[2p] holds the block's elements
+ * [2p][2k] and [2p+1][2k], and lane k of t[2p+1] holds [2p][2k+1] and
+ * [2p+1][2k+1]. Two rounds of lane shuffles then gather lane k of every even
+ * t into column 2k of B's block, and of every odd t into column 2k+1.
+ */
+__attribute__((target("avx512f"))) static void
+trans_avx512(size_t M, size_t N, double A[N][M], double B[M][N],
+             double tmp[TMPCOUNT]) {
+    size_t rows = N - N % 8;
+    size_t cols = M - M % 8;
+
+    for (size_t ti = 0; ti < rows; ti += TRANS_SIMD_TILE) {
+        size_t i_end = (ti + TRANS_SIMD_TILE < rows) ? ti + TRANS_SIMD_TILE
+                                                     : rows;
+        for (size_t tj = 0; tj < cols; tj += TRANS_SIMD_TILE) {
+            size_t j_end = (tj + TRANS_SIMD_TILE < cols) ? tj + TRANS_SIMD_TILE
+                                                         : cols;
+            for (size_t i = ti; i < i_end; i += 8) {
+                for (size_t j = tj; j < j_end; j += 8) {
+                    __m512d t[8];
+                    __m512d u[4];
+                    __m512d c[4];
+                    for (size_t r = 0; r < 8; r += 2) {
+                        __m512d lo = _mm512_loadu_pd(&A[i + r][j]);
+                        __m512d hi = _mm512_loadu_pd(&A[i + r + 1][j]);
+                        t[r] = _mm512_unpacklo_pd(lo, hi);
+                        t[r + 1] = _mm512_unpackhi_pd(lo, hi);
+                    }
+                    for (size_t odd = 0; odd < 2; odd++) {
+                        u[0] = _mm512_shuffle_f64x2(t[odd], t[odd + 2],
+                                                    TRANS_SIMD_EVEN_LANES);
+                        u[1] = _mm512_shuffle_f64x2(t[odd], t[odd + 2],
+                                                    TRANS_SIMD_ODD_LANES);
+                        u[2] = _mm512_shuffle_f64x2(t[odd + 4], t[odd + 6],
+                                                    TRANS_SIMD_EVEN_LANES);
+                        u[3] = _mm512_shuffle_f64x2(t[odd + 4], t[odd + 6],
+                                                    TRANS_SIMD_ODD_LANES);
+                        c[0] = _mm512_shuffle_f64x2(u[0], u[2],
+                                                    TRANS_SIMD_EVEN_LANES);
+                        c[1] = _mm512_shuffle_f64x2(u[1], u[3],
+                                                    TRANS_SIMD_EVEN_LANES);
+                        c[2] = _mm512_shuffle_f64x2(u[0], u[2],
+                                                    TRANS_SIMD_ODD_LANES);
+                        c[3] = _mm512_shuffle_f64x2(u[1], u[3],
+                                                    TRANS_SIMD_ODD_LANES);
+                        for (size_t k = 0; k < 4; k++) {
+                            _mm512_storeu_pd(&B[j + 2 * k + odd][i], c[k]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    _mm256_zeroupper();
+    trans_simd_edges(M, N, A, B, rows, cols);
+}
+#endif
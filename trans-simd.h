@@ -0,0 +1,24 @@
+/**
+ * @file trans-simd.h
+ * @brief Register-blocked vector transpose kernels for native timing
+ *
+ * On x86-64 CPUs with AVX2 or AVX-512 these kernels transpose whole blocks
+ * of doubles in vector registers. They take the arguments of a trans.c
+ * function, so test-trans -t times them alongside the registered ones.
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#ifndef TRANS_SIMD_H
+#define TRANS_SIMD_H
+
+#include "cachelab.h"
+#include <stddef.h>
+
+/** @brief Upper limit on the kernels trans_simd_kernels returns */
+#define TRANS_SIMD_MAX_KERNELS 2
+
+/* Function prototyping */
+size_t trans_simd_kernels(trans_func_t kernels[TRANS_SIMD_MAX_KERNELS]);
+
+#endif /* TRANS_SIMD_H */
@@ -0,0 +1,342 @@
+/**
+ * @file trans-tune.c
+ * @brief Searches for the fastest transpose plan of each matrix size
+ *
+ * For every M:N:s:E:b target, each plan of the search space is run through
+ * the kernel of trans-kernel.h against an in-process simulator of the s, E,
+ * b cache. The kernel loads and stores the addresses tracegen-ct traces,
+ * with A, tmp and B laid out one after the other like tracegen-ct's bigA,
+ * bigT and bigB, and each plan is scored with get_clock_cycles.
+ *
+ * The search covers tile shapes, diagonal handling and tmp staging. The
+ * fastest plan of each target, the one with the largest tiles on a tie, is
+ * written as the table transpose_submit dispatches on:
+ *
+ *     ./trans-tune -o trans-plans.h 32:32:5:1:6 1024:1024:6:8:6
+ *
+ * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cachelab.h"
+#include "csim-lib.h"
+
+/** @brief Simulated address of A, tmp and B follow it */
+#define TUNE_A_BASE 0x40000000UL
+
+/** @brief Maximum number of targets tuned in one run */
+#define MAX_TARGETS 16
+
+/* Matrix size and cache geometry a plan is tuned for */
+typedef struct {
+    size_t M;       /* Width of A, height of B */
+    size_t N;       /* Height of A, width of B */
+    unsigned int s; /* Number of set index bits */
+    unsigned int E; /* Number of lines per set */
+    unsigned int b; /* Number of block bits */
+} tune_target_t;
+
+/* Simulated run of the kernel */
+typedef struct {
+    csim_t *sim; /* Cache the accesses are simulated in */
+    size_t M;    /* Width of A, height of B */
+    size_t N;    /* Height of A, width of B */
+} tune_run_t;
+
+/* Function prototyping */
+static void tune_copy(tune_run_t *run, unsigned long from, unsigned long to);
+
+/* Addresses tracegen-ct would trace, see the file comment */
+#define TUNE_A(run, i, j) (TUNE_A_BASE + ((i) * (run)->M + (j)) * 8UL)
+#define TUNE_TMP(run, k) (TUNE_A_BASE + (MAXN * MAXN + (k)) * 8UL)
+#define TUNE_B(run, j, i)                                                      \
+    (TUNE_A_BASE + (MAXN * MAXN + TMPCOUNT + (j) * (run)->N + (i)) * 8UL)
+
+/* Kernel hooks, see trans-kernel.h */
+#define TRANS_KERNEL_PARAMS tune_run_t *run
+#define TRANS_KERNEL_ARGS run
+#define TRANS_COPY(i, j) tune_copy(run, TUNE_A(run, i, j), TUNE_B(run, j, i))
+#define TRANS_STAGE(k, i, j) tune_copy(run, TUNE_A(run, i, j), TUNE_TMP(run, k))
+#define TRANS_UNSTAGE(k, j, i)                                                 \
+    tune_copy(run, TUNE_TMP(run, k), TUNE_B(run, j, i))
+#include "trans-kernel.h"
+
+/**
+ * @brief Tile sides searched, largest first so that ties go to the plan with
+ * the fewest tiles. Staged tiles of 16 x 16 just fill tmp.
+ */
+static const unsigned int tile_sides[] = {16, 8, 4, 2, 1};
+
+/** @brief Names of TRANS_DIAGONAL_* and TRANS_STAGING_* */
+static const char *const diagonal_names[] = {"TRANS_DIAGONAL_DIRECT",
+                                             "TRANS_DIAGONAL_DEFER"};
+static const char *const staging_names[] = {
+    "TRANS_STAGING_NONE", "TRANS_STAGING_DIAGONAL", "TRANS_STAGING_ALL"};
+
+/**
+ * @brief Simulates copying one double.
+ *
+ * @param[in,out] run  Simulated run
+ * @param[in]     from Address loaded
+ * @param[in]     to   Address stored
+ */
+static void tune_copy(tune_run_t *run, unsigned long from, unsigned long to) {
+    csim_access(run->sim, 'L', from);
+    csim_access(run->sim, 'S', to);
+}
+
+/**
+ * @brief Scores a plan on a target.
+ *
+ * @param[in]  target Matrix size and cache geometry
+ * @param[in]  plan   Plan to score
+ * @param[out] cycles Clock cycles of the plan's trace
+ *
+ * @return False if the simulator could not be created.
+ */
+static bool score_plan(const tune_target_t *target, trans_plan_t plan,
+                       unsigned long *cycles) {
+    tune_run_t run = {NULL, target->M, target->N};
+    csim_stats_t stats;
+
+    run.sim = csim_create(target->s, target->E, target->b, NULL);
+    if (run.sim == NULL)
+        return false;
+    trans_kernel_recurse(&run, 0, target->N, 0, target->M, plan);
+    csim_stats(run.sim, &stats);
+    csim_destroy(run.sim);
+    *cycles = get_clock_cycles(stats.hits, stats.misses);
+    return true;
+}
+
+/**
+ * @brief Finds the fastest plan of a target.
+ *
+ * Staged tiles never use the diagonal handling, so staged plans are only
+ * scored with TRANS_DIAGONAL_DIRECT.
+ *
+ * @param[in]  target  Matrix size and cache geometry
+ * @param[in]  verbose Print the score of every plan to stderr
+ * @param[out] best    Fastest plan
+ * @param[out] cycles  Its clock cycles
+ *
+ * @return False if the simulator could not be created.
+ */
+static bool tune_target(const tune_target_t *target, bool verbose,
+                        trans_plan_t *best, unsigned long *cycles) {
+    size_t sides = sizeof(tile_sides) / sizeof(tile_sides[0]);
+    bool found = false;
+
+    for (size_t r = 0; r < sides; r++) {
+        for (size_t c = 0; c < sides; c++) {
+            for (unsigned int variant = 0; variant < 4; variant++) {
+                trans_plan_t plan = {tile_sides[r], tile_sides[c],
+                                     TRANS_DIAGONAL_DIRECT, TRANS_STAGING_NONE};
+                unsigned long score;
+                if (variant == 1)
+                    plan.diagonal = TRANS_DIAGONAL_DEFER;
+                else if (variant > 1)
+                    plan.staging = variant - 1;
+                if (plan.tile_rows * plan.tile_cols > TMPCOUNT)
+                    continue;
+                if (!score_plan(target, plan, &score))
+                    return false;
+                if (verbose)
+                    fprintf(stderr, "%zux%zu: %2ux%-2u %s %s %lu cycles\n",
+                            target->M, target->N, plan.tile_rows,
+                            plan.tile_cols, diagonal_names[plan.diagonal],
+                            staging_names[plan.staging], score);
+                if (!found || (score < *cycles)) {
+                    *best = plan;
+                    *cycles = score;
+                    found = true;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a M:N:s:E:b target.
+ *
+ * @param[in]  spec   Target as given on the command line
+ * @param[out] target Parsed target
+ *
+ * @return False if the target is malformed or out of range.
+ */
+static bool parse_target(const char *spec, tune_target_t *target) {
+    unsigned long fields[5];
+    const char *p = spec;
+
+    for (size_t k = 0; k < 5; k++) {
+        char *end;
+        fields[k] = strtoul(p, &end, 10);
+        if ((end == p) || (*end != ((k < 4) ? ':' : '\0')))
+            return false;
+        p = end + 1;
+    }
+    if ((fields[0] < 1) || (fields[0] > MAXN) || (fields[1] < 1) ||
+        (fields[1] > MAXN) || (fields[2] > 32) || (fields[4] > 32) ||
+        (fields[3] < 1) || (fields[3] > 1024))
+        return false;
+    target->M = fields[0];
+    target->N = fields[1];
+    target->s = (unsigned int)fields[2];
+    target->E = (unsigned int)fields[3];
+    target->b = (unsigned int)fields[4];
+    return true;
+}
+
+/**
+ * @brief Writes the plan table.
+ *
+ * @param[in] out     Stream the table goes to
+ * @param[in] argc    Arguments of the run, quoted in the table
+ * @param[in] argv    Arguments of the run
+ * @param[in] targets Tuned targets
+ * @param[in] plans   Fastest plan of each
+ * @param[in] cycles  Clock cycles of each
+ * @param[in] count   Number of targets
+ */
+static void write_table(FILE *out, int argc, char *argv[],
+                        const tune_target_t *targets,
+                        const trans_plan_t *plans,
+                        const unsigned long *cycles, size_t count) {
+    fprintf(out, "/**\n");
+    fprintf(out, " * @file trans-plans.h\n");
+    fprintf(out, " * @brief Transpose plans picked by trans-tune, do not "
+                 "edit\n");
+    fprintf(out, " *\n");
+    fprintf(out, " * Generated by:");
+    for (int i = 0; i < argc; i++)
+        fprintf(out, " %s", argv[i]);
+    fprintf(out, "\n */\n\n");
+    fprintf(out, "#ifndef TRANS_PLANS_H\n#define TRANS_PLANS_H\n\n");
+    fprintf(out, "#include \"trans-kernel.h\"\n\n");
+    fprintf(out, "/*\n");
+    fprintf(out, " * PLAN(M, N, s, E, b, tile_rows, tile_cols, diagonal, "
+                 "staging)\n");
+    for (size_t k = 0; k < count; k++)
+        fprintf(out, " *   %zux%zu on s=%u E=%u b=%u: %lu cycles\n",
+                targets[k].M, targets[k].N, targets[k].s, targets[k].E,
+                targets[k].b, cycles[k]);
+    fprintf(out, " */\n");
+    fprintf(out, "%-78s \\\n", "#define TRANS_TUNED_PLANS(PLAN)");
+    for (size_t k = 0; k < count; k++) {
+        char line[128];
+        snprintf(line, sizeof(line),
+                 "    PLAN(%zu, %zu, %u, %u, %u, %u, %u, %s,", targets[k].M,
+                 targets[k].N, targets[k].s, targets[k].E, targets[k].b,
+                 plans[k].tile_rows, plans[k].tile_cols,
+                 diagonal_names[plans[k].diagonal]);
+        fprintf(out, "%-78s \\\n", line);
+        snprintf(line, sizeof(line), "         %s)",
+                 staging_names[plans[k].staging]);
+        if (k + 1 < count)
+            fprintf(out, "%-78s \\\n", line);
+        else
+            fprintf(out, "%s\n", line);
+    }
+    fprintf(out, "\n#endif /* TRANS_PLANS_H */\n");
+}
+
+/**
+ * @brief Print usage info
+ */
+static void usage(char *argv[]) {
+    printf("Usage: %s [-hv] [-o <file>] <M:N:s:E:b>...\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h             Print this help message.\n");
+    printf("  -v             Print the score of every plan to stderr\n");
+    printf("  -o <file>      Plan table, standard output by default\n");
+    printf("  <M:N:s:E:b>    Matrix size and cache geometry to tune for\n");
+    printf("Example: %s -o trans-plans.h 32:32:%d:%d:%d 1024:1024:%d:%d:%d\n",
+           argv[0], TEST_LOG_SET, TEST_ASSOC, TEST_LOG_BLOCK, HASWELL_L1_SET,
+           HASWELL_L1_ASSOC, HASWELL_L1_BLOCK);
+}
+
+/**
+ * @brief Main routine
+ */
+int main(int argc, char *argv[]) {
+    tune_target_t targets[MAX_TARGETS];
+    trans_plan_t plans[MAX_TARGETS];
+    unsigned long cycles[MAX_TARGETS];
+    const char *outputName = NULL;
+    bool verbose = false;
+    size_t count = 0;
+    FILE *out = stdout;
+    int c;
+
+    while ((c = getopt(argc, argv, "hvo:")) != -1) {
+        switch (c) {
+        case 'v':
+            verbose = true;
+            break;
+        case 'o':
+            outputName = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (optind == argc) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+    for (int i = optind; i < argc; i++) {
+        if (count == MAX_TARGETS) {
+            printf("Error: At most %d targets can be tuned\n", MAX_TARGETS);
+            exit(1);
+        }
+        if (!parse_target(argv[i], &targets[count])) {
+            printf("Error: Invalid target '%s'\n", argv[i]);
+            usage(argv);
+            exit(1);
+        }
+        /* transpose_submit only knows the matrix size */
+        for (size_t k = 0; k < count; k++) {
+            if ((targets[k].M == targets[count].M) &&
+                (targets[k].N == targets[count].N)) {
+                printf("Error: %zux%zu is tuned twice\n", targets[k].M,
+                       targets[k].N);
+                exit(1);
+            }
+        }
+        count++;
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        if (!tune_target(&targets[k], verbose, &plans[k], &cycles[k])) {
+            printf("Error: Invalid cache geometry in '%s'\n",
+                   argv[optind + (int)k]);
+            exit(1);
+        }
+    }
+
+    if (outputName != NULL) {
+        out = fopen(outputName, "w");
+        if (out == NULL) {
+            perror(outputName);
+            exit(1);
+        }
+    }
+    write_table(out, argc, argv, targets, plans, cycles, count);
+    if ((out != stdout) && (fclose(out) != 0)) {
+        perror(outputName);
+        exit(1);
+    }
+    return 0;
+}
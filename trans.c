@@ -29,15 +29,65 @@
  * @author Abhishek Basrithaya <abasrith@andrew.cmu.edu>
  */
 
+/* pthreads and sysconf are POSIX, not C99 */
+#define _POSIX_C_SOURCE 200809L
+
 #include "cachelab.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <unistd.h>
+
+/* Kernel hooks, see trans-kernel.h */
+#define TRANS_KERNEL_PARAMS                                                    \
+    size_t M, size_t N, double A[N][M], double B[M][N], double tmp[TMPCOUNT]
+#define TRANS_KERNEL_ARGS M, N, A, B, tmp
+#define TRANS_COPY(i, j) (B[(j)][(i)] = A[(i)][(j)])
+#define TRANS_STAGE(k, i, j) (tmp[(k)] = A[(i)][(j)])
+#define TRANS_UNSTAGE(k, j, i) (B[(j)][(i)] = tmp[(k)])
+#include "trans-kernel.h"
+#include "trans-plans.h"
 
 /* Global variables */
 unsigned int BlockSize = 8;
-unsigned int Matrix_Dimension_32x32 = 32;
-unsigned int Matrix_Dimension_1024x1024 = 1024;
+
+/* Rows of B this many bytes apart share their sets in both graded caches */
+unsigned int Aliasing_Stride = 512;
+
+/* Threads of the parallel transpose, 0 for one per online CPU; the traced
+   build, compiled with TRANS_TRACED, always uses one */
+unsigned int Parallel_Threads = 0;
+
+/* Matrices with fewer elements are transposed on the calling thread */
+size_t Parallel_Min_Elements = 256 * 256;
+
+/** @brief Rows of B in each band of the parallel transpose, a multiple of
+           BlockSize; narrower bands walk A in strips too thin to prefetch */
+#define PARALLEL_BAND_ROWS 64
+
+/** @brief Upper limit on the threads of the parallel transpose */
+#define PARALLEL_MAX_THREADS 64
+
+/** @brief Bands of B shared by the threads of the parallel transpose */
+typedef struct {
+    size_t M;                          /* Width of A, height of B */
+    size_t N;                          /* Height of A, width of B */
+    double *A;                         /* Source matrix */
+    double *B;                         /* Destination matrix */
+    double *tmp;                       /* Temporary memory */
+    trans_plan_t plan;                 /* Plan every band runs */
+    size_t band_count;                 /* Bands of B */
+    unsigned int thread_count;         /* Threads taking bands */
+    size_t next[PARALLEL_MAX_THREADS]; /* Next band of each thread */
+    size_t end[PARALLEL_MAX_THREADS];  /* End of each thread's bands */
+} parallel_job_t;
+
+/** @brief Argument of one thread of the parallel transpose */
+typedef struct {
+    parallel_job_t *job; /* Shared bands */
+    unsigned int self;   /* Index of the thread's own bands */
+} parallel_worker_t;
 
 /**
  * @brief Checks if B is the transpose of A.
@@ -214,23 +264,206 @@ static void transpose_1024x1024(size_t M, size_t N, double A[N][M],
     assert(is_transpose(M, N, A, B));
 }
 
+/**
+ * @brief A cache-oblivious recursive transpose for any M x N matrix.
+ *
+ * Base tiles are BlockSize x BlockSize, except when the rows of B are a
+ * multiple of Aliasing_Stride bytes long: the BlockSize rows of B a tile
+ * writes then compete for the same sets, and tiles half as wide touch half
+ * as many of them.
+ *
+ * @param[in]     M         Width of A, height of B
+ * @param[in]     N         Height of A, width of B
+ * @param[in]     A         Source matrix
+ * @param[out]    B         Destination matrix
+ * @param[in]     tmp       Temporary memory
+ *
+ * @return void.
+ */
+static void transpose_recursive(size_t M, size_t N, double A[N][M],
+                                double B[M][N], double tmp[TMPCOUNT]) {
+    trans_plan_t plan = {BlockSize, BlockSize, TRANS_DIAGONAL_DEFER,
+                         TRANS_STAGING_NONE};
+
+    assert(M > 0);
+    assert(N > 0);
+
+    if ((N * sizeof(double)) % Aliasing_Stride == 0) {
+        plan.tile_cols = BlockSize / 2;
+    }
+    trans_kernel_recurse(M, N, A, B, tmp, 0, N, 0, M, plan);
+
+    assert(is_transpose(M, N, A, B));
+}
+
+/**
+ * @brief Transposes with the plan trans-tune picked for this size, if any.
+ *
+ * The plans of trans-plans.h expand to comparisons against constants, so
+ * picking one loads nothing from memory.
+ *
+ * @param[in]     M         Width of A, height of B
+ * @param[in]     N         Height of A, width of B
+ * @param[in]     A         Source matrix
+ * @param[out]    B         Destination matrix
+ * @param[in]     tmp       Temporary memory
+ *
+ * @return True if a plan was found and B is transposed, false otherwise.
+ */
+static bool transpose_tuned(size_t M, size_t N, double A[N][M], double B[M][N],
+                            double tmp[TMPCOUNT]) {
+#define TRANS_TUNED_DISPATCH(m, n, s, e, b, rows, cols, diagonal, staging)    \
+    if ((M == (m)) && (N == (n))) {                                            \
+        trans_plan_t plan = {(rows), (cols), (diagonal), (staging)};           \
+        trans_kernel_recurse(M, N, A, B, tmp, 0, N, 0, M, plan);               \
+        return true;                                                           \
+    }
+    TRANS_TUNED_PLANS(TRANS_TUNED_DISPATCH)
+#undef TRANS_TUNED_DISPATCH
+    return false;
+}
+
+/**
+ * @brief Transposes one band of PARALLEL_BAND_ROWS rows of B.
+ *
+ * @param[in]     job       Shared bands
+ * @param[in]     band      Band to transpose
+ *
+ * @return void.
+ */
+static void transpose_parallel_band(const parallel_job_t *job, size_t band) {
+    size_t M = job->M;
+    size_t N = job->N;
+    double(*A)[M] = (double(*)[M])job->A;
+    double(*B)[N] = (double(*)[N])job->B;
+    size_t col = band * PARALLEL_BAND_ROWS;
+    size_t cols =
+        (col + PARALLEL_BAND_ROWS < M) ? PARALLEL_BAND_ROWS : M - col;
+
+    trans_kernel_recurse(M, N, A, B, job->tmp, 0, N, col, cols, job->plan);
+}
+
+/**
+ * @brief Thread body of the parallel transpose.
+ *
+ * A thread first takes its own bands in order, then steals the bands other
+ * threads have not reached yet, one at a time from the front, so threads
+ * slowed by a ragged band or by the system finish no later than the rest.
+ *
+ * @param[in]     arg       The thread's parallel_worker_t
+ *
+ * @return NULL.
+ */
+static void *transpose_parallel_worker(void *arg) {
+    parallel_worker_t *worker = arg;
+    parallel_job_t *job = worker->job;
+
+    for (unsigned int k = 0; k < job->thread_count; k++) {
+        unsigned int victim = (worker->self + k) % job->thread_count;
+        size_t band;
+        while ((band = __atomic_fetch_add(&job->next[victim], 1,
+                                          __ATOMIC_RELAXED)) <
+               job->end[victim]) {
+            transpose_parallel_band(job, band);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief A multithreaded tiled transpose for large matrices.
+ *
+ * B is split in bands of PARALLEL_BAND_ROWS rows, and each thread owns a
+ * contiguous run of them, so the threads write apart from each other. Each
+ * band is transposed as transpose_recursive transposes a matrix, without
+ * staging, so the threads never share tmp.
+ * Small matrices, machines with one CPU and the traced build run on the
+ * calling thread, the last so tracegen-ct records the same trace each run.
+ *
+ * @param[in]     M         Width of A, height of B
+ * @param[in]     N         Height of A, width of B
+ * @param[in]     A         Source matrix
+ * @param[out]    B         Destination matrix
+ * @param[in]     tmp       Temporary memory
+ *
+ * @return void.
+ */
+static void transpose_parallel(size_t M, size_t N, double A[N][M],
+                               double B[M][N], double tmp[TMPCOUNT]) {
+    parallel_job_t job = {M, N, &A[0][0], &B[0][0], tmp, {0}, 0, 0, {0}, {0}};
+    parallel_worker_t workers[PARALLEL_MAX_THREADS];
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    unsigned int started = 0;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = Parallel_Threads;
+
+    assert(M > 0);
+    assert(N > 0);
+
+    job.plan.tile_rows = BlockSize;
+    job.plan.tile_cols = BlockSize;
+    job.plan.diagonal = TRANS_DIAGONAL_DEFER;
+    job.plan.staging = TRANS_STAGING_NONE;
+    if ((N * sizeof(double)) % Aliasing_Stride == 0) {
+        job.plan.tile_cols = BlockSize / 2;
+    }
+    job.band_count = (M + PARALLEL_BAND_ROWS - 1) / PARALLEL_BAND_ROWS;
+
+    if (thread_count == 0) {
+        thread_count = (online > 0) ? (size_t)online : 1;
+    }
+    if (M * N < Parallel_Min_Elements) {
+        thread_count = 1;
+    }
+#ifdef TRANS_TRACED
+    thread_count = 1;
+#endif
+    if (thread_count > PARALLEL_MAX_THREADS) {
+        thread_count = PARALLEL_MAX_THREADS;
+    }
+    if (thread_count > job.band_count) {
+        thread_count = job.band_count;
+    }
+    job.thread_count = (unsigned int)thread_count;
+    for (unsigned int t = 0; t < job.thread_count; t++) {
+        job.next[t] = job.band_count * t / thread_count;
+        job.end[t] = job.band_count * (t + 1) / thread_count;
+        workers[t].job = &job;
+        workers[t].self = t;
+    }
+
+    /* The calling thread takes the first bands, and steals the bands of
+       any thread that failed to start */
+    for (unsigned int t = 1; t < job.thread_count; t++) {
+        if (pthread_create(&threads[started], NULL, transpose_parallel_worker,
+                           &workers[t]) == 0) {
+            started++;
+        }
+    }
+    transpose_parallel_worker(&workers[0]);
+    for (unsigned int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    assert(is_transpose(M, N, A, B));
+}
+
 /**
  * @brief The solution transpose function that will be graded.
  *
  * You can call other transpose functions from here as you please.
  * It's OK to choose different functions based on array size, but
  * this function must be correct for all values of M and N.
+ *
+ * Sizes trans-tune has tuned run their plan from trans-plans.h, regenerated
+ * with make tune, and every other size the recursive transpose.
  */
 static void transpose_submit(size_t M, size_t N, double A[N][M], double B[M][N],
                              double tmp[TMPCOUNT]) {
-    if ((M == Matrix_Dimension_32x32) && (N == Matrix_Dimension_32x32)) {
-        transpose_32x32(M, N, A, B, tmp);
-    } else if ((M == Matrix_Dimension_1024x1024) &&
-               (N == Matrix_Dimension_1024x1024)) {
-        transpose_1024x1024(M, N, A, B, tmp);
-    } else {
-        trans_basic(M, N, A, B, tmp);
+    if (!transpose_tuned(M, N, A, B, tmp)) {
+        transpose_recursive(M, N, A, B, tmp);
     }
+    assert(is_transpose(M, N, A, B));
 }
 
 /**
@@ -247,6 +480,8 @@ void registerFunctions(void) {
     // Register any additional transpose functions
     registerTransFunction(transpose_32x32, "Transpose of 32x32 matrix");
     registerTransFunction(transpose_1024x1024, "Transpose of 1024x1024 matrix");
+    registerTransFunction(transpose_recursive, "Recursive transpose");
+    registerTransFunction(transpose_parallel, "Parallel tiled transpose");
     registerTransFunction(trans_basic, "Basic transpose");
     registerTransFunction(trans_tmp, "Transpose using the temporary array");
 }